@@ -10,16 +10,34 @@
 
 #pragma once
 
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
 #include <string>
+#include <vector>
 #include <Eigen/Dense>
 
 namespace stateline
 {
+  // NB: doubles are written in host byte order, which is little-endian on
+  // every platform we build for. This is the layout of the binary job and
+  // result payloads described in comms/MESSAGES.SPEC.
+
+  inline std::string serialise(double value)
+  {
+    return std::string((const char *)&value, sizeof(double));
+  }
+
   inline std::string serialise(const Eigen::VectorXd &vector)
   {
     return std::string((char *)vector.data(), vector.size() * sizeof(double));
   }
 
+  inline std::string serialise(const std::vector<double> &vector)
+  {
+    return std::string((const char *)vector.data(), vector.size() * sizeof(double));
+  }
+
   inline std::string serialise(const Eigen::MatrixXd &matrix)
   {
     std::uint32_t rows = matrix.rows();
@@ -32,6 +50,38 @@ namespace stateline
   template <class T>
   inline T unserialise(const std::string &str);
 
+  // Overloads reading directly from a buffer (eg. a received network frame)
+  template <class T>
+  inline T unserialise(const char *data, std::size_t length);
+
+  template <>
+  inline double unserialise(const char *data, std::size_t length)
+  {
+    double value = 0.0;
+    memcpy(&value, data, std::min(length, sizeof(double)));
+    return value;
+  }
+
+  template <>
+  inline std::vector<double> unserialise(const char *data, std::size_t length)
+  {
+    std::vector<double> vector(length / sizeof(double));
+    memcpy(vector.data(), data, vector.size() * sizeof(double));
+    return vector;
+  }
+
+  template <>
+  inline double unserialise(const std::string &str)
+  {
+    return unserialise<double>(str.data(), str.length());
+  }
+
+  template <>
+  inline std::vector<double> unserialise(const std::string &str)
+  {
+    return unserialise<std::vector<double>>(str.data(), str.length());
+  }
+
   template <>
   inline Eigen::VectorXd unserialise(const std::string &str)
   {
@@ -2,46 +2,151 @@
 #include "../infer/sampler.hpp"
 #include "../infer/adaptive.hpp"
 #include "../infer/logging.hpp"
+#include "../infer/checkpoint.hpp"
+
+#include <cmath>
 
 namespace stateline
 {
   namespace
   {
-    void updateWorkerApi(ApiResources& api, comms::Delegator& delegator)
+    void updateWorkerApi(ApiResources& api, comms::ShardedDelegator& delegator)
+    {
+      comms::DelegatorStats stats = delegator.stats();
+      api.set("workers", json({
+            { "count", delegator.workerCount() },
+            { "minions", stats.concurrency } }));
+      api.set("jobs", json({
+            { "queued", stats.queueDepth },
+            { "inProgress", stats.jobsInProgress },
+            { "dispatched", stats.jobsDispatched },
+            { "usDispatchLatency", stats.usDispatchLatency },
+            { "usMaxDispatchLatency", stats.usMaxDispatchLatency },
+            { "pipelineDepth", stats.pipelineDepth },
+            { "minPipelineDepth", stats.minPipelineDepth },
+            { "maxPipelineDepth", stats.maxPipelineDepth },
+            { "cancelled", stats.jobsCancelled },
+            { "hedged", stats.jobsHedged },
+            { "hedgesWon", stats.hedgesWon },
+            { "coldStarts", stats.coldStarts } }));
+    }
+
+    comms::DelegatorSettings delegatorSettings(uint port, const std::vector<StatelineSettings>& problems)
     {
-      api.set("workers", json({{ "count", delegator.workerCount() }}));
+      const StatelineSettings& s = problems.front();
+      comms::DelegatorSettings settings = comms::DelegatorSettings::Default(port);
+      settings.affinityTolerance = s.affinityTolerance;
+      settings.nShards = s.delegatorThreads;
+      settings.nJobTypes = 0;
+      for (const StatelineSettings& p : problems)
+      {
+        settings.tenants.push_back({p.name, p.weight, p.maxJobsInProgress, p.nJobTypes});
+        settings.nJobTypes += p.nJobTypes;
+      }
+      return settings;
+    }
+
+    // Each problem's own resources are under its name, or its index if it
+    // has none, once there is more than one
+    std::string apiPrefix(const std::vector<StatelineSettings>& problems, uint i)
+    {
+      if (problems.size() == 1)
+        return "";
+      return (problems[i].name.empty() ? std::to_string(i) : problems[i].name) + "/";
     }
   }
 
-  void runServer(comms::Delegator& delegator)
+  void runServer(comms::ShardedDelegator& delegator)
   {
     delegator.start();
   }
 
-  std::pair<Eigen::VectorXd,double> generateInitialSample(
-          const StatelineSettings& s, comms::Requester& requester,
-          const mcmc::ProposalBounds& bounds)
+  // Draws come from the sampler's own generator rather than std::rand, which
+  // the samplers of other problems share
+  Eigen::VectorXd drawInitialSample(const StatelineSettings& s, uint attempt,
+      mcmc::ChainArray& chains)
   {
-    Eigen::VectorXd sample;
+    const mcmc::ProposalBounds& bounds = s.proposalBounds;
+    Eigen::VectorXd u(s.ndims);
+    for (uint i = 0; i < s.ndims; i++)
+      u(i) = chains.drawUniform();
+
+    // Spread the chains over the whole of the bounds, so that they are more
+    // likely to find separate modes and convergence tests are meaningful
+    if (s.overdisperseInitial)
+      return (bounds.min.array() + u.array() * (bounds.max - bounds.min).array()).matrix();
+
+    // Retrying the given initial sample would give the same energy
+    if (s.useInitial && attempt == 0)
+      return mcmc::bouncyBounds(s.initial, bounds.min, bounds.max);
 
+    return mcmc::bouncyBounds((2.0 * u.array() - 1.0).matrix(), bounds.min, bounds.max);
+  }
+
+  void initialiseChains(const StatelineSettings& s, comms::Requester& requester,
+      mcmc::ChainArray& chains, mcmc::RegressionAdapter& sigmaAdapter,
+      mcmc::RegressionAdapter& betaAdapter)
+  {
+    uint nChains = s.nstacks * s.ntemps;
     std::vector<uint> jobTypes(s.nJobTypes);
     std::iota(jobTypes.begin(), jobTypes.end(), 0);
 
-  // Send a random sample to workers to be evaluated
-    if (s.useInitial)
-        sample = mcmc::bouncyBounds(s.initial, bounds.min, bounds.max);
-    else
-        sample = mcmc::bouncyBounds(Eigen::VectorXd::Random(s.ndims), 
-                bounds.min, bounds.max);
+    // Evaluate an initial sample for every chain at once. The job id is the
+    // chain id, so the results can come back in any order.
+    std::vector<Eigen::VectorXd> samples(nChains);
+    std::vector<double> energies(nChains);
+    std::vector<uint> attempts(nChains, 0);
+    for (uint i = 0; i < nChains; i++)
+    {
+      samples[i] = drawInitialSample(s, 0, chains);
+      requester.submit(i, jobTypes, samples[i]);
+    }
 
-    requester.submit(0, jobTypes, sample); //job id zero because we dont care
-    auto result = requester.retrieve();
-    double energy = std::accumulate(std::begin(result.second), std::end(result.second), 0.0);
-    return {sample, energy};
-  }
+    // Chains that start at an impossible state draw again
+    uint nOutstanding = nChains;
+    while (nOutstanding > 0)
+    {
+      auto result = requester.retrieve();
+      uint i = result.first;
+      double energy = std::accumulate(std::begin(result.second), std::end(result.second), 0.0);
+      attempts[i]++;
 
+      if (std::isfinite(energy))
+      {
+        energies[i] = energy;
+        nOutstanding--;
+      }
+      else if (attempts[i] < s.initialAttempts)
+      {
+        VLOG(1) << "Initial sample for chain " << i << " has energy " << energy << ", drawing again";
+        samples[i] = drawInitialSample(s, attempts[i], chains);
+        requester.submit(i, jobTypes, samples[i]);
+      }
+      else
+      {
+        LOG(FATAL) << "Could not find an initial sample with finite energy for chain "
+          << i << " in " << attempts[i] << " attempts";
+      }
+    }
+
+    for (uint i = 0; i < nChains; i++)
+    {
+      // Init betas
+      if (i % s.ntemps == 0)
+          betaAdapter.computeBetaStack(i);
 
-  void runSampler(const StatelineSettings& s, zmq::context_t& context, ApiResources& api, comms::Delegator& delegator, bool& running)
+      // Initialise this chain with the evaluated sample
+      chains.initialise(i, samples[i], energies[i], sigmaAdapter.values()[i],
+              betaAdapter.values()[i]);
+
+      LOG(INFO) << "Initialising chain " << i << " with energy: " << energies[i]
+          << " sigma: " << sigmaAdapter.values()[i] << " and beta "
+          << betaAdapter.values()[i] << " after " << attempts[i] << " attempts";
+    }
+  }
+
+  void runSampler(const StatelineSettings& s, comms::Bridge& bridge, uint tenant, ApiResources& api,
+      const std::string& apiPrefix, comms::ShardedDelegator& delegator, bool& running, std::atomic<uint>& nSamplersRunning)
   {
 
     // Allocate adapters and proposal
@@ -51,33 +156,47 @@ namespace stateline
     mcmc::RegressionAdapter sigmaAdapter(s.nstacks, s.ntemps, s.optimalAcceptRate, min_log_ratio, max_log_ratio);
     mcmc::RegressionAdapter betaAdapter(s.nstacks, s.ntemps, s.optimalSwapRate, 0., max_log_ratio);
     mcmc::GaussianProposal proposal(s.nstacks, s.ntemps, s.ndims, s.proposalBounds, initial_count);
-    mcmc::ChainArray chains(s.nstacks, s.ntemps, s.outputPath);
-    comms::Requester requester(context);
-
+    comms::Requester requester(bridge, tenant);
 
-    // Initialise chains to valid states
-    // TODO(AL) This loop could be parallelised, but it would take care...
-    for (uint i = 0; i < s.nstacks * s.ntemps; i++)
+    // Restore everything from the last checkpoint, or start afresh
+    std::string checkpointPath = s.chainSettings.outputPath + "/" + CHECKPOINT_FILENAME;
+    std::unique_ptr<mcmc::CheckpointReader> checkpoint;
+    mcmc::ChainSettings chainSettings = s.chainSettings;
+    uint nsamples = 0;
+    if (s.resume)
     {
+      try
+      {
+        checkpoint.reset(new mcmc::CheckpointReader(checkpointPath));
+        checkpoint->read(chainSettings.resumeFileSizes);
+        checkpoint->read(nsamples);
+      }
+      catch (std::exception const& e)
+      {
+        LOG(FATAL) << "Could not resume: " << e.what();
+      }
+    }
 
-      // Draw an initial sample and compute its energy
-      Eigen::VectorXd sample;
-      double energy;
-      std::tie(sample, energy) = generateInitialSample(s,requester,
-              s.proposalBounds);
-
-      // Init betas
-      if (i % s.ntemps == 0)
-          betaAdapter.computeBetaStack(i);
-
-      // Initialise this chain with the evaluated sample
-      chains.initialise(i, sample, energy, sigmaAdapter.values()[i],
-              betaAdapter.values()[i]);
-
-      LOG(INFO) << "Initialising chain " << i << " with energy: " << energy
-          << "sigma: " << sigmaAdapter.values()[i] << " and beta "
-          << betaAdapter.values()[i];
+    mcmc::ChainArray chains(s.nstacks, s.ntemps, chainSettings);
 
+    if (checkpoint)
+    {
+      try
+      {
+        chains.load(*checkpoint);
+        sigmaAdapter.load(*checkpoint);
+        betaAdapter.load(*checkpoint);
+        proposal.load(*checkpoint);
+      }
+      catch (std::exception const& e)
+      {
+        LOG(FATAL) << "Could not resume: " << e.what();
+      }
+      LOG(INFO) << "Resuming from " << checkpointPath << " with " << nsamples << " samples";
+    }
+    else
+    {
+      initialiseChains(s, requester, chains, sigmaAdapter, betaAdapter);
     }
 
     // Create job types from 0 to max number of job types
@@ -85,7 +204,35 @@ namespace stateline
     std::iota(jobTypes.begin(), jobTypes.end(), 0);
 
     mcmc::Sampler sampler(requester, jobTypes, chains, proposal, sigmaAdapter,
-            betaAdapter, s.swapInterval);
+            betaAdapter, s.swapInterval, s.proposalsInFlight, s.earlyRejection, s.minJobEnergy);
+    if (checkpoint)
+    {
+      try
+      {
+        sampler.load(*checkpoint);
+      }
+      catch (std::exception const& e)
+      {
+        LOG(FATAL) << "Could not resume: " << e.what();
+      }
+    }
+
+    // Saves everything needed to carry on from this point. The chain files
+    // are synced first so that they hold every state up to the checkpoint.
+    auto saveCheckpoint = [&]()
+    {
+      mcmc::CheckpointWriter out;
+      out.write(chains.sync());
+      out.write(nsamples);
+      chains.save(out);
+      sigmaAdapter.save(out);
+      betaAdapter.save(out);
+      proposal.save(out);
+      sampler.save(out);
+      out.commit(checkpointPath);
+    };
+    auto checkpointInterval = std::chrono::milliseconds(s.msCheckpointInterval);
+    auto lastCheckpointTime = std::chrono::high_resolution_clock::now();
 
     mcmc::TableLogger logger(s.nstacks, s.ntemps, s.ndims, s.msLoggingRefresh);
 
@@ -96,7 +243,6 @@ namespace stateline
     // Main Loop
     // TODO(Al) confirm that sampler.step does not have to be thread-safe
     //          as I believe there is only one main loop running.
-    uint nsamples = 0;
     while (nsamples < s.nsamples && running)
     {
       try
@@ -124,9 +270,22 @@ namespace stateline
       logger.update(id, state,
           sigmaAdapter.values(), sigmaAdapter.rates(),
           betaAdapter.values(), betaAdapter.rates());
-      logger.updateApi(api, chains);
+      logger.updateApi(api, chains, apiPrefix);
       updateWorkerApi(api, delegator);
 
+      auto now = std::chrono::high_resolution_clock::now();
+      if (s.msCheckpointInterval > 0 && now - lastCheckpointTime >= checkpointInterval)
+      {
+        lastCheckpointTime = now;
+        try
+        {
+          saveCheckpoint();
+        }
+        catch (std::exception const& e)
+        {
+          LOG(WARNING) << "Failed to save checkpoint: " << e.what();
+        }
+      }
     }
 
     // Finish any outstanding jobs
@@ -134,30 +293,44 @@ namespace stateline
     sampler.flush();
     if (running == false)
         LOG(INFO) << "Running == False";
-    running = false;
+
+    // The server stops once every problem has its samples
+    if (--nSamplersRunning == 0)
+      running = false;
   }
 
   ServerWrapper::ServerWrapper(uint port, const StatelineSettings& s)
-    : settings_(s)
+    : ServerWrapper(port, std::vector<StatelineSettings>{ s })
+  {
+  }
+
+  ServerWrapper::ServerWrapper(uint port, const std::vector<StatelineSettings>& problems)
+    : problems_(problems)
     , running_(false)
-    , context_{new zmq::context_t{1}}
-    , delegator_{*context_, comms::DelegatorSettings::Default(port), running_}
+    , nSamplersRunning_(0)
+    , context_{new zmq::context_t{(int)problems.front().delegatorThreads}}
+    , delegator_{*context_, delegatorSettings(port, problems), running_, bridge_}
   {
   }
 
   void ServerWrapper::start()
   {
     running_ = true;
+    nSamplersRunning_ = problems_.size();
 
     serverThread_ = std::async(std::launch::async, runServer, std::ref(delegator_));
-    samplerThread_ = std::async(std::launch::async, runSampler, std::cref(settings_),
-        std::ref(*context_), std::ref(api_), std::ref(std::ref(delegator_)), std::ref(running_));
+    for (uint i = 0; i < problems_.size(); i++)
+      samplerThreads_.push_back(std::async(std::launch::async, runSampler, std::cref(problems_[i]),
+          std::ref(bridge_), i, std::ref(api_), apiPrefix(problems_, i), std::ref(delegator_), std::ref(running_),
+          std::ref(nSamplersRunning_)));
     apiServerThread_ = std::async(std::launch::async, runApiServer, 8080, std::ref(api_), std::ref(running_));
   }
 
   void ServerWrapper::stop()
   {
     running_ = false;
+    // Wake the sampler if it is waiting for results
+    bridge_.close();
     if (context_)
     {
       delete context_;
@@ -165,7 +338,8 @@ namespace stateline
     }
     // Wait for futures to finish
     serverThread_.wait();
-    samplerThread_.wait();
+    for (auto& thread : samplerThreads_)
+      thread.wait();
   }
 
   bool ServerWrapper::isRunning()
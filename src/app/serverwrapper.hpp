@@ -9,6 +9,8 @@
 //!
 #pragma once
 
+#include <algorithm>
+#include <atomic>
 #include <future>
 #include <zmq.hpp>
 #include <json.hpp>
@@ -17,7 +19,7 @@
 #include "../infer/adaptive.hpp"
 #include "../infer/chainarray.hpp"
 #include "../infer/sampler.hpp"
-#include "../comms/delegator.hpp"
+#include "../comms/shardeddelegator.hpp"
 
 // Ideal config file should look like:
 // {
@@ -35,6 +37,19 @@
 
 namespace stateline
 {
+  //! The name of the checkpoint file in the output directory.
+  const std::string CHECKPOINT_FILENAME = "checkpoint";
+
+  inline db::ChainFileFormat ChainFileFormatFromJSON(const nlohmann::json& j)
+  {
+    std::string format = readWithDefault<std::string>(j, "outputFormat", "csv");
+    if (format == "binary")
+      return db::ChainFileFormat::Binary;
+    if (format != "csv")
+      LOG(FATAL) << "Unknown outputFormat " << format << ", expected csv or binary";
+    return db::ChainFileFormat::CSV;
+  }
+
   struct StatelineSettings
   {
       uint ndims;
@@ -44,20 +59,40 @@ namespace stateline
       // uint annealLength;
       uint nsamples;
       uint swapInterval;
+      uint proposalsInFlight;
+      bool earlyRejection;
+      double minJobEnergy;
+      double affinityTolerance;
+      uint delegatorThreads;
+
+      // Sharing the workers with other problems run by the same server
+      std::string name;
+      double weight;
+      uint maxJobsInProgress;
       // int msLoggingRefresh;
       uint msLoggingRefresh;
       uint nJobTypes;
+      uint msCheckpointInterval;
 
       bool useInitial;
 
+      // Draw the initial samples uniformly over the proposal bounds
+      bool overdisperseInitial;
+
+      // The number of samples drawn for each chain before giving up on
+      // finding one with finite energy
+      uint initialAttempts;
+
+      // Carry on from the checkpoint in the output directory
+      bool resume;
+
       Eigen::VectorXd initial;
 
       // mcmc::SlidingWindowSigmaSettings sigmaSettings;
       // mcmc::SlidingWindowBetaSettings betaSettings;
       double optimalAcceptRate;
       double optimalSwapRate;
-      std::string outputPath;
-      // mcmc::ChainSettings chainSettings;
+      mcmc::ChainSettings chainSettings;
       mcmc::ProposalBounds proposalBounds;
       
 
@@ -68,12 +103,27 @@ namespace stateline
         s.ntemps = readSettings<uint>(j, "nTemperatures");
         s.nsamples = readSettings<uint>(j, "nSamplesTotal");
         s.swapInterval = readSettings<uint>(j,"swapInterval");
+        s.proposalsInFlight = readWithDefault<uint>(j, "proposalsInFlight", 1);
+        s.earlyRejection = readWithDefault<bool>(j, "earlyRejection", false);
+        s.minJobEnergy = readWithDefault<double>(j, "minJobEnergy", 0.0);
+        s.affinityTolerance = readWithDefault<double>(j, "affinityTolerance", 0.5);
+        s.delegatorThreads = std::max(readWithDefault<uint>(j, "delegatorThreads", 1), 1U);
+        s.name = readWithDefault<std::string>(j, "name", "");
+        s.weight = readWithDefault<double>(j, "weight", 1.0);
+        s.maxJobsInProgress = readWithDefault<uint>(j, "maxJobsInProgress", 0);
         s.msLoggingRefresh = (uint)(readSettings<double>(j, "loggingRateSec")*1000.0);
         s.nJobTypes = readSettings<uint>(j, "nJobTypes");
-        s.outputPath = readSettings<std::string>(j, "outputPath");
+        s.chainSettings = mcmc::ChainSettings::Default(readSettings<std::string>(j, "outputPath"));
+        s.chainSettings.outputFormat = ChainFileFormatFromJSON(j);
+        s.chainSettings.msFlushInterval = (uint)(readWithDefault<double>(j, "flushIntervalSec", 10.0)*1000.0);
+        s.chainSettings.cacheLength = readWithDefault<uint>(j, "chainCacheLength", 1000);
+        s.msCheckpointInterval = (uint)(readWithDefault<double>(j, "checkpointIntervalSec", 60.0)*1000.0);
         s.optimalAcceptRate = readSettings<double>(j, "optimalAcceptRate");
         s.optimalSwapRate = readSettings<double>(j, "optimalSwapRate");
         s.useInitial = readSettings<bool>(j, "useInitial");
+        s.resume = false;
+        s.overdisperseInitial = readWithDefault<bool>(j, "overdisperseInitial", false);
+        s.initialAttempts = readWithDefault<uint>(j, "initialAttempts", 100);
 
         if (s.useInitial)
         {
@@ -96,19 +146,27 @@ namespace stateline
 
     public:
       ServerWrapper(uint port, const StatelineSettings& s);
+
+      //! Run several problems at once, which share the workers. Each
+      //! problem's job types are numbered after those of the problems
+      //! before it, and the delegator settings are the first problem's.
+      //!
+      ServerWrapper(uint port, const std::vector<StatelineSettings>& problems);
       ~ServerWrapper();
       void start();
       void stop();
       bool isRunning();
 
     private:
-      StatelineSettings settings_;
+      std::vector<StatelineSettings> problems_;
       bool running_;
+      std::atomic<uint> nSamplersRunning_;
       zmq::context_t* context_;
       ApiResources api_;
-      comms::Delegator delegator_;
+      comms::Bridge bridge_;
+      comms::ShardedDelegator delegator_;
       std::future<void> serverThread_;
-      std::future<void> samplerThread_;
+      std::vector<std::future<void>> samplerThreads_;
       std::future<void> apiServerThread_;
   };
 }
@@ -15,8 +15,10 @@
 #include "comms/worker.hpp"
 #include "comms/thread.hpp"
 
+#include <algorithm>
 #include <iomanip>
 #include <random>
+#include <thread>
 
 namespace stateline
 {
@@ -48,9 +50,10 @@ std::string generateRandomIPCAddr()
 }
 
 WorkerWrapper::WorkerWrapper(const LikelihoodFn& f, const std::pair<uint, uint>& jobTypesRange,
-    const std::string& address)
+    const std::string& address, uint nMinions)
   : lhFn_(f)
   , jobTypesRange_(jobTypesRange)
+  , nMinions_(nMinions > 0 ? nMinions : std::max(std::thread::hardware_concurrency(), 1u))
   , settings_(comms::WorkerSettings::Default(address, generateRandomIPCAddr()))
 {
 }
@@ -64,9 +67,13 @@ void WorkerWrapper::start()
   clientThread_ = startInThread<comms::Worker>(std::ref(running_), std::ref(*context_),
                                                std::cref(settings_));
 
-  minionThread_ = std::async(std::launch::async, runMinion, std::cref(lhFn_),
+  // All the minions share the worker's connection to the server
+  for (uint i = 0; i < nMinions_; i++)
+  {
+    minionThreads_.push_back(std::async(std::launch::async, runMinion, std::cref(lhFn_),
                              std::cref(jobTypesRange_), std::ref(*context_),
-                             std::cref(settings_.workerAddress), std::ref(running_));
+                             std::cref(settings_.workerAddress), std::ref(running_)));
+  }
 }
 
 void WorkerWrapper::stop()
@@ -78,7 +85,9 @@ void WorkerWrapper::stop()
     context_ = nullptr; //THIS MUST BE DONE
   }
   clientThread_.wait();
-  minionThread_.wait();
+  for (auto& minionThread : minionThreads_)
+    minionThread.wait();
+  minionThreads_.clear();
 }
 
 WorkerWrapper::~WorkerWrapper()
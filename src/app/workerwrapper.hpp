@@ -14,6 +14,7 @@
 
 #include <map>
 #include <future>
+#include <vector>
 #include <zmq.hpp>
 
 namespace stateline
@@ -23,8 +24,15 @@ namespace stateline
   class WorkerWrapper
   {
     public:
+      //! \param f The likelihood function. It is called from several
+      //!        threads at once when there is more than one minion.
+      //! \param jobTypesRange The job types the worker evaluates.
+      //! \param address The address of the server.
+      //! \param nMinions The number of jobs to evaluate at once, each in its
+      //!        own thread. Zero uses one per core.
+      //!
       WorkerWrapper(const LikelihoodFn& f, const std::pair<uint, uint>& jobTypesRange,
-                    const std::string& address);
+                    const std::string& address, uint nMinions = 0);
 
       ~WorkerWrapper();
       void start();
@@ -34,6 +42,7 @@ namespace stateline
 
       const LikelihoodFn lhFn_;
       std::pair<uint, uint> jobTypesRange_;
+      uint nMinions_;
 
       comms::WorkerSettings settings_;
 
@@ -41,7 +50,7 @@ namespace stateline
       zmq::context_t* context_;
 
       std::future<bool> clientThread_;
-      std::future<void> minionThread_;
+      std::vector<std::future<void>> minionThreads_;
   };
 }
 
@@ -0,0 +1,125 @@
+//!
+//! Benchmark of the number of messages per second that pass through the
+//! delegator, with workers that answer every job immediately.
+//!
+//! \file bench/delegator.cpp
+//! \author agent
+//! \date 2026
+//! \license Lesser General Public License version 3 or later
+//! \copyright (c) 2014, NICTA
+//!
+
+#include <chrono>
+#include <future>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "app/logging.hpp"
+#include "app/serial.hpp"
+#include "comms/bridge.hpp"
+#include "comms/delegator.hpp"
+#include "comms/requester.hpp"
+#include "comms/router.hpp"
+
+using namespace stateline::comms;
+using hrc = std::chrono::high_resolution_clock;
+
+namespace
+{
+  const uint PORT = 5590;
+
+  // A worker with one minion that returns a result as soon as it gets a job,
+  // using packed headers like the C++ worker
+  void runWorker(zmq::context_t& context, uint nJobTypes, bool& running)
+  {
+    Socket network{context, ZMQ_DEALER, "toNetwork", 0};
+    network.setIdentifier();
+    network.connect("tcp://localhost:" + std::to_string(PORT));
+    network.send({ HELLO, Header{0, 0, 0, 0}, { "0:" + std::to_string(nJobTypes), "1", "1" }});
+
+    Frame result = stateline::serialise(1.0);
+    Frame usService = stateline::serialise(1.0);
+    SocketRouter router("worker", { &network });
+    router.bind(0, JOB, [&](const Message& m)
+        { network.send({ RESULT, Header{m.header.jobId, 0, 0, 0}, { result, usService }}); });
+    router.bind(0, HEARTBEAT, [](const Message&) {});
+    router.poll(10, running);
+  }
+
+  // Messages per second through a delegator with the given number of
+  // workers. Each request is one message in and one out, plus a job and a
+  // result for each job type.
+  double run(uint nWorkers, uint nRequests, uint nInFlight, uint nJobTypes)
+  {
+    zmq::context_t context{1};
+    DelegatorSettings settings = DelegatorSettings::Default(PORT);
+    settings.nJobTypes = nJobTypes;
+    Bridge bridge;
+    bool running = true;
+    auto delegator = std::async(std::launch::async, [&]()
+    {
+      Delegator d(context, settings, running, &bridge);
+      d.start();
+    });
+
+    bool workersRunning = true;
+    std::vector<std::future<void>> workers;
+    for (uint i = 0; i < nWorkers; i++)
+      workers.push_back(std::async(std::launch::async, runWorker, std::ref(context),
+            nJobTypes, std::ref(workersRunning)));
+
+    Requester requester(bridge);
+    std::vector<uint> jobTypes(nJobTypes);
+    for (uint t = 0; t < nJobTypes; t++)
+      jobTypes[t] = t;
+    Eigen::VectorXd sample = Eigen::VectorXd::Zero(10);
+
+    // The first request waits for a worker to connect
+    requester.submit(0, jobTypes, sample);
+    requester.retrieve();
+
+    auto start = hrc::now();
+    for (uint i = 0; i < nInFlight; i++)
+      requester.submit(i, jobTypes, sample);
+    for (uint i = nInFlight; i < nRequests; i++)
+    {
+      requester.retrieve();
+      requester.submit(i, jobTypes, sample);
+    }
+    for (uint i = 0; i < nInFlight; i++)
+      requester.retrieve();
+    double seconds = std::chrono::duration<double>(hrc::now() - start).count();
+
+    workersRunning = false;
+    for (auto& w : workers)
+      w.wait();
+    running = false;
+    delegator.wait();
+
+    return nRequests * (2.0 + 2 * nJobTypes) / seconds;
+  }
+}
+
+int main()
+{
+  stateline::initLogging(0);
+
+  const uint nRequests = 20000;
+  const uint nInFlight = 64;
+  const uint nJobTypes = 4;
+  const std::vector<uint> nWorkers = { 1, 4, 16 };
+
+  // Print the table after the runs so it isn't mixed up with their logging
+  std::vector<double> rates;
+  for (uint n : nWorkers)
+    rates.push_back(run(n, nRequests, nInFlight, nJobTypes));
+
+  std::cout << "Sending " << nRequests << " requests of " << nJobTypes
+            << " job types through the delegator, " << nInFlight << " at a time\n";
+  std::cout << "workers   msg/s\n";
+  for (uint i = 0; i < nWorkers.size(); i++)
+    std::cout << nWorkers[i] << "\t  " << rates[i] << "\n";
+  return 0;
+}
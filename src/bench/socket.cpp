@@ -0,0 +1,151 @@
+//!
+//! Microbenchmark of forwarding job payloads through sockets, comparing
+//! copying every frame into and out of strings against sharing frames.
+//!
+//! \file bench/socket.cpp
+//! \author agent
+//! \date 2026
+//! \license Lesser General Public License version 3 or later
+//! \copyright (c) 2014, NICTA
+//!
+
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+#include "app/logging.hpp"
+#include "comms/socket.hpp"
+
+using namespace stateline::comms;
+using hrc = std::chrono::high_resolution_clock;
+
+namespace
+{
+  // The string-based message the sockets used before frames were shared
+  struct CopiedMessage
+  {
+    Subject subject;
+    std::vector<std::string> data;
+  };
+
+  void sendCopy(zmq::socket_t& socket, const std::string& s, int flags)
+  {
+    zmq::message_t message(s.size());
+    memcpy(message.data(), s.data(), s.size());
+    socket.send(message, flags);
+  }
+
+  std::string receiveCopy(zmq::socket_t& socket)
+  {
+    zmq::message_t message;
+    socket.recv(&message);
+    return std::string(static_cast<char*>(message.data()), message.size());
+  }
+
+  // Socket::send as it was: every frame copied into a new zmq message
+  void sendCopied(zmq::socket_t& socket, const CopiedMessage& m)
+  {
+    sendCopy(socket, "", ZMQ_SNDMORE);
+    sendCopy(socket, std::to_string(m.subject), ZMQ_SNDMORE);
+    for (auto it = m.data.begin(); it != std::prev(m.data.end()); ++it)
+      sendCopy(socket, *it, ZMQ_SNDMORE);
+    sendCopy(socket, m.data.back(), 0);
+  }
+
+  // Socket::receive as it was: every frame copied out into a string
+  CopiedMessage receiveCopied(zmq::socket_t& socket)
+  {
+    receiveCopy(socket); // delimiter
+    CopiedMessage m;
+    m.subject = (Subject)std::stoi(receiveCopy(socket));
+    while (true)
+    {
+      int isMore = 0;
+      size_t moreSize = sizeof(isMore);
+      socket.getsockopt(ZMQ_RCVMORE, &isMore, &moreSize);
+      if (!isMore)
+        break;
+      m.data.push_back(receiveCopy(socket));
+    }
+    return m;
+  }
+
+  // Requester -> delegator -> worker, where the delegator forwards each
+  // request payload once per job type, copying every frame.
+  double runCopying(uint nRequests, uint nJobTypes, const std::string& payload)
+  {
+    zmq::context_t context{1};
+    zmq::socket_t requester{context, ZMQ_PAIR}, delegatorIn{context, ZMQ_PAIR};
+    zmq::socket_t delegatorOut{context, ZMQ_PAIR}, worker{context, ZMQ_PAIR};
+    delegatorIn.bind("inproc://in");
+    requester.connect("inproc://in");
+    delegatorOut.bind("inproc://out");
+    worker.connect("inproc://out");
+
+    auto start = hrc::now();
+    for (uint i = 0; i < nRequests; i++)
+    {
+      sendCopied(requester, { REQUEST, { "0", payload } });
+
+      CopiedMessage request = receiveCopied(delegatorIn);
+
+      for (uint t = 0; t < nJobTypes; t++)
+        sendCopied(delegatorOut, { JOB, { std::to_string(t), request.data[1] } });
+
+      for (uint t = 0; t < nJobTypes; t++)
+        receiveCopied(worker);
+    }
+    return std::chrono::duration<double>(hrc::now() - start).count();
+  }
+
+  // The same pipeline using Socket and shared frames.
+  double runShared(uint nRequests, uint nJobTypes, const std::string& payload)
+  {
+    zmq::context_t context{1};
+    Socket requester{context, ZMQ_PAIR, "requester"}, delegatorIn{context, ZMQ_PAIR, "in"};
+    Socket delegatorOut{context, ZMQ_PAIR, "out"}, worker{context, ZMQ_PAIR, "worker"};
+    delegatorIn.bind("inproc://in");
+    requester.connect("inproc://in");
+    delegatorOut.bind("inproc://out");
+    worker.connect("inproc://out");
+
+    auto start = hrc::now();
+    for (uint i = 0; i < nRequests; i++)
+    {
+      requester.send({REQUEST, { "0", payload }});
+
+      Message request = delegatorIn.receive();
+
+      for (uint t = 0; t < nJobTypes; t++)
+        delegatorOut.send({JOB, { std::to_string(t), request.data[1] }});
+
+      for (uint t = 0; t < nJobTypes; t++)
+        worker.receive();
+    }
+    return std::chrono::duration<double>(hrc::now() - start).count();
+  }
+}
+
+int main()
+{
+  stateline::initLogging(0);
+
+  const uint nRequests = 20000;
+  const uint nJobTypes = 12;
+  std::cout << "Forwarding " << nRequests << " requests to " << nJobTypes
+            << " job types each\n";
+  std::cout << "dims      copying (msg/s)   shared (msg/s)   speedup\n";
+
+  for (uint nDims : { 10, 100, 500, 5000 })
+  {
+    std::string payload(nDims * sizeof(double), 'x');
+    double copying = runCopying(nRequests, nJobTypes, payload);
+    double shared = runShared(nRequests, nJobTypes, payload);
+
+    double nMessages = nRequests * (1.0 + nJobTypes);
+    std::cout << nDims << "\t  " << nMessages / copying << "\t    "
+              << nMessages / shared << "\t     " << copying / shared << "x\n";
+  }
+  return 0;
+}
@@ -31,6 +31,7 @@ ez::ezOptionParser commandLineOptions()
   opt.add("0", 0, 1, 0, "Logging level", "-l", "--log-level");
   opt.add("localhost:5555", 0, 1, 0, "Address of server", "-a", "--address");
   opt.add("3", 0, 1, 0, "Number of job types", "-j", "--job-types");
+  opt.add("0", 0, 1, 0, "Number of jobs to evaluate at once (0 for one per core)", "-m", "--minions");
   return opt;
 }
 
@@ -67,7 +68,10 @@ int main(int argc, const char *argv[])
   int numJobTypes;
   opt.get("-j")->getInt(numJobTypes);
 
-  sl::WorkerWrapper w(gaussianNLL, {0, numJobTypes}, address);
+  int numMinions;
+  opt.get("-m")->getInt(numMinions);
+
+  sl::WorkerWrapper w(gaussianNLL, {0, numJobTypes}, address, numMinions);
 
   /*
    NB: For multiple likelihood functions WorkerWrapper can be initialised with an array, e.g.:
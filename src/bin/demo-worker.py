@@ -5,6 +5,7 @@ import numpy as np
 import subprocess
 import random
 import string
+import struct
 
 HELLO = b'0'
 HEARTBEAT = b'1'
@@ -13,6 +14,29 @@ JOB = b'3'
 RESULT = b'4'
 GOODBYE = b'5'
 
+# Wire format versions for job data and results (see comms/payload.hpp).
+# Set WIRE_FORMAT to TEXT_FORMAT to use the original ':' separated text.
+TEXT_FORMAT = b'0'
+BINARY_FORMAT = b'1'
+WIRE_FORMAT = BINARY_FORMAT
+
+# Packed binary headers (see comms/MESSAGES.SPEC): version, subject, flags,
+# padding, job type, job id, chain id. Set PACKED_HEADER to False to send and
+# receive the subject, job type and job id as text frames instead.
+PACKED_HEADER = True
+HEADER_FORMAT = '<BBBxIQI'
+HEADER_VERSION = 1
+
+def pack_header(subject, job_type=0, job_id=0, chain_id=0):
+    return struct.pack(HEADER_FORMAT, HEADER_VERSION, int(subject), 0,
+                       job_type, job_id, chain_id)
+
+def unpack_header(frame):
+    version, subject, flags, job_type, job_id, chain_id = \
+        struct.unpack(HEADER_FORMAT, frame)
+    assert version == HEADER_VERSION
+    return str(subject).encode('ascii'), job_type, job_id
+
 def random_string():
     return "".join(random.choice(string.lowercase) for x in range(10))
 
@@ -20,9 +44,19 @@ def nll(x):
     # negative log likelihood of standard normal distribution
     return 0.5 * x.dot(x)
 
+def decode_job(job_data):
+    if WIRE_FORMAT == BINARY_FORMAT:
+        # raw little-endian doubles
+        return np.frombuffer(job_data, dtype='<f8')
+    return np.asarray(list(map(float, job_data.split(b':'))))
+
+def encode_result(result):
+    if WIRE_FORMAT == BINARY_FORMAT:
+        return struct.pack('<d', result)
+    return repr(result).encode('ascii')
+
 def handle_job(job_type, job_data):
-    sample = list(map(float, job_data.split(b':')))
-    return nll(np.asarray(sample))
+    return nll(decode_job(job_data))
 
 def send_hello(socket, nJobTypes):
 
@@ -30,7 +64,8 @@ def send_hello(socket, nJobTypes):
     jobTypesStr = '0:{}'.format(nJobTypes).encode('ascii')
 
     logging.info("Sending HELLO message...")
-    socket.send_multipart([b"", HELLO, jobTypesStr])
+    subject = pack_header(HELLO) if PACKED_HEADER else HELLO
+    socket.send_multipart([b"", subject, jobTypesStr, WIRE_FORMAT])
 
 def job_loop(socket):
     while True:
@@ -38,16 +73,23 @@ def job_loop(socket):
         r = socket.recv_multipart()
         logging.info("Got job!")
 
-        assert len(r) == 5
-
-        subject, job_type, job_id, job_data = r[1:]
+        if PACKED_HEADER:
+            assert len(r) == 3
+            subject, job_type, job_id = unpack_header(r[1])
+            job_data = r[2]
+        else:
+            assert len(r) == 5
+            subject, job_type, job_id, job_data = r[1:]
 
         assert subject == JOB
 
         result = handle_job(job_type, job_data)
 
         logging.info("Sending result...")
-        rmsg = [b"", RESULT, job_id, str(result).encode('ascii')]
+        if PACKED_HEADER:
+            rmsg = [b"", pack_header(RESULT, job_id=job_id), encode_result(result)]
+        else:
+            rmsg = [b"", RESULT, job_id, encode_result(result)]
         socket.send_multipart(rmsg)
         logging.info("Sent result {0}!".format(job_id))
 
@@ -1,10 +1,13 @@
 //!
-//! A demo using Stateline to sample from a Gaussian mixture.
+//! A relay server, which takes jobs from a stateline server and passes them
+//! on to workers of its own.
 //!
-//! This file aims to be a tutorial on setting up a MCMC simulation using
-//! the C++ server API of Stateline.
+//! A single server can only keep up with so many worker connections. Running
+//! a relay on each rack and pointing that rack's workers at it spreads the
+//! connections, heartbeats and results over the relays, and the server sees
+//! one worker per relay.
 //!
-//! \file demoDelegator.cpp
+//! \file stateline-server.cpp
 //! \author Lachlan McCalman
 //! \author Darren Shen
 //! \date 2014
@@ -12,62 +15,69 @@
 //! \copyright (c) 2014, NICTA
 //!
 
-#include <iostream>
-#include <functional>
-#include <fstream>
-#include <boost/program_options.hpp>
-
 #include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+#include "ezoptionparser/ezOptionParser.hpp"
 
 #include "../app/logging.hpp"
-#include "../app/serial.hpp"
 #include "../app/signal.hpp"
 #include "../app/commandline.hpp"
-#include "../comms/delegator.hpp"
+#include "../comms/relay.hpp"
 #include "../comms/thread.hpp"
+#include "../common/string.hpp"
 
 // Alias namespaces for conciseness
 namespace sl = stateline;
-namespace ph = std::placeholders;
-namespace po = boost::program_options;
 namespace ch = std::chrono;
 
-po::options_description commandLineOptions()
+ez::ezOptionParser commandLineOptions()
 {
-  auto opts = po::options_description("Demo Options");
-  opts.add_options()
-  ("help,h", "Print help message")
-  ("loglevel,l", po::value<int>()->default_value(0), "Logging level")
-  ("port,p",po::value<uint>()->default_value(5555), "Port on which to accept worker connections") 
-  ;
-  return opts;
+  ez::ezOptionParser opt;
+  opt.overview = "Stateline relay server options";
+  opt.add("", 0, 0, 0, "Print help message", "-h", "--help");
+  opt.add("0", 0, 1, 0, "Logging level", "-l", "--log-level");
+  opt.add("localhost:5555", 0, 1, 0, "Address of the server to take jobs from", "-n", "--network-addr");
+  opt.add("5556", 0, 1, 0, "Port on which to accept worker connections", "-p", "--port");
+  opt.add("0:1", 0, 1, 0, "Job types to take from the server, as first:one past the last", "-j", "--job-types");
+  return opt;
 }
 
-int main(int ac, char *av[])
+int main(int argc, const char *argv[])
 {
-  // --------------------------------------------------------------------------
-  // Settings for the demo
-  // --------------------------------------------------------------------------
+  // Parse the command line
+  auto opt = commandLineOptions();
+  if (!sl::parseCommandLine(opt, argc, argv))
+    return 0;
 
-  po::variables_map vm = sl::parseCommandLine(ac, av, commandLineOptions());
+  // Initialise logging
+  int logLevel;
+  opt.get("-l")->getInt(logLevel);
+  sl::initLogging(logLevel);
 
-  // This allows the user to interrupt the MCMC using Ctrl-C.
+  // Capture Ctrl+C
   sl::init::initialiseSignalHandler();
 
-  // Initialise the logging settings
-  sl::initLogging("server", vm["loglevel"].as<int>(), true, "");
+  std::string networkAddr, jobTypesStr;
+  int port;
+  opt.get("-n")->getString(networkAddr);
+  opt.get("-p")->getInt(port);
+  opt.get("-j")->getString(jobTypesStr);
+
+  sl::comms::RelaySettings settings = sl::comms::RelaySettings::Default(networkAddr, port);
+  std::vector<std::string> jobTypes;
+  sl::splitStr(jobTypes, jobTypesStr, ':');
+  if (jobTypes.size() != 2)
+  {
+    LOG(ERROR) << "Job types must be given as first:last, not " << jobTypesStr;
+    return 1;
+  }
+  settings.jobTypesRange = std::make_pair(std::stoi(jobTypes[0]), std::stoi(jobTypes[1]));
 
-  uint port = vm["port"].as<uint>();
-  auto settings = sl::comms::DelegatorSettings::Default(port);
-  settings.heartbeat.msRate = 100000;
-  settings.heartbeat.msTimeout = 200000;
   zmq::context_t* context = new zmq::context_t(1);
-  LOG(INFO) << "\033[1;31mstarting delegator in thread\033[0m";
   bool running = true;
-  auto future = sl::startInThread<sl::comms::Delegator>(running, std::ref(*context), std::cref(settings));
-  //sl::comms::Delegator delegator(context, settings);
-  //delegator.start();
-  LOG(INFO) << "started delegator in thread";
+  auto future = sl::startInThread<sl::comms::Relay>(running, std::ref(*context), std::cref(settings));
 
   while(!sl::global::interruptedBySignal)
   {
@@ -17,6 +17,7 @@
 #include "../app/serial.hpp"
 #include "../app/signal.hpp"
 #include "../app/commandline.hpp"
+#include "../common/string.hpp"
 
 // Alias namespaces for conciseness
 namespace sl = stateline;
@@ -31,7 +32,8 @@ ez::ezOptionParser commandLineOptions()
   opt.add("", 0, 0, 0, "Print help message", "-h", "--help");
   opt.add("0", 0, 1, 0, "Logging level", "-l", "--log-level");
   opt.add("5555", 0, 1, 0, "Port on which to accept worker connections", "-p", "--port");
-  opt.add("config.json", 0, 1, 0, "Path to configuration file", "-c", "--config");
+  opt.add("config.json", 0, 1, 0, "Path to configuration file, or comma separated paths to run several problems on the same workers", "-c", "--config");
+  opt.add("", 0, 0, 0, "Resume from the checkpoint in the output directory", "-r", "--resume");
   return opt;
 }
 
@@ -64,15 +66,25 @@ int main(int argc, const char *argv[])
   // Capture Ctrl+C
   sl::init::initialiseSignalHandler();
 
-  std::string configPath;
-  opt.get("-c")->getString(configPath);
-  json config = initConfig(configPath);
-  sl::StatelineSettings settings = sl::StatelineSettings::fromJSON(config);
+  std::string configPaths;
+  opt.get("-c")->getString(configPaths);
+  std::vector<std::string> paths;
+  sl::splitStr(paths, configPaths, ',');
+  std::vector<sl::StatelineSettings> problems;
+  for (const std::string& configPath : paths)
+  {
+    json config = initConfig(configPath);
+    problems.push_back(sl::StatelineSettings::fromJSON(config));
+    problems.back().resume = opt.isSet("-r");
+  }
+
+  if (problems.empty())
+    LOG(FATAL) << "No configuration file given";
 
   int port;
   opt.get("-p")->getInt(port);
 
-  sl::ServerWrapper s(port, settings);
+  sl::ServerWrapper s(port, problems);
   s.start();
 
   while(!sl::global::interruptedBySignal && s.isRunning())
@@ -1,13 +1,57 @@
 import matplotlib.pyplot as plt
 import numpy as np
 import csv
+import struct
 import sys
 
-samples = []
-with open(sys.argv[1], 'r') as csvfile:
-  reader = csv.reader(csvfile)
-  for row in reader:
-      samples.append(row[:-5])
+
+def read_binary_chain(filename):
+    """Read a chain file written with "outputFormat": "binary".
+
+    Returns a dict of columns: samples (n x ndims), energy, sigma, beta,
+    accepted and swap_type. See src/db/binary.hpp for the layout.
+    """
+    with open(filename, 'rb') as f:
+        data = f.read()
+
+    columns = {'samples': [], 'energy': [], 'sigma': [], 'beta': [],
+               'accepted': [], 'swap_type': []}
+    if not data:
+        return {name: np.empty(0) for name in columns}
+
+    magic, version, ndims, nstacks, stack = struct.unpack_from('<8sIIII', data)
+    if magic != b'SLCHAIN\0':
+        raise ValueError(filename + ' is not a binary chain file')
+
+    offset = struct.calcsize('<8sIIII')
+    while offset + 4 <= len(data):
+        n, = struct.unpack_from('<I', data, offset)
+        offset += 4
+        if offset + n * ((ndims + 3) * 8 + 2) > len(data):
+            break  # chunk cut short by a crash
+
+        for name, dtype, count in [('samples', '<f8', n * ndims),
+                                   ('energy', '<f8', n), ('sigma', '<f8', n),
+                                   ('beta', '<f8', n), ('accepted', 'u1', n),
+                                   ('swap_type', 'u1', n)]:
+            column = np.frombuffer(data, dtype, count, offset)
+            offset += column.nbytes
+            if name == 'samples':
+                column = column.reshape(ndims, n).T
+            columns[name].append(column)
+
+    return {name: np.concatenate(c) if c else np.empty(0)
+            for name, c in columns.items()}
+
+
+if sys.argv[1].endswith('.bin'):
+    samples = read_binary_chain(sys.argv[1])['samples']
+else:
+    samples = []
+    with open(sys.argv[1], 'r') as csvfile:
+      reader = csv.reader(csvfile)
+      for row in reader:
+          samples.append(row[:-5])
 
 ndims = len(samples[0])
 if ndims > 1:
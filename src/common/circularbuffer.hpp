@@ -1,7 +1,8 @@
 //!
-//! Simple circular buffer.
+//! Fixed-capacity circular buffer, and a window of samples with running
+//! statistics.
 //!
-//! \file comms/circularbuffer.cpp
+//! \file common/circularbuffer.hpp
 //! \author Darren Shen
 //! \date 2016
 //! \license Lesser General Public License version 3 or later
@@ -10,45 +11,204 @@
 
 #pragma once
 
-#include <deque>
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstddef>
+#include <iterator>
+#include <vector>
 
 namespace stateline
 {
 
-namespace comms
+//! A circular buffer holding up to a fixed number of elements in one
+//! contiguous block, allocated on construction. Pushing onto a full buffer
+//! overwrites the oldest element. Elements are indexed and iterated from
+//! oldest to newest.
+//!
+template <class T>
+class CircularBuffer
 {
+public:
+  using value_type = T;
+  using size_type = std::size_t;
+
+  template <class Buffer, class Value>
+  class Iterator : public std::iterator<std::random_access_iterator_tag, Value>
+  {
+  public:
+    using difference_type = std::ptrdiff_t;
+
+    Iterator() : buffer_(nullptr), pos_(0) {}
+    Iterator(Buffer* buffer, size_type pos) : buffer_(buffer), pos_(pos) {}
+
+    // Allow conversion from iterator to const_iterator
+    template <class B, class V>
+    Iterator(const Iterator<B, V>& other) : buffer_(other.buffer_), pos_(other.pos_) {}
+
+    Value& operator*() const { return (*buffer_)[pos_]; }
+    Value* operator->() const { return &(*buffer_)[pos_]; }
+    Value& operator[](difference_type n) const { return (*buffer_)[pos_ + n]; }
+
+    Iterator& operator++() { ++pos_; return *this; }
+    Iterator& operator--() { --pos_; return *this; }
+    Iterator operator++(int) { Iterator it = *this; ++pos_; return it; }
+    Iterator operator--(int) { Iterator it = *this; --pos_; return it; }
+    Iterator& operator+=(difference_type n) { pos_ += n; return *this; }
+    Iterator& operator-=(difference_type n) { pos_ -= n; return *this; }
+    Iterator operator+(difference_type n) const { return Iterator(buffer_, pos_ + n); }
+    Iterator operator-(difference_type n) const { return Iterator(buffer_, pos_ - n); }
+    friend Iterator operator+(difference_type n, const Iterator& it) { return it + n; }
+    difference_type operator-(const Iterator& other) const
+    {
+      return (difference_type)pos_ - (difference_type)other.pos_;
+    }
+
+    bool operator==(const Iterator& other) const { return pos_ == other.pos_; }
+    bool operator!=(const Iterator& other) const { return pos_ != other.pos_; }
+    bool operator<(const Iterator& other) const { return pos_ < other.pos_; }
+    bool operator>(const Iterator& other) const { return pos_ > other.pos_; }
+    bool operator<=(const Iterator& other) const { return pos_ <= other.pos_; }
+    bool operator>=(const Iterator& other) const { return pos_ >= other.pos_; }
+
+  private:
+    template <class B, class V> friend class Iterator;
+
+    Buffer* buffer_;
+    size_type pos_; // logical index, 0 being the oldest element
+  };
+
+  using iterator = Iterator<CircularBuffer, T>;
+  using const_iterator = Iterator<const CircularBuffer, const T>;
+
+  //! \param capacity The maximum number of elements held.
+  //!
+  explicit CircularBuffer(size_type capacity)
+    : data_(capacity), head_(0), size_(0)
+  {
+    assert(capacity > 0);
+  }
+
+  //! Add an element, overwriting the oldest one if the buffer is full.
+  void push_back(const T& val)
+  {
+    data_[physical(size_)] = val;
+    if (full())
+      head_ = physical(1);
+    else
+      size_++;
+  }
+
+  //! Remove the oldest element.
+  void pop_front()
+  {
+    assert(!empty());
+    head_ = physical(1);
+    size_--;
+  }
+
+  void clear() { head_ = 0; size_ = 0; }
+
+  T& operator[](size_type i) { return data_[physical(i)]; }
+  const T& operator[](size_type i) const { return data_[physical(i)]; }
 
+  T& front() { return (*this)[0]; }
+  const T& front() const { return (*this)[0]; }
+  T& back() { return (*this)[size_ - 1]; }
+  const T& back() const { return (*this)[size_ - 1]; }
+
+  iterator begin() { return iterator(this, 0); }
+  iterator end() { return iterator(this, size_); }
+  const_iterator begin() const { return const_iterator(this, 0); }
+  const_iterator end() const { return const_iterator(this, size_); }
+
+  //! The number of elements in the buffer.
+  size_type size() const { return size_; }
+
+  size_type capacity() const { return data_.size(); }
+  bool empty() const { return size_ == 0; }
+  bool full() const { return size_ == data_.size(); }
+
+private:
+  size_type physical(size_type i) const
+  {
+    size_type j = head_ + i;
+    return j < data_.size() ? j : j - data_.size();
+  }
+
+  std::vector<T> data_;
+  size_type head_; // physical index of the oldest element
+  size_type size_;
+};
+
+//! Keeps the most recent samples of a quantity along with their mean and
+//! variance, and an exponentially weighted moving average over all samples.
+//! The statistics are updated as each sample is added, so reading them
+//! costs nothing.
+//!
 template <class T>
-class CircularBuffer
+class StatisticsWindow
 {
 public:
-  using size_type = typename std::deque<T>::size_type;
-  using iterator = typename std::deque<T>::iterator;
-  using const_iterator = typename std::deque<T>::const_iterator;
+  using size_type = typename CircularBuffer<T>::size_type;
+  using const_iterator = typename CircularBuffer<T>::const_iterator;
 
-  explicit CircularBuffer(size_type size)
-    : buffer_(size), size_(size)
+  //! \param size The number of samples in the window.
+  //! \param ewmaWeight The weight of the newest sample in the moving average.
+  //!
+  explicit StatisticsWindow(size_type size, double ewmaWeight = 0.1)
+    : buffer_(size), mean_(0), m2_(0), ewma_(0), ewmaWeight_(ewmaWeight)
   {
   }
 
   void push_back(T val)
   {
+    double x = val;
+    ewma_ = buffer_.empty() ? x : ewma_ + ewmaWeight_ * (x - ewma_);
+
+    if (!buffer_.full())
+    {
+      // Welford's update while the window fills
+      double delta = x - mean_;
+      mean_ += delta / (buffer_.size() + 1);
+      m2_ += delta * (x - mean_);
+    }
+    else
+    {
+      // Replace the oldest sample
+      double old = buffer_.front();
+      double oldMean = mean_;
+      mean_ += (x - old) / buffer_.size();
+      m2_ += (x - old) * (x - mean_ + old - oldMean);
+      m2_ = std::max(m2_, 0.0); // rounding can take it just below zero
+    }
     buffer_.push_back(val);
-    if (buffer_.size() > size_)
-      buffer_.pop_front();
   }
 
-  iterator begin() { return buffer_.begin(); }
-  iterator end() { return buffer_.end(); }
+  //! The number of samples in the window.
+  size_type count() const { return buffer_.size(); }
+
+  bool empty() const { return buffer_.empty(); }
+
+  double mean() const { return mean_; }
+
+  //! The population variance of the samples in the window.
+  double variance() const { return empty() ? 0.0 : m2_ / count(); }
+
+  double stddev() const { return std::sqrt(variance()); }
+
+  double ewma() const { return ewma_; }
+
+  //! Iterates over the samples in the window, oldest first.
   const_iterator begin() const { return buffer_.begin(); }
   const_iterator end() const { return buffer_.end(); }
-  size_type size() const { return size_; }
 
 private:
-  std::deque<T> buffer_;
-  size_type size_;
+  CircularBuffer<T> buffer_;
+  double mean_;
+  double m2_; // sum of squared differences from the mean
+  double ewma_;
+  double ewmaWeight_;
 };
 
 }
-
-}
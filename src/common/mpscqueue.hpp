@@ -0,0 +1,88 @@
+//!
+//! Lock-free queue with many producers and a single consumer.
+//!
+//! \file common/mpscqueue.hpp
+//! \author agent
+//! \date 2026
+//! \license Lesser General Public License version 3 or later
+//! \copyright (c) 2014, NICTA
+//!
+
+#pragma once
+
+#include <atomic>
+#include <utility>
+
+namespace stateline
+{
+
+//! An unbounded queue that any number of threads can push onto while one
+//! thread pops from it, without locks. Elements pushed by the same thread
+//! are popped in the order they were pushed.
+//!
+//! Pushing links a new node onto the head with a single atomic exchange.
+//! The consumer owns the tail. A push that is still in progress can make
+//! the queue look empty for a moment, so a consumer that waits for elements
+//! should be woken by the producer after it pushes.
+//!
+template <class T>
+class MpscQueue
+{
+public:
+  MpscQueue()
+    : head_(new Node), tail_(head_.load())
+  {
+  }
+
+  ~MpscQueue()
+  {
+    T value;
+    while (pop(value))
+      ;
+    delete tail_;
+  }
+
+  MpscQueue(const MpscQueue&) = delete;
+  MpscQueue& operator=(const MpscQueue&) = delete;
+
+  //! Add an element. Safe to call from any thread.
+  void push(T value)
+  {
+    Node* node = new Node(std::move(value));
+    Node* prev = head_.exchange(node, std::memory_order_acq_rel);
+    prev->next.store(node, std::memory_order_release);
+  }
+
+  //! Take the oldest element. Must only be called from the consumer thread.
+  //!
+  //! \param value Set to the element taken.
+  //! \return False if there was nothing to take.
+  //!
+  bool pop(T& value)
+  {
+    Node* next = tail_->next.load(std::memory_order_acquire);
+    if (!next)
+      return false;
+
+    // The next node becomes the new (empty) tail
+    value = std::move(next->value);
+    delete tail_;
+    tail_ = next;
+    return true;
+  }
+
+private:
+  struct Node
+  {
+    Node() : next(nullptr) {}
+    explicit Node(T value) : next(nullptr), value(std::move(value)) {}
+
+    std::atomic<Node*> next;
+    T value;
+  };
+
+  std::atomic<Node*> head_; // newest node, pushed onto by the producers
+  Node* tail_; // already-taken node before the oldest element
+};
+
+}
@@ -0,0 +1,111 @@
+//!
+//! Pool of reusable records addressed by numeric ids.
+//!
+//! \file common/slotpool.hpp
+//! \author agent
+//! \date 2026
+//! \license Lesser General Public License version 3 or later
+//! \copyright (c) 2014, NICTA
+//!
+
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+namespace stateline
+{
+
+//! Records that are taken from the pool and given back, instead of being
+//! allocated and freed. Each record is in a slot, and is known by an id made
+//! of its slot in the low 32 bits and the slot's generation above them. The
+//! generation goes up each time the slot is reused, so the id of a record
+//! that has been given back doesn't find the one that took its place. Ids
+//! are never zero, so zero can stand for no record: a generation that wraps
+//! around skips zero.
+//!
+//! Records aren't reset when they are reused, so that their containers keep
+//! their storage, and they don't move as the pool grows. Once the pool has
+//! as many slots as are ever in use at once, taking and giving back records
+//! allocates nothing.
+//!
+//! \tparam Generation The type the generations are counted in. Narrower
+//!         types only wrap sooner, as tests do.
+//!
+template <class T, class Generation = uint32_t>
+class SlotPool
+{
+public:
+  using size_type = std::size_t;
+
+  SlotPool() : size_(0) {}
+
+  //! Take a record, reusing a free slot if there is one.
+  //!
+  //! \return The id of the record.
+  //!
+  uint64_t acquire()
+  {
+    uint slot;
+    if (free_.empty())
+    {
+      slot = records_.size();
+      records_.emplace_back();
+      ids_.push_back(0);
+      generations_.push_back(0);
+    }
+    else
+    {
+      slot = free_.back();
+      free_.pop_back();
+    }
+    Generation& generation = generations_[slot];
+    if (++generation == 0)
+      generation = 1;
+    uint64_t id = ((uint64_t)generation << 32) | slot;
+    ids_[slot] = id;
+    size_++;
+    return id;
+  }
+
+  //! Give a record back. Its id no longer finds it.
+  void release(uint64_t id)
+  {
+    assert(find(id));
+    uint slot = slotOf(id);
+    ids_[slot] = 0;
+    free_.push_back(slot);
+    size_--;
+  }
+
+  //! The record with the given id, or null if it has been given back.
+  T* find(uint64_t id)
+  {
+    uint slot = slotOf(id);
+    return slot < ids_.size() && id != 0 && ids_[slot] == id ? &records_[slot] : nullptr;
+  }
+
+  //! The record with the given id, which must not have been given back.
+  T& operator[](uint64_t id)
+  {
+    assert(find(id));
+    return records_[slotOf(id)];
+  }
+
+  //! The number of records taken and not given back.
+  size_type size() const { return size_; }
+
+private:
+  static uint slotOf(uint64_t id) { return (uint)(id & 0xffffffff); }
+
+  std::deque<T> records_;
+  std::vector<uint64_t> ids_; // of the record in each slot, zero if it is free
+  std::vector<Generation> generations_;
+  std::vector<uint> free_;
+  size_type size_;
+};
+
+}
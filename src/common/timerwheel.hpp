@@ -0,0 +1,119 @@
+//!
+//! Hashed timer wheel for large numbers of coarse timeouts.
+//!
+//! \file common/timerwheel.hpp
+//! \author agent
+//! \date 2026
+//! \license Lesser General Public License version 3 or later
+//! \copyright (c) 2014, NICTA
+//!
+
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace stateline
+{
+
+//! Fires timers to a resolution of one tick. Each timer goes into the slot
+//! of the tick it is due in, modulo the number of slots, so adding one and
+//! firing one both cost the same however many there are. A timer due more
+//! than a revolution of the wheel away is looked at and put back each time
+//! its slot comes round.
+//!
+//! Timers can't be cancelled. Their owner should check when one fires
+//! whether it still means anything.
+//!
+template <class T>
+class TimerWheel
+{
+public:
+  using clock = std::chrono::high_resolution_clock;
+  using size_type = std::size_t;
+
+  //! \param tick The resolution of the timers.
+  //! \param nSlots The number of ticks in a revolution of the wheel.
+  //! \param start The time of the first tick.
+  //!
+  TimerWheel(clock::duration tick, size_type nSlots, clock::time_point start = clock::now())
+    : tick_(tick), start_(start), slots_(nSlots), next_(0), size_(0)
+  {
+    assert(tick.count() > 0 && nSlots > 0);
+  }
+
+  //! Add a timer that fires once the tick the given time is in has ended.
+  //! A time that has already passed fires once the current tick has ended.
+  //!
+  void add(const T& value, clock::time_point when)
+  {
+    uint64_t t = std::max(tickOf(when), next_);
+    slots_[t % slots_.size()].push_back(std::make_pair(when, value));
+    size_++;
+  }
+
+  //! Fire the timers in every tick that has ended by now, oldest tick
+  //! first. The timers fired are removed before their callback, which may
+  //! add new ones.
+  //!
+  //! \param now The current time.
+  //! \param fire Called with the value of each timer fired.
+  //!
+  template <class F>
+  void expire(clock::time_point now, F fire)
+  {
+    // A tick is done with once it has ended, so all its timers are due.
+    // After a long stall each slot only needs looking at once.
+    uint64_t end = tickOf(now);
+    if (end <= next_)
+      return;
+    if (end - next_ > slots_.size())
+      next_ = end - slots_.size();
+
+    while (next_ < end)
+    {
+      // Timers added from here on go in later ticks
+      uint64_t tick = next_++;
+      auto& slot = slots_[tick % slots_.size()];
+      if (slot.empty())
+        continue;
+
+      // Swapping the slot with a spare keeps the storage of both
+      due_.swap(slot);
+      size_ -= due_.size();
+      for (auto& timer : due_)
+      {
+        if (tickOf(timer.first) > tick)
+          add(timer.second, timer.first); // a later revolution
+        else
+          fire(timer.second);
+      }
+      due_.clear();
+    }
+  }
+
+  //! The number of timers that haven't fired.
+  size_type size() const { return size_; }
+
+  bool empty() const { return size_ == 0; }
+
+private:
+  uint64_t tickOf(clock::time_point when) const
+  {
+    return when <= start_ ? 0 : (when - start_) / tick_;
+  }
+
+  clock::duration tick_;
+  clock::time_point start_;
+  std::vector<std::vector<std::pair<clock::time_point, T>>> slots_;
+  std::vector<std::pair<clock::time_point, T>> due_; // the slot being fired
+  uint64_t next_; // the first tick that hasn't ended
+  size_type size_;
+};
+
+}
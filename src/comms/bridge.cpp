@@ -0,0 +1,211 @@
+//!
+//! Contains the implementation of the in-process bridge.
+//!
+//! \file comms/bridge.cpp
+//! \author agent
+//! \date 2026
+//! \license Lesser General Public License version 3 or later
+//! \copyright (c) 2014, NICTA
+//!
+
+#include "comms/bridge.hpp"
+
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/eventfd.h>
+#endif
+
+namespace stateline
+{
+  namespace comms
+  {
+    Wakeup::Wakeup()
+    {
+#ifdef __linux__
+      readFd_ = writeFd_ = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+      if (readFd_ < 0)
+        throw std::runtime_error(std::string("Could not create eventfd: ") + std::strerror(errno));
+#else
+      int fds[2];
+      if (::pipe(fds) != 0)
+        throw std::runtime_error(std::string("Could not create pipe: ") + std::strerror(errno));
+      for (int fd : fds)
+      {
+        ::fcntl(fd, F_SETFL, ::fcntl(fd, F_GETFL) | O_NONBLOCK);
+        ::fcntl(fd, F_SETFD, FD_CLOEXEC);
+      }
+      readFd_ = fds[0];
+      writeFd_ = fds[1];
+#endif
+    }
+
+    Wakeup::~Wakeup()
+    {
+      ::close(readFd_);
+      if (writeFd_ != readFd_)
+        ::close(writeFd_);
+    }
+
+    void Wakeup::notify()
+    {
+      // A full pipe or counter is already readable, so failures don't matter
+      uint64_t one = 1;
+      ssize_t n = ::write(writeFd_, &one, sizeof(one));
+      (void)n;
+    }
+
+    void Wakeup::wait()
+    {
+      pollfd item = { readFd_, POLLIN, 0 };
+      while (::poll(&item, 1, -1) < 0 && errno == EINTR)
+        ;
+      clear();
+    }
+
+    void Wakeup::clear()
+    {
+      uint64_t buffer[64];
+      while (::read(readFd_, buffer, sizeof(buffer)) > 0)
+        ;
+    }
+
+    Bridge::Endpoint::Endpoint(Bridge& bridge, uint index, uint tenant)
+      : bridge_(bridge), index_(index), tenant_(tenant)
+    {
+    }
+
+    void Bridge::Endpoint::submit(uint id, std::vector<uint> jobTypes, std::string data,
+        double rejectAbove, double minJobEnergy)
+    {
+      bridge_.requests_.push({ this, id, std::move(jobTypes), std::move(data),
+          rejectAbove, minJobEnergy, {} });
+      bridge_.wakeup_.notify();
+      for (Wakeup* listener : bridge_.listeners_)
+        listener->notify();
+    }
+
+    Bridge::Result Bridge::Endpoint::retrieve()
+    {
+      Result result;
+      while (!results_.pop(result))
+      {
+        if (bridge_.closed_)
+          throw std::runtime_error("Bridge to the delegator has been closed");
+        wakeup_.wait();
+      }
+      return result;
+    }
+
+    bool Bridge::Endpoint::poll(Result& result)
+    {
+      if (results_.pop(result))
+        return true;
+
+      // As in Bridge::receive, results sent after this still wake the poll
+      wakeup_.clear();
+      return results_.pop(result);
+    }
+
+    Bridge::Bridge()
+      : closed_(false), nHandedBack_(0)
+    {
+      receiving_.clear();
+    }
+
+    Bridge::Endpoint& Bridge::connect(uint tenant)
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      endpoints_.emplace_back(new Endpoint(*this, endpoints_.size(), tenant));
+      return *endpoints_.back();
+    }
+
+    void Bridge::close()
+    {
+      closed_ = true;
+      std::unique_lock<std::mutex> lock(mutex_);
+      for (auto& endpoint : endpoints_)
+        endpoint->wakeup_.notify();
+    }
+
+    void Bridge::addListener(Wakeup& wakeup)
+    {
+      listeners_.push_back(&wakeup);
+    }
+
+    bool Bridge::receive(Request& request)
+    {
+      // The queue only has one consumer at a time
+      if (receiving_.test_and_set(std::memory_order_acquire))
+        return false;
+
+      // Clear the notifications before looking again, so a request pushed
+      // after this still wakes the next poll
+      bool received = requests_.pop(request);
+      if (!received)
+      {
+        wakeup_.clear();
+        received = requests_.pop(request);
+      }
+      receiving_.clear(std::memory_order_release);
+      return received;
+    }
+
+    bool Bridge::receive(Request& request, const std::function<bool(const Request&)>& accept)
+    {
+      {
+        std::unique_lock<std::mutex> lock(handedBackMutex_);
+        auto oldest = handedBack_.end();
+        for (auto it = handedBack_.begin(); it != handedBack_.end(); ++it)
+          if ((oldest == handedBack_.end() || it->second.front().seq < oldest->second.front().seq)
+              && accept(it->second.front().request))
+            oldest = it;
+        if (oldest != handedBack_.end())
+        {
+          request = std::move(oldest->second.front().request);
+          oldest->second.pop_front();
+          if (oldest->second.empty())
+            handedBack_.erase(oldest);
+          return true;
+        }
+      }
+
+      while (receive(request))
+      {
+        if (accept(request))
+          return true;
+        handBack(std::move(request));
+      }
+      return false;
+    }
+
+    void Bridge::handBack(Request request)
+    {
+      bool newKind;
+      {
+        std::unique_lock<std::mutex> lock(handedBackMutex_);
+        auto& kind = handedBack_[{ request.from->tenant(), request.jobTypes }];
+        newKind = kind.empty();
+        kind.push_back({ nHandedBack_++, std::move(request) });
+      }
+      if (!newKind)
+        return;
+      wakeup_.notify();
+      for (Wakeup* listener : listeners_)
+        listener->notify();
+    }
+
+    void Bridge::send(Endpoint& to, Result result)
+    {
+      to.results_.push(std::move(result));
+      to.wakeup_.notify();
+    }
+
+  } // namespace comms
+} // namespace stateline
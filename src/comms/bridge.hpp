@@ -0,0 +1,237 @@
+//!
+//! An in-process connection between requesters and the delegator. Requests
+//! and results are passed as structs through lock-free queues instead of
+//! being framed and copied through a socket. The delegator's poll loop is
+//! woken through a file descriptor that it polls alongside its sockets.
+//!
+//! \file comms/bridge.hpp
+//! \author agent
+//! \date 2026
+//! \license Lesser General Public License version 3 or later
+//! \copyright (c) 2014, NICTA
+//!
+
+#pragma once
+
+#include "common/mpscqueue.hpp"
+
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <limits>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace stateline
+{
+  namespace comms
+  {
+    //! A file descriptor that becomes readable when notified, so that a
+    //! thread can sleep until another thread has work for it. Uses an
+    //! eventfd where there is one, otherwise a pipe.
+    //!
+    class Wakeup
+    {
+      public:
+        Wakeup();
+        ~Wakeup();
+
+        Wakeup(const Wakeup&) = delete;
+        Wakeup& operator=(const Wakeup&) = delete;
+
+        //! Make the file descriptor readable. Safe to call from any thread.
+        //!
+        void notify();
+
+        //! Block until notified, then clear the notifications.
+        //!
+        void wait();
+
+        //! Clear any notifications without blocking.
+        //!
+        void clear();
+
+        //! The file descriptor to poll for notifications.
+        //!
+        int fd() const { return readFd_; }
+
+      private:
+        int readFd_;
+        int writeFd_; // the same as readFd_ for an eventfd
+    };
+
+    //! Connects requesters to a delegator in the same process.
+    //!
+    class Bridge
+    {
+      public:
+        class Endpoint;
+
+        //! A batch of jobs for a sample, as submitted by a requester.
+        struct Request
+        {
+          Endpoint* from;
+          uint id;
+          std::vector<uint> jobTypes;
+          std::string data; // binary wire format
+          double rejectAbove; // see Requester::submit
+          double minJobEnergy;
+
+          // Job types that a delegator which handed the request back had
+          // already done, with their results. They aren't in jobTypes.
+          std::vector<std::pair<uint, double>> finished;
+        };
+
+        //! The results of a Request, in the order of its job types.
+        struct Result
+        {
+          uint id;
+          std::vector<double> results;
+        };
+
+        //! The requester's end of the bridge. Each requester thread has its
+        //! own endpoint, so results go straight back to the one that asked.
+        //!
+        class Endpoint
+        {
+          public:
+            //! Submit a batch of jobs. Safe to call from any thread. See
+            //! Requester::submit for the cut-off.
+            //!
+            void submit(uint id, std::vector<uint> jobTypes, std::string data,
+                double rejectAbove = std::numeric_limits<double>::infinity(),
+                double minJobEnergy = 0.0);
+
+            //! Block until the results of a batch arrive. Must only be called
+            //! from one thread.
+            //!
+            //! \throws std::runtime_error If the bridge is closed.
+            //!
+            Result retrieve();
+
+            //! Take the results of a batch without blocking. Must only be
+            //! called from one thread.
+            //!
+            //! \param result Set to the results taken.
+            //! \return False if no results have arrived.
+            //!
+            bool poll(Result& result);
+
+            //! The file descriptor that becomes readable when results arrive,
+            //! for requesters that poll instead of blocking.
+            //!
+            int fd() const { return wakeup_.fd(); }
+
+            //! Identifies the endpoint among those of its bridge.
+            //!
+            uint index() const { return index_; }
+
+            //! The tenant the endpoint's requests belong to. See
+            //! DelegatorSettings::tenants.
+            //!
+            uint tenant() const { return tenant_; }
+
+          private:
+            friend class Bridge;
+
+            Endpoint(Bridge& bridge, uint index, uint tenant);
+
+            Bridge& bridge_;
+            uint index_;
+            uint tenant_;
+            MpscQueue<Result> results_;
+            Wakeup wakeup_;
+        };
+
+        Bridge();
+
+        Bridge(const Bridge&) = delete;
+        Bridge& operator=(const Bridge&) = delete;
+
+        //! Create an endpoint for a new requester. Safe to call from any
+        //! thread. The endpoint lives as long as the bridge.
+        //!
+        //! \param tenant The tenant the requester's requests belong to.
+        //!
+        Endpoint& connect(uint tenant = 0);
+
+        //! Wake every requester waiting for results and make them throw, so
+        //! that their threads can finish.
+        //!
+        void close();
+
+        //! The file descriptor that becomes readable when requests arrive.
+        //!
+        int fd() const { return wakeup_.fd(); }
+
+        //! Have a wakeup notified of every request submitted, as well as the
+        //! bridge's own. Delegators that share the bridge each listen with
+        //! their own, so that one that clears it doesn't hide requests from
+        //! the others. Must be called before any requests are submitted.
+        //!
+        void addListener(Wakeup& wakeup);
+
+        //! Take the oldest submitted request without blocking. Delegators
+        //! sharing the bridge take turns: while one is taking requests, the
+        //! others are told there are none rather than waiting.
+        //!
+        //! \param request Set to the request taken.
+        //! \return False if there are no requests.
+        //!
+        bool receive(Request& request);
+
+        //! Take the oldest request that a delegator sharing the bridge can
+        //! serve, without blocking. Requests that were handed back come
+        //! before those submitted since. Submitted requests it can't serve
+        //! are handed back for the others as they are passed over.
+        //!
+        //! Handed back requests are kept by tenant and job types, so only
+        //! the oldest of each kind is looked at, however many are waiting.
+        //!
+        //! \param request Set to the request taken.
+        //! \param accept Whether the delegator can serve a request. Must
+        //!        only depend on the tenant and the job types.
+        //! \return False if there are no requests it can serve.
+        //!
+        bool receive(Request& request, const std::function<bool(const Request&)>& accept);
+
+        //! Give up a request taken from the bridge, for another delegator
+        //! sharing it to take instead. Delegators look for handed back
+        //! requests every poll, so the listeners are only notified of the
+        //! first of a kind.
+        //!
+        void handBack(Request request);
+
+        //! Send the results of a request back to its requester.
+        //!
+        void send(Endpoint& to, Result result);
+
+      private:
+        MpscQueue<Request> requests_;
+        Wakeup wakeup_;
+        std::vector<Wakeup*> listeners_;
+        std::atomic_flag receiving_; // set while a delegator is taking requests
+        std::atomic<bool> closed_;
+
+        // Handed back requests with their order of handing back, by tenant
+        // and job types. Kinds with none left are removed.
+        struct HandedBack
+        {
+          uint64_t seq;
+          Request request;
+        };
+        using RequestKind = std::pair<uint, std::vector<uint>>;
+        std::mutex handedBackMutex_; // guards handedBack_ and nHandedBack_
+        std::map<RequestKind, std::deque<HandedBack>> handedBack_;
+        uint64_t nHandedBack_;
+
+        std::mutex mutex_; // guards endpoints_
+        std::deque<std::unique_ptr<Endpoint>> endpoints_;
+    };
+
+  } // namespace comms
+} // namespace stateline
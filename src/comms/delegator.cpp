@@ -9,12 +9,16 @@
 #include "comms/delegator.hpp"
 
 #include "comms/datatypes.hpp"
-#include "comms/thread.hpp"
 #include "common/string.hpp"
+#include "app/serial.hpp"
 
 #include <string>
 #include <easylogging/easylogging++.h>
-#include <numeric>
+#include <cmath>
+#include <cstdlib>
+#include <limits>
+#include <algorithm>
+#include <functional>
 
 namespace stateline
 {
@@ -22,82 +26,177 @@ namespace stateline
   {
     namespace
     {
-      // TODO: should this be a float?
-      uint timeForJob(const Delegator::Worker& w, uint jobType)
+      // Number of recent job times kept per worker and job type
+      const uint TIME_WINDOW_LENGTH = 10;
+
+      // Expected time for a worker to do a job of the given type
+      double timeForJob(const Delegator::Worker& w, uint jobType)
       {
-        auto& times = w.times.at(jobType);
-        uint totalTime = std::accumulate(std::begin(times), std::end(times), 0);
-        uint avg;
-        if (times.size() > 0)
-          avg = totalTime / times.size();
-        else
-          avg = 5; // very short initial guess to encourage testing
-        return avg;
+        auto& times = w.times[jobType - w.jobTypesRange.first];
+        if (times.empty())
+          return 5; // very short initial guess to encourage testing
+        return times.ewma();
       }
 
-      // TODO: could we compute these lazily? i.e. each time a new job is assigned,
-      // we update the expected finishing time?
-      uint usTillDone(const Delegator::Worker& w, uint jobType)
+      double timeVarianceForJob(const Delegator::Worker& w, uint jobType)
       {
-        uint t = 0;
-        for (auto const& i : w.workInProgress)
-          t += timeForJob(w, i.second.type);
-        //now add the expected time for the new job
-        t += timeForJob(w, jobType);
-        return t;
+        return w.times[jobType - w.jobTypesRange.first].variance();
+      }
+
+      // Most jobs each of a worker's minions may have in progress at once,
+      // and the number before its round trip time has been measured
+      const uint MAX_JOBS_PER_MINION = 10;
+      const uint INITIAL_JOBS_PER_MINION = 2;
+
+      // Weight of the newest sample in a worker's service and round trip
+      // time moving averages
+      const double ROUND_TRIP_SMOOTHING = 0.1;
+
+      // Weight of the newest sample in the dispatch latency moving average
+      const double LATENCY_SMOOTHING = 0.05;
+
+      // Least time before a job is overdue, and the resolution and number
+      // of slots of the deadline timers. Deadlines further off than a
+      // revolution, about ten seconds, are looked at once a revolution.
+      const double MIN_US_BEFORE_HEDGE = 10000;
+      const auto DEADLINE_TICK = std::chrono::milliseconds(10);
+      const uint DEADLINE_SLOTS = 1024;
+
+      // Largest ready queue key, in microseconds, so that it converts to
+      // an integer whatever the expected completion time
+      const double MAX_READY_KEY = 1e18;
+
+      // Least weight of a tenant, so that none has an endless pass
+      const double MIN_TENANT_WEIGHT = 1e-6;
+
+      // Number of jobs each of a worker's minions may be given after the
+      // last one of a job type before the worker is assumed to have
+      // dropped that job type's data
+      const uint WARM_JOBS_PER_MINION = 20;
+
+      // Weight of the newest sample in the typical time of a job type
+      const double TYPICAL_TIME_SMOOTHING = 0.1;
+
+      // Heartbeat timers are checked every poll of the heartbeat settings,
+      // and the wheel goes round once in the longest time one can be set for
+      uint heartbeatSlots(const HeartbeatSettings& settings)
+      {
+        uint msTick = std::max(settings.msPollRate, 1);
+        return std::max(settings.msRate, settings.msTimeout) / msTick + 1;
+      }
+
+      // Read a request's colon separated job types into a list, reusing its
+      // storage
+      void parseJobTypes(const Frame& frame, std::vector<uint>& jobTypes)
+      {
+        jobTypes.clear();
+        uint type = 0;
+        for (const char* c = frame.data(); c != frame.data() + frame.size(); c++)
+        {
+          if (*c == ':')
+          {
+            jobTypes.push_back(type);
+            type = 0;
+          }
+          else
+            type = 10 * type + (*c - '0');
+        }
+        if (!frame.empty())
+          jobTypes.push_back(type);
       }
+    }
 
+    std::string delegatorSocketAddress(uint port)
+    {
+      return "ipc:///tmp/sl_delegator_" + std::to_string(port) + ".socket";
     }
 
-    Delegator::Delegator(zmq::context_t& context, const DelegatorSettings& settings, bool& running)
+    Delegator::Delegator(zmq::context_t& context, const DelegatorSettings& settings, bool& running,
+        Bridge* bridge, uint shard)
         : context_(context),
           requester_(context, ZMQ_ROUTER, "toRequester"),
-          heartbeat_(context, ZMQ_PAIR, "toHBRouter"),
           network_(context, ZMQ_ROUTER, "toNetwork"),
-          router_("main", {&requester_, &heartbeat_, &network_}),
+          router_("main", {&requester_, &network_}),
+          bridge_(bridge),
+          virtualTime_(0),
+          nQueuedJobs_(0),
+          nJobsInProgress_(0),
+          nJobsCancelled_(0),
+          nextWorkerSeq_(0),
+          scheduleNeeded_(false),
+          totalPipelineDepth_(0),
+          totalConcurrency_(0),
+          nJobsHedged_(0),
+          nHedgesWon_(0),
+          nColdStarts_(0),
           msPollRate_(settings.msPollRate),
           hbSettings_(settings.heartbeat),
+          riskAversion_(settings.riskAversion),
+          hedgeAfter_(settings.hedgeAfter),
+          affinityTolerance_(settings.affinityTolerance),
+          heartbeats_(std::chrono::milliseconds(std::max(settings.heartbeat.msPollRate, 1)),
+              heartbeatSlots(settings.heartbeat)),
+          deadlines_(DEADLINE_TICK, DEADLINE_SLOTS),
           running_(running),
-          nextJobId_(0),
-          nJobTypes_(settings.nJobTypes)
+          nJobTypes_(settings.nJobTypes),
+          firstJobType_(std::min(settings.firstJobType, settings.nJobTypes)),
+          port_(settings.port + shard),
+          nShards_(std::max(settings.nShards, 1U)),
+          shard_(shard),
+          workerCount_(0),
+          stats_ {0, 0, 0, 0.0, 0.0, 0, 0, 0, 0, 0, 0, 0, 0}
     {
       // Initialise the local sockets
-      requester_.bind(DELEGATOR_SOCKET_ADDR);
-      heartbeat_.bind(SERVER_HB_SOCKET_ADDR);
+      requester_.bind(delegatorSocketAddress(port_));
       network_.setFallback([&](const Message& m) { sendFailed(m); });
-      std::string address = "tcp://*:" + std::to_string(settings.port);
+      std::string address = "tcp://*:" + std::to_string(port_);
       network_.bind(address);
 
-      LOG(INFO) << "Delegator listening on tcp://*:" + std::to_string(settings.port);
+      LOG(INFO) << "Delegator listening on tcp://*:" + std::to_string(port_);
+
+      // Each tenant's job types come after those of the tenants before it
+      uint firstJobType = 0;
+      for (const TenantSettings& t : settings.tenants)
+      {
+        tenants_.push_back({t.name, std::max(t.weight, MIN_TENANT_WEIGHT), t.maxJobsInProgress,
+            firstJobType, t.nJobTypes, 0, 0, 0.0});
+        firstJobType += t.nJobTypes;
+      }
+      if (tenants_.empty())
+        tenants_.push_back({"", 1.0, 0, 0, settings.nJobTypes, 0, 0, 0.0});
 
       // Specify the Delegator functionality
       auto fDisconnect = [&](const Message& m) { disconnectWorker(m); };
-      auto fNewWorker = [&](const Message &m)
-      {
-        //forwarding to HEARTBEAT
-        heartbeat_.send(m);
-        std::string worker = m.address.front();
-        if (workers_.count(worker) == 0)
-          connectWorker(m);
-      };
+      auto fNewWorker = [&](const Message &m) { connectWorker(m); };
 
       auto fRcvRequest = [&](const Message &m) { receiveRequest(m); };
       auto fRcvResult = [&](const Message &m) { receiveResult(m); };
-      auto fForwardToHB = [&](const Message& m) { heartbeat_.send(m); };
-      auto fForwardToNetwork = [&](const Message& m) { network_.send(m); };
-      auto fForwardToHBAndDisconnect = [&](const Message& m)
-        { fForwardToHB(m); fDisconnect(m); };
+      auto fRcvBatchResult = [&](const Message &m) { receiveBatchResult(m); };
+      auto fRcvHeartbeat = [&](const Message& m) { receiveHeartbeat(m); };
 
       // Bind functionality to the router
-      const uint REQUESTER_SOCKET = 0, HB_SOCKET = 1, NETWORK_SOCKET = 2;
+      const uint REQUESTER_SOCKET = 0, NETWORK_SOCKET = 1;
 
       router_.bind(REQUESTER_SOCKET, REQUEST, fRcvRequest);
       router_.bind(NETWORK_SOCKET, HELLO, fNewWorker);
       router_.bind(NETWORK_SOCKET, RESULT, fRcvResult);
-      router_.bind(NETWORK_SOCKET, HEARTBEAT, fForwardToHB);
-      router_.bind(NETWORK_SOCKET, GOODBYE, fForwardToHBAndDisconnect);
-      router_.bind(HB_SOCKET, HEARTBEAT, fForwardToNetwork);
-      router_.bind(HB_SOCKET, GOODBYE, fDisconnect);
+      router_.bind(NETWORK_SOCKET, BATCHRESULT, fRcvBatchResult);
+      router_.bind(NETWORK_SOCKET, HEARTBEAT, fRcvHeartbeat);
+      router_.bind(NETWORK_SOCKET, GOODBYE, fDisconnect);
+
+      // Shards each listen for requests with their own wakeup, as any of
+      // them may leave requests on the bridge for the others
+      if (bridge_ && nShards_ > 1)
+      {
+        bridge_->addListener(requestWakeup_);
+        router_.bindFd(requestWakeup_.fd(), [&]()
+        {
+          requestWakeup_.clear();
+          receiveLocalRequests();
+        });
+      }
+      else if (bridge_)
+        router_.bindFd(bridge_->fd(), [&]() { receiveLocalRequests(); });
 
       auto fOnPoll = [&] () {onPoll();};
       router_.bindOnPoll(fOnPoll);
@@ -109,145 +208,975 @@ namespace stateline
 
     void Delegator::start()
     {
-      // Start the heartbeat thread and router
-      auto future = startInThread<ServerHeartbeat>(running_, std::ref(context_), std::cref(hbSettings_));
       router_.poll(msPollRate_, running_);
-      future.wait();
     }
 
     void Delegator::connectWorker(const Message& msg)
     {
+      // Workers send another HELLO whenever a minion joins them. Only the
+      // number of minions can change.
+      uint concurrency = 1;
+      if (msg.data.size() > 2)
+        concurrency = std::max(std::stoi(msg.data[2].str()), 1);
+      bool batching = msg.data.size() > 3 && msg.data[3].str() == "1";
+      bool cancels = msg.data.size() > 4 && msg.data[4].str() == "1";
+
+      Worker* existing = findWorker(msg.address.front());
+      if (existing)
+      {
+        existing->lastHeard = hrc::now();
+        if (msg.data.size() > 2)
+          setConcurrency(*existing, concurrency);
+        return;
+      }
+
+      // The first shard sends workers that understand REDIRECT to the shard
+      // their address hashes to, so the same worker always goes to the same
+      // one. The others stay here.
+      bool redirects = msg.data.size() > 5 && msg.data[5].str() == "1";
+      if (nShards_ > 1 && shard_ == 0 && redirects)
+      {
+        uint shard = std::hash<std::string>()(msg.address.front()) % nShards_;
+        if (shard != 0)
+        {
+          VLOG(1) << "Redirecting worker " << msg.address.front() << " to shard " << shard;
+          network_.send({msg.address, REDIRECT, {std::to_string(port_ + shard)}});
+          return;
+        }
+      }
+
       // Worker can now be 'connected'
       // add jobtypes
       std::pair<uint, uint> jobTypeRange;
-      if (msg.data[0] == "")
+      std::string jobTypesStr = msg.data[0].str();
+      if (jobTypesStr == "")
       {
-        jobTypeRange.first = 0;
+        jobTypeRange.first = firstJobType_;
         jobTypeRange.second = nJobTypes_;
       }
       else
       {
         std::vector<std::string> jobTypes;
-        splitStr(jobTypes, msg.data[0], ':');
+        splitStr(jobTypes, jobTypesStr, ':');
         assert(jobTypes.size() == 2);
         jobTypeRange.first = std::stoi(jobTypes[0]);
         jobTypeRange.second = std::stoi(jobTypes[1]);
       }
 
-      Worker w {msg.address, jobTypeRange};
-      for (uint i = jobTypeRange.first; i < jobTypeRange.second; i++)
-        w.times.emplace(i, CircularBuffer<uint>{10});
+      // Minions that predate the binary wire format only send the job types
+      WireFormat format = WireFormat::Text;
+      if (msg.data.size() > 1)
+        format = parseWireFormat(msg.data[1].str());
+
+      Worker w {msg.address, jobTypeRange, format, concurrency, batching, msg.packed, cancels,
+        nextWorkerSeq_++};
+      w.times.resize(jobTypeRange.second - jobTypeRange.first,
+          StatisticsWindow<uint>{TIME_WINDOW_LENGTH});
+      w.readyKeys.resize(jobTypeRange.second - jobTypeRange.first);
+      w.lastAssigned.resize(jobTypeRange.second - jobTypeRange.first, 0);
+      w.lastHeard = w.lastSent = hrc::now();
+
+      if (readyWorkers_.size() < jobTypeRange.second)
+      {
+        readyWorkers_.resize(jobTypeRange.second);
+        idleWorkers_.resize(jobTypeRange.second);
+        usTypical_.resize(jobTypeRange.second, -1);
+        nWorkersOfType_.resize(jobTypeRange.second, 0);
+      }
+      for (uint t = jobTypeRange.first; t < jobTypeRange.second; t++)
+        nWorkersOfType_[t]++;
 
+      // Reuse the slot of a worker that has left, if there is one
       std::string id = w.address.front();
-      workers_.insert(std::make_pair(id, w));
+      uint slot;
+      if (freeWorkerSlots_.empty())
+      {
+        slot = workers_.size();
+        w.generation = 1;
+        workers_.push_back(std::move(w));
+      }
+      else
+      {
+        slot = freeWorkerSlots_.back();
+        freeWorkerSlots_.pop_back();
+        w.generation = workers_[slot].generation + 1;
+        workers_[slot] = std::move(w);
+      }
+      Worker& worker = workers_[slot];
+      worker.slot = slot;
+      workerSlots_[id] = slot;
+
+      heartbeats_.add(handle(worker), worker.lastSent + std::chrono::milliseconds(hbSettings_.msRate));
+      updatePipelineDepth(worker);
+      queueWorker(worker);
+      totalConcurrency_ += concurrency;
       workerCount_++;
-      LOG(INFO)<< "Worker " << id << " connected, supporting jobtypes: " << msg.data[0];
+      LOG(INFO)<< "Worker " << id << " connected, supporting jobtypes: " << jobTypesStr
+        << " with wire format " << wireFormatString(format) << " and " << concurrency << " minions";
     }
 
     void Delegator::receiveRequest(const Message& msg)
     {
-      std::string id = joinStr(msg.address, ":");
-      std::set<std::string> jobTypes;
-      splitStr(jobTypes, msg.data[0], ':');
+      uint64_t id = requests_.acquire();
+      Request& r = requests_[id];
+      r.address = msg.address;
+      r.tenant = 0;
+      parseJobTypes(msg.data[0], r.jobTypes);
+      r.data = msg.data[1];
+      r.local = nullptr;
+
+      VLOG(2) << "New request Received, with " << r.jobTypes.size() << " jobs.";
+      // The requester's id for the sample is the first part of its address
+      r.chainId = std::strtoul(msg.address.front().c_str(), nullptr, 10);
+
+      // Requests that may be cut short end with the cut-off
+      r.rejectAbove = std::numeric_limits<double>::infinity();
+      r.minJobEnergy = 0.0;
+      if (msg.data.size() > 3)
+      {
+        r.rejectAbove = unserialise<double>(msg.data[2].data(), msg.data[2].size());
+        r.minJobEnergy = unserialise<double>(msg.data[3].data(), msg.data[3].size());
+      }
+      addRequest(id);
+    }
+
+    void Delegator::receiveLocalRequests()
+    {
+      Bridge::Request req;
+      std::function<bool(const Bridge::Request&)> covered;
+      if (nShards_ > 1)
+        covered = [&](const Bridge::Request& r) { return coversJobTypes(r); };
+      while ((nShards_ == 1 || nQueuedJobs_ < totalConcurrency_) &&
+          (nShards_ == 1 ? bridge_->receive(req) : bridge_->receive(req, covered)))
+      {
+        uint64_t id = requests_.acquire();
+        Request& r = requests_[id];
+        r.address.clear();
+        r.tenant = req.from->tenant() < tenants_.size() ? req.from->tenant() : 0;
+        r.jobTypes.assign(req.jobTypes.begin(), req.jobTypes.end());
+        for (const auto& f : req.finished)
+          r.jobTypes.push_back(f.first);
+        r.data = Frame(std::move(req.data));
+        r.local = req.from;
+        r.chainId = req.id;
+        r.rejectAbove = req.rejectAbove;
+        r.minJobEnergy = req.minJobEnergy;
+        addRequest(id, req.finished);
+      }
+    }
+
+    bool Delegator::coversJobTypes(const Bridge::Request& req) const
+    {
+      const Tenant& tenant = tenants_[req.from->tenant() < tenants_.size() ? req.from->tenant() : 0];
+      for (uint t : req.jobTypes)
+      {
+        // Any shard can refuse a type beyond the tenant's own
+        if (tenants_.size() > 1 && t >= tenant.nJobTypes)
+          return true;
+        uint type = t + tenant.firstJobType;
+        if (type >= nWorkersOfType_.size() || nWorkersOfType_[type] == 0)
+          return false;
+      }
+      return true;
+    }
 
-      std::set<uint> jobTypesInt;
-      std::transform(jobTypes.begin(), jobTypes.end(),
-                     std::inserter(jobTypesInt, jobTypesInt.begin()),
-                     [](const std::string& x) { return std::stoi(x); });
+    void Delegator::addRequest(uint64_t id, const std::vector<std::pair<uint, double>>& finished)
+    {
+      // Each job type is done once, and the results are in order of type
+      Request& r = requests_[id];
+      std::sort(r.jobTypes.begin(), r.jobTypes.end());
+      r.jobTypes.erase(std::unique(r.jobTypes.begin(), r.jobTypes.end()), r.jobTypes.end());
+      r.textData = Frame();
+      r.results.assign(r.jobTypes.size(), 0.0);
+      r.jobs.resize(r.jobTypes.size());
+      r.nDone = 0;
+      r.energy = 0.0;
 
+      // The tenant's job types are numbered among all of them. Those beyond
+      // its own would belong to another tenant, so a request for them is
+      // answered straight away as impossible.
+      const Tenant& tenant = tenants_[r.tenant];
+      if (tenants_.size() > 1 && !r.jobTypes.empty() && r.jobTypes.back() >= tenant.nJobTypes)
+      {
+        LOG(WARNING) << "Tenant " << tenant.name << " asked for job type " << r.jobTypes.back()
+          << " but only has " << tenant.nJobTypes;
+        std::fill(r.jobs.begin(), r.jobs.end(), 0);
+        r.results.assign(r.jobTypes.size(), std::numeric_limits<double>::infinity());
+        finishRequest(id, r);
+        return;
+      }
+      for (uint& t : r.jobTypes)
+        t += tenant.firstJobType;
 
-      VLOG(2) << "New request Received, with " << jobTypes.size() << " jobs.";
-      Request r {msg.address, jobTypesInt, msg.data[1], std::vector<std::string>(jobTypes.size()), 0};
-      requests_.insert(std::make_pair(id, r));
-      uint idx=0;
-      for (auto const& t : jobTypesInt)
+      auto now = std::chrono::high_resolution_clock::now();
+      for (uint idx = 0; idx < r.jobTypes.size(); idx++)
+      {
+        uint t = r.jobTypes[idx];
+        auto done = std::find_if(finished.begin(), finished.end(),
+            [&](const std::pair<uint, double>& f) { return f.first + tenant.firstJobType == t; });
+        if (done != finished.end())
+        {
+          r.results[idx] = done->second;
+          r.jobs[idx] = 0;
+          r.nDone++;
+          r.energy += done->second;
+          continue;
+        }
+
+        uint64_t jobId = jobs_.acquire();
+        Job& j = jobs_[jobId];
+        j = {jobId, t, id, r.tenant, idx, {}, 0, 0, now, {}, {}, 0, 0, false, false, false, 0}; //we're not starting with a job yet
+        r.jobs[idx] = jobId;
+        if (jobQueues_.size() <= t)
+          jobQueues_.resize(t + 1, JobQueue{0, 0});
+        enqueue(j, false);
+      }
+      if (r.nDone == r.jobTypes.size())
       {
-        Job j = {t, std::to_string(nextJobId_), id, idx, {}}; //we're not starting with a job yet
-        jobQueue_.push_back(j);
-        nextJobId_++;
-        idx++;
+        finishRequest(id, r);
+        return;
       }
+      scheduleNeeded_ = true;
       VLOG(2) << requests_.size() << " requests currently pending.";
     }
 
     void Delegator::receiveResult(const Message& msg)
+    {
+      Worker* found = findWorker(msg.address.front());
+      if (!found)
+        return;
+
+      Worker& worker = *found;
+      worker.lastHeard = hrc::now();
+      if (msg.packed)
+      {
+        double usService = msg.data.size() > 1 ?
+          unserialise<double>(msg.data[1].data(), msg.data[1].size()) : -1;
+        completeJob(worker, msg.header.jobId, msg.data[0], usService);
+      }
+      else
+      {
+        double usService = msg.data.size() > 2 ? std::stod(msg.data[2].str()) : -1;
+        completeJob(worker, std::stoull(msg.data[0].str()), msg.data[1], usService);
+      }
+    }
+
+    void Delegator::receiveBatchResult(const Message& msg)
     {
       std::string workerId = msg.address.front();
-      if (!workers_.count(workerId))
+      Worker* found = findWorker(workerId);
+      if (!found)
         return;
 
-      std::string jobID = msg.data[0];
-      auto& worker = workers_.find(workerId)->second;
+      Worker& worker = *found;
+      worker.lastHeard = hrc::now();
+      std::vector<std::string> jobIDs;
+      splitStr(jobIDs, msg.data[0].str(), ':');
+
+      // The service times come after the results, if the worker sends them
+      std::vector<std::string> usServices;
+      if (msg.data.size() == jobIDs.size() + 2)
+        splitStr(usServices, msg.data.back().str(), ':');
+      else if (msg.data.size() != jobIDs.size() + 1)
+      {
+        LOG(WARNING) << "Worker " << workerId << " sent " << msg.data.size() - 1
+          << " results for " << jobIDs.size() << " jobs";
+        return;
+      }
+
+      for (uint i = 0; i < jobIDs.size(); i++)
+      {
+        double usService = i < usServices.size() ? std::stod(usServices[i]) : -1;
+        completeJob(worker, std::stoull(jobIDs[i]), msg.data[i + 1], usService);
+      }
+    }
 
-      Job& j = worker.workInProgress[jobID];
+    void Delegator::completeJob(Worker& worker, uint64_t jobID, const Frame& result,
+        double usService)
+    {
+      Job* found = findJob(worker, jobID);
+      if (!found)
+        return;
+      Job& j = *found;
       // timing information
       auto now = std::chrono::high_resolution_clock::now();
-      // estimate time the worker spent on this job
-      auto elapsedTime = now - std::max(j.startTime, worker.lastResultTime);
-
-      uint usecs = std::chrono::duration_cast<std::chrono::microseconds>(elapsedTime).count();
-      worker.times.at(j.type).push_back(usecs);
-      worker.lastResultTime = now;
-      Request& r = requests_[j.requesterID];
-      r.results[j.requesterIndex] = msg.data[1];
+      uint usecs;
+      if (usService >= 0)
+      {
+        usecs = usService;
+        auto smooth = [](double& average, double sample)
+        {
+          average = average < 0 ? sample : average + ROUND_TRIP_SMOOTHING * (sample - average);
+        };
+        smooth(worker.usService, usService);
+
+        // A job that went straight to a minion spent the rest of its time
+        // getting to the worker and back
+        if (j.startedImmediately)
+        {
+          double usElapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+              now - j.startTime).count();
+          smooth(worker.usRoundTrip, std::max(usElapsed - usService, 0.0));
+        }
+      }
+      else
+      {
+        // estimate time the worker spent on this job
+        auto startTime = j.startTime;
+        if (worker.resultTimes.full())
+          startTime = std::max(startTime, worker.resultTimes.front());
+        auto elapsedTime = now - startTime;
+        usecs = std::chrono::duration_cast<std::chrono::microseconds>(elapsedTime).count();
+        worker.sentUntimedResult = true;
+      }
+      updatePipelineDepth(worker);
+
+      // A job that had to load its type's data first took longer than the
+      // worker will take for the next one, so only counts if it is the
+      // only measurement there is
+      auto& times = worker.times[j.type - worker.jobTypesRange.first];
+      if (!j.coldStart || times.empty())
+      {
+        times.push_back(usecs);
+        double& usTypical = usTypical_[j.type];
+        usTypical = usTypical < 0 ? usecs : usTypical + TYPICAL_TIME_SMOOTHING * (usecs - usTypical);
+      }
+      worker.resultTimes.push_back(now);
+
+      //remove job from work in progress store
+      Job job = j;
+      worker.usOutstanding = std::max(worker.usOutstanding - j.usEstimate, 0.0);
+      worker.usVarOutstanding = std::max(worker.usVarOutstanding - j.usVariance, 0.0);
+      worker.eraseJob(jobID);
+      unassign(job);
+      jobs_.release(jobID);
+      queueWorker(worker);
+
+      // The request is gone if it was cut short while the job was running,
+      // and only the first copy of a hedged job to finish counts
+      Request* request = requests_.find(job.request);
+      if (!request || request->jobs[job.requesterIndex] == 0)
+        return;
+      Request& r = *request;
+      r.jobs[job.requesterIndex] = 0;
+      if (job.twinId != 0)
+      {
+        if (job.isHedge)
+          nHedgesWon_++;
+        cancelJob(job.twinId, r.chainId);
+      }
+
+      double value = worker.format == WireFormat::Text ? std::stod(result.str()) :
+        unserialise<double>(result.data(), result.size());
+      r.results[job.requesterIndex] = value;
       r.nDone++;
 
       if (r.nDone == r.jobTypes.size())
       {
-        requester_.send({r.address, RESULT, r.results});
-        requests_.erase(j.requesterID);
+        finishRequest(job.request, r);
+        return;
+      }
+
+      if (!std::isinf(r.rejectAbove))
+      {
+        r.energy += value;
+        double minEnergy = r.energy + r.minJobEnergy * (r.jobTypes.size() - r.nDone);
+        if (minEnergy > r.rejectAbove)
+          rejectRequest(job.request, r);
       }
-      //remove job from work in progress store
-      worker.workInProgress.erase(jobID);
     }
 
-    Delegator::Worker* Delegator::bestWorker(uint jobType, uint maxJobs)
+    void Delegator::finishRequest(uint64_t id, Request& r)
     {
-      // TODO: can we do this using an STL algorithm?
-      Delegator::Worker* best = nullptr;
-      uint bestTime = std::numeric_limits<uint>::max();
-      for (auto& w : workers_)
+      if (r.local)
+        bridge_->send(*r.local, {r.chainId, r.results});
+      else
       {
-        if (jobType >= w.second.jobTypesRange.first &&
-            jobType <  w.second.jobTypesRange.second &&
-            w.second.workInProgress.size() < maxJobs)
+        std::vector<Frame> results;
+        results.reserve(r.results.size());
+        for (double x : r.results)
+          results.push_back(serialise(x));
+        requester_.send({r.address, RESULT, std::move(results)});
+      }
+      requests_.release(id);
+    }
+
+    void Delegator::rejectRequest(uint64_t id, Request& r)
+    {
+      VLOG(2) << "Request for sample " << r.chainId << " cut short with "
+        << r.jobTypes.size() - r.nDone << " jobs left";
+      for (uint idx = 0; idx < r.jobs.size(); idx++)
+      {
+        // A failed cancel disconnects a worker, which can move the request's
+        // other jobs, so each is looked up as it is reached
+        uint64_t jobId = r.jobs[idx];
+        if (jobId == 0)
+          continue;
+        r.results[idx] = std::numeric_limits<double>::infinity();
+        r.jobs[idx] = 0;
+        nJobsCancelled_++;
+
+        Job& job = jobs_[jobId];
+        if (!job.worker.valid())
         {
-          uint t = usTillDone(w.second, jobType);
-          if (t < bestTime)
-          {
-            best = &w.second;
-            bestTime = t;
-          }
+          // Still queued
+          dequeue(job);
+          jobs_.release(jobId);
+          continue;
         }
+
+        // Both copies of a hedged job are dropped
+        uint64_t twinId = job.twinId;
+        cancelJob(jobId, r.chainId);
+        if (twinId != 0)
+          cancelJob(twinId, r.chainId);
       }
-      return best;
+      finishRequest(id, r);
     }
 
-    void Delegator::onPoll()
+    void Delegator::cancelJob(uint64_t jobId, uint chainId)
+    {
+      // A worker that can't drop the job keeps it in progress until its
+      // result comes back, as its minion is still busy with it
+      Job* job = jobs_.find(jobId);
+      Worker* found = job ? findWorker(job->worker) : nullptr;
+      if (!found || !found->cancels)
+        return;
+      Worker& w = *found;
+
+      Message cancel = w.packed ?
+        Message(w.address, CANCEL, Header{jobId, job->type, chainId, 0}) :
+        Message(w.address, CANCEL, std::vector<std::string>{ std::to_string(jobId) });
+
+      // Book-keeping is done first, as a failed send disconnects the worker
+      w.usOutstanding = std::max(w.usOutstanding - job->usEstimate, 0.0);
+      w.usVarOutstanding = std::max(w.usVarOutstanding - job->usVariance, 0.0);
+      w.eraseJob(jobId);
+      unassign(*job);
+      jobs_.release(jobId);
+      queueWorker(w);
+      network_.send(cancel);
+    }
+
+    void Delegator::handBackUncoveredRequests()
     {
-      const uint maxJobs = 10;
-      auto i = std::begin(jobQueue_);
-      while (i != std::end(jobQueue_))
+      std::vector<uint64_t> uncovered;
+      for (uint t = 0; t < jobQueues_.size(); t++)
+        if (t >= nWorkersOfType_.size() || nWorkersOfType_[t] == 0)
+          for (uint64_t jobId = jobQueues_[t].front; jobId != 0; jobId = jobs_[jobId].next)
+            uncovered.push_back(jobs_[jobId].request);
+      std::sort(uncovered.begin(), uncovered.end());
+      uncovered.erase(std::unique(uncovered.begin(), uncovered.end()), uncovered.end());
+
+      // Handing a request back can disconnect a worker, and with it hand
+      // back others, so each is looked up as it is reached
+      for (uint64_t id : uncovered)
       {
-        auto worker = bestWorker(i->type, maxJobs);
-        if (!worker)
+        Request* r = requests_.find(id);
+        if (r && r->local)
+          handBackRequest(id, *r);
+      }
+    }
+
+    void Delegator::handBackRequest(uint64_t id, Request& r)
+    {
+      VLOG(1) << "Handing back request for sample " << r.chainId << " with "
+        << r.jobTypes.size() - r.nDone << " jobs left";
+
+      // The job types that are done keep their results, and the rest are
+      // handed back for the next shard to do
+      uint firstJobType = tenants_[r.tenant].firstJobType;
+      std::vector<uint> jobTypes;
+      std::vector<std::pair<uint, double>> finished;
+      std::vector<uint64_t> inProgress;
+      for (uint idx = 0; idx < r.jobs.size(); idx++)
+      {
+        uint64_t jobId = r.jobs[idx];
+        if (jobId == 0)
         {
-          ++i;
+          finished.emplace_back(r.jobTypes[idx] - firstJobType, r.results[idx]);
           continue;
         }
+        jobTypes.push_back(r.jobTypes[idx] - firstJobType);
+        Job& job = jobs_[jobId];
+        if (!job.worker.valid())
+        {
+          dequeue(job);
+          jobs_.release(jobId);
+          continue;
+        }
+        inProgress.push_back(jobId);
+        if (job.twinId != 0)
+          inProgress.push_back(job.twinId);
+      }
+
+      // The request is gone before any of its jobs are cancelled, as a
+      // failed cancel disconnects a worker
+      uint chainId = r.chainId;
+      bridge_->handBack({ r.local, chainId, std::move(jobTypes), r.data.str(),
+          r.rejectAbove, r.minJobEnergy, std::move(finished) });
+      requests_.release(id);
+
+      for (uint64_t jobId : inProgress)
+        cancelJob(jobId, chainId);
+    }
+
+    Delegator::Job* Delegator::findJob(const Worker& w, uint64_t id)
+    {
+      Job* job = jobs_.find(id);
+      return job && job->worker == handle(w) ? job : nullptr;
+    }
+
+    void Delegator::enqueue(Job& job, bool atFront)
+    {
+      JobQueue& queue = jobQueues_[job.type];
+      job.prev = job.next = 0;
+      if (queue.empty())
+        queue.front = queue.back = job.id;
+      else if (atFront)
+      {
+        job.next = queue.front;
+        jobs_[queue.front].prev = job.id;
+        queue.front = job.id;
+      }
+      else
+      {
+        job.prev = queue.back;
+        jobs_[queue.back].next = job.id;
+        queue.back = job.id;
+      }
+      nQueuedJobs_++;
+      scheduleNeeded_ = true;
+
+      // A tenant that had nothing waiting doesn't get to make up for the
+      // time it went without
+      Tenant& tenant = tenants_[job.tenant];
+      if (tenant.nQueued++ == 0)
+        tenant.pass = std::max(tenant.pass, virtualTime_);
+    }
+
+    void Delegator::dequeue(Job& job)
+    {
+      JobQueue& queue = jobQueues_[job.type];
+      (job.prev ? jobs_[job.prev].next : queue.front) = job.next;
+      (job.next ? jobs_[job.next].prev : queue.back) = job.prev;
+      job.prev = job.next = 0;
+      nQueuedJobs_--;
+      tenants_[job.tenant].nQueued--;
+    }
+
+    void Delegator::checkDeadline(uint64_t jobId)
+    {
+      // The job may have finished, or been sent again with a later deadline
+      // after its worker left, since the timer was set
+      Job* job = jobs_.find(jobId);
+      if (!job || job->twinId != 0 || job->deadline > hrc::now())
+        return;
+      Worker* w = findWorker(job->worker);
+      if (w)
+        hedge(*w, jobId);
+    }
+
+    void Delegator::hedge(Worker& slow, uint64_t jobId)
+    {
+      // Nothing is waiting for the job if its request was cut short
+      Job& job = jobs_[jobId];
+      Request* r = requests_.find(job.request);
+      if (!r || r->jobs[job.requesterIndex] == 0)
+        return;
+
+      // A copy counts against the tenant's limit like any other job, so it
+      // would take a slot the tenant isn't owed
+      if (tenants_[job.tenant].full())
+        return;
+
+      // The slow worker is the only one that can be passed over
+      Worker* idle = nullptr;
+      for (const auto& ready : idleWorkers_[job.type])
+        if (ready.second != &slow)
+        {
+          idle = ready.second;
+          break;
+        }
+      if (!idle)
+        return;
+
+      // Records don't move, so the job is still where it was
+      uint64_t copyId = jobs_.acquire();
+      Job& copy = jobs_[copyId];
+      copy = job;
+      copy.id = copyId;
+      copy.worker = WorkerHandle();
+      copy.enqueueTime = std::chrono::high_resolution_clock::now();
+      copy.isHedge = true;
+      copy.twinId = jobId;
+      job.twinId = copyId;
+      nJobsHedged_++;
+      VLOG(1) << "Job " << jobId << " is overdue at worker " << slow.address.front()
+        << ", sending a copy to " << idle->address.front();
+
+      assign(*idle, copy);
+      sendJob(*idle, copy, *r);
+    }
+
+    void Delegator::queueWorker(Worker& w)
+    {
+      unqueueWorker(w);
+      if (w.workInProgress.size() >= w.pipelineDepth)
+        return;
+
+      // The work in progress is shared between the minions
+      double usQueued = w.usOutstanding / w.concurrency;
+      double usVarQueued = w.usVarOutstanding / (w.concurrency * w.concurrency);
+      w.idle = w.workInProgress.size() < w.concurrency;
+      for (uint t = w.jobTypesRange.first; t < w.jobTypesRange.second; t++)
+      {
+        // Expected completion time, padded by the uncertainty in it
+        double usTime = timeForJob(w, t);
+        double usSpread = std::sqrt(usVarQueued + timeVarianceForJob(w, t));
+        double usKey = usQueued + usTime + riskAversion_ * usSpread;
+
+        // A worker that would have to load the job type's data first has
+        // to be enough sooner to be worth it. One that has never done the
+        // job type is expected to take as long as it does elsewhere,
+        // rather than its short initial guess.
+        if (affinityTolerance_ > 0 && !isWarm(w, t))
+        {
+          if (w.times[t - w.jobTypesRange.first].empty() && usTypical_[t] >= 0)
+            usKey += usTypical_[t] - usTime;
+          usKey *= 1 + affinityTolerance_;
+        }
+        // Workers with hours of work queued have keys beyond 32 bits, and
+        // converting a double that is out of range is undefined
+        uint64_t key = usKey > 0 ? std::min(usKey, MAX_READY_KEY) : 0;
+        w.readyKeys[t - w.jobTypesRange.first] = key;
+        readyWorkers_[t].insert(std::make_pair(std::make_pair(key, w.seq), &w));
+        if (w.idle)
+          idleWorkers_[t].insert(std::make_pair(std::make_pair(key, w.seq), &w));
+      }
+      w.ready = true;
+      scheduleNeeded_ = true;
+    }
+
+    void Delegator::setConcurrency(Worker& w, uint concurrency)
+    {
+      if (concurrency == w.concurrency)
+        return;
+
+      // Keep the newest result times
+      CircularBuffer<std::chrono::high_resolution_clock::time_point> resultTimes(concurrency);
+      for (auto t : w.resultTimes)
+        resultTimes.push_back(t);
+      w.resultTimes = resultTimes;
+      totalConcurrency_ += concurrency - w.concurrency;
+      w.concurrency = concurrency;
+      updatePipelineDepth(w);
+      queueWorker(w);
+      VLOG(1) << "Worker " << w.address.front() << " now has " << concurrency << " minions";
+    }
+
+    void Delegator::updatePipelineDepth(Worker& w)
+    {
+      // Each minion needs the job it is working on, plus enough queued
+      // behind it to last until the replacement for its result arrives
+      uint jobsPerMinion = INITIAL_JOBS_PER_MINION;
+      if (w.sentUntimedResult)
+        jobsPerMinion = MAX_JOBS_PER_MINION;
+      else if (w.usService >= 0 && w.usRoundTrip >= 0)
+        jobsPerMinion = 1 + std::ceil(std::min(w.usRoundTrip / std::max(w.usService, 1.0),
+              (double)MAX_JOBS_PER_MINION));
+      jobsPerMinion = std::min(jobsPerMinion, MAX_JOBS_PER_MINION);
+
+      // Don't shrink for the noise in the averages
+      if (!w.sentUntimedResult && jobsPerMinion + 1 == w.pipelineDepth / w.concurrency)
+        return;
+
+      uint depth = jobsPerMinion * w.concurrency;
+      if (depth == w.pipelineDepth)
+        return;
+
+      if (w.pipelineDepth > 0)
+        pipelineDepths_.erase(pipelineDepths_.find(w.pipelineDepth));
+      pipelineDepths_.insert(depth);
+      totalPipelineDepth_ += depth - w.pipelineDepth;
+      VLOG(3) << "Worker " << w.address.front() << " may now have " << depth << " jobs in progress";
+      w.pipelineDepth = depth;
+    }
+
+    void Delegator::unqueueWorker(Worker& w)
+    {
+      if (!w.ready)
+        return;
+
+      for (uint t = w.jobTypesRange.first; t < w.jobTypesRange.second; t++)
+      {
+        auto key = std::make_pair(w.readyKeys[t - w.jobTypesRange.first], w.seq);
+        readyWorkers_[t].erase(key);
+        if (w.idle)
+          idleWorkers_[t].erase(key);
+      }
+      w.ready = false;
+      w.idle = false;
+    }
+
+    bool Delegator::isWarm(const Worker& w, uint jobType) const
+    {
+      uint64_t last = w.lastAssigned[jobType - w.jobTypesRange.first];
+      return last > 0 && w.nAssigned - last < WARM_JOBS_PER_MINION * w.concurrency;
+    }
+
+    void Delegator::assign(Worker& worker, Job& job)
+    {
+      double usQueued = worker.usOutstanding / worker.concurrency;
+      double usVarQueued = worker.usVarOutstanding / (worker.concurrency * worker.concurrency);
+      job.startTime = std::chrono::high_resolution_clock::now();
+      worker.lastSent = job.startTime;
+      job.usEstimate = timeForJob(worker, job.type);
+      job.usVariance = timeVarianceForJob(worker, job.type);
+      job.startedImmediately = worker.workInProgress.size() < worker.concurrency;
+      double usWaited = std::chrono::duration_cast<std::chrono::microseconds>(
+          job.startTime - job.enqueueTime).count();
+      if (stats_.jobsDispatched == 0)
+        stats_.usDispatchLatency = usWaited;
+      else
+        stats_.usDispatchLatency += LATENCY_SMOOTHING * (usWaited - stats_.usDispatchLatency);
+      stats_.usMaxDispatchLatency = std::max(stats_.usMaxDispatchLatency, usWaited);
+      stats_.jobsDispatched++;
+
+      job.coldStart = !isWarm(worker, job.type);
+      if (job.coldStart)
+        nColdStarts_++;
+      worker.nAssigned++;
+      worker.lastAssigned[job.type - worker.jobTypesRange.first] = worker.nAssigned;
+
+      // The job is overdue once it has taken much longer than expected.
+      // There is nothing to expect until the worker has done its type.
+      job.deadline = std::chrono::high_resolution_clock::time_point::max();
+      if (hedgeAfter_ > 0 && !worker.times[job.type - worker.jobTypesRange.first].empty())
+      {
+        double usExpected = usQueued + job.usEstimate +
+          riskAversion_ * std::sqrt(usVarQueued + job.usVariance);
+        double usDeadline = std::max(hedgeAfter_ * usExpected, MIN_US_BEFORE_HEDGE);
+        job.deadline = job.startTime + std::chrono::microseconds((uint64_t)usDeadline);
+
+        // Copies aren't copied again
+        if (!job.isHedge)
+          deadlines_.add(job.id, job.deadline);
+      }
+
+      job.worker = handle(worker);
+      worker.workInProgress.push_back(job.id);
+      worker.usOutstanding += job.usEstimate;
+      worker.usVarOutstanding += job.usVariance;
+      nJobsInProgress_++;
+
+      // The tenant is charged for the time the job is expected to take. A
+      // worker that hasn't done the job type has only a short guess, so the
+      // job is charged as long as it typically takes elsewhere.
+      Tenant& tenant = tenants_[job.tenant];
+      double usCost = job.usEstimate;
+      if (worker.times[job.type - worker.jobTypesRange.first].empty() && usTypical_[job.type] >= 0)
+        usCost = usTypical_[job.type];
+      virtualTime_ = tenant.pass;
+      tenant.pass += std::max(usCost, 1.0) / tenant.weight;
+      tenant.nInProgress++;
+      queueWorker(worker);
+    }
+
+    void Delegator::unassign(const Job& job)
+    {
+      nJobsInProgress_--;
+      tenants_[job.tenant].nInProgress--;
+    }
+
+    void Delegator::dispatch(uint64_t jobId)
+    {
+      Job& job = jobs_[jobId];
+      auto best = readyWorkers_[job.type].begin();
+      Worker& worker = *best->second;
+      Request& r = requests_[job.request];
+
+      // Book-keeping is done first: a failed send disconnects the worker,
+      // which puts the jobs back in the queue
+      assign(worker, job);
+      std::vector<std::string> types, ids; // of the other jobs in a batch
+
+      // Jobs of a request are queued together, so the other jobs of this
+      // request are at the front of their queues unless they have been sent.
+      // Batch those that this worker is now the best choice for, so the
+      // scheduling is the same as if they were sent one at a time.
+      if (worker.batching)
+      {
+        for (uint t : r.jobTypes)
+        {
+          if (t == job.type || !worker.ready || t >= readyWorkers_.size() ||
+              readyWorkers_[t].empty() || readyWorkers_[t].begin()->second != &worker)
+            continue;
+
+          auto& queue = jobQueues_[t];
+          if (queue.empty() || jobs_[queue.front].request != job.request ||
+              tenants_[job.tenant].full())
+            continue;
+
+          Job& sibling = jobs_[queue.front];
+          dequeue(sibling);
+          assign(worker, sibling);
+          types.push_back(std::to_string(sibling.type));
+          ids.push_back(std::to_string(sibling.id));
+        }
+      }
+
+      if (ids.empty())
+      {
+        sendJob(worker, job, r);
+        return;
+      }
+
+      types.insert(types.begin(), std::to_string(job.type));
+      ids.insert(ids.begin(), std::to_string(job.id));
+      const Frame& data = jobData(worker, r);
+      Message batch {worker.address, BATCHJOB, {joinStr(types, ":"), joinStr(ids, ":"), data}};
+      if (worker.packed)
+        batch = {worker.address, BATCHJOB, Header{0, 0, r.chainId, 0}, batch.data};
+      network_.send(batch);
+    }
+
+    void Delegator::sendJob(Worker& worker, const Job& job, Request& r)
+    {
+      const Frame& data = jobData(worker, r);
+      if (worker.packed)
+        network_.send({worker.address, JOB, Header{job.id, job.type, r.chainId, 0}, {data}});
+      else
+        network_.send({worker.address, JOB,
+            {std::to_string(job.type), std::to_string(job.id), data}});
+    }
+
+    const Frame& Delegator::jobData(const Worker& worker, Request& r)
+    {
+      if (worker.format != WireFormat::Text)
+        return r.data;
+      if (r.textData.empty())
+        r.textData = binaryToText(r.data.str());
+      return r.textData;
+    }
+
+    Delegator::Worker* Delegator::findWorker(const std::string& id)
+    {
+      auto it = workerSlots_.find(id);
+      return it == workerSlots_.end() ? nullptr : &workers_[it->second];
+    }
+
+    Delegator::Worker* Delegator::findWorker(WorkerHandle worker)
+    {
+      if (!worker.valid() || worker.slot >= workers_.size())
+        return nullptr;
+      Worker& w = workers_[worker.slot];
+      return w.connected && w.generation == worker.generation ? &w : nullptr;
+    }
+
+    void Delegator::receiveHeartbeat(const Message& msg)
+    {
+      Worker* w = findWorker(msg.address.front());
+      if (w)
+        w->lastHeard = hrc::now();
+    }
+
+    void Delegator::checkHeartbeat(WorkerHandle worker)
+    {
+      Worker* found = findWorker(worker);
+      if (!found)
+        return;
+
+      Worker& w = *found;
+      std::string id = w.address.front();
+      auto now = hrc::now();
+      auto timeout = std::chrono::milliseconds(hbSettings_.msTimeout);
+      if (now - w.lastHeard > timeout)
+      {
+        LOG(INFO) << "Worker " << id << " timed out";
+        disconnectWorker(Message({ id }, GOODBYE));
+        return;
+      }
+
+      // Book-keeping is done first, as a failed send disconnects the worker
+      auto rate = std::chrono::milliseconds(hbSettings_.msRate);
+      bool sendHeartbeat = now - w.lastSent >= rate;
+      if (sendHeartbeat)
+        w.lastSent = now;
+      heartbeats_.add(worker, std::min(w.lastSent + rate, w.lastHeard + timeout));
+      if (sendHeartbeat)
+        network_.send({ w.address, HEARTBEAT });
+    }
 
-        std::string& data = requests_[i->requesterID].data;
-        network_.send({worker->address, JOB, {std::to_string(i->type), i->id, data}});
-        i->startTime = std::chrono::high_resolution_clock::now();
-        worker->workInProgress.insert(std::make_pair(i->id, *i));
+    void Delegator::onPoll()
+    {
+      std::unique_lock<std::mutex> lock(statsMutex_);
+
+      auto now = hrc::now();
+      heartbeats_.expire(now, [&](WorkerHandle worker) { checkHeartbeat(worker); });
+
+      // A shard may have room for requests that it wasn't woken for, as
+      // another shard was taking them or it was full at the time
+      if (bridge_ && nShards_ > 1)
+        receiveLocalRequests();
+
+      deadlines_.expire(now, [&](uint64_t jobId) { checkDeadline(jobId); });
+
+      // Repeatedly send the longest-waiting job that has a ready worker, of
+      // the tenant that is furthest behind its share and not at its limit.
+      // Each pass looks only at the front of each job type's queue and the
+      // front of its ready queue, so it doesn't depend on the number of
+      // workers. Nothing can be sent unless a job or a ready worker has been
+      // added, or a job has finished, since the last time.
+      while (scheduleNeeded_ && nQueuedJobs_ > 0)
+      {
+        JobQueue* next = nullptr;
+        for (uint t = 0; t < jobQueues_.size(); t++)
+        {
+          auto& queue = jobQueues_[t];
+          if (queue.empty() || t >= readyWorkers_.size() || readyWorkers_[t].empty())
+            continue;
+
+          const Job& j = jobs_[queue.front];
+          const Tenant& tenant = tenants_[j.tenant];
+          if (tenant.full())
+            continue;
+
+          if (!next)
+          {
+            next = &queue;
+            continue;
+          }
+          const Job& best = jobs_[next->front];
+          double bestPass = tenants_[best.tenant].pass;
+          if (tenant.pass < bestPass || (tenant.pass == bestPass && j.enqueueTime < best.enqueueTime))
+            next = &queue;
+        }
+        if (!next)
+          break;
 
-        // TODO: could we avoid removing this? What if we just mark it as being removed,
-        // and ignore it when we're polling? We can reap these 'zombie' jobs whenever
-        // they get removed from the front of the queue (assuming there's no job starvation).
-        // This way, we can keep using a queue instead of a list, so we can get
-        // better performance through cache locality.
-        jobQueue_.erase(i++);
+        uint64_t jobId = next->front;
+        dequeue(jobs_[jobId]);
+        dispatch(jobId);
       }
+      scheduleNeeded_ = false;
+
+      stats_.queueDepth = nQueuedJobs_;
+      stats_.jobsInProgress = nJobsInProgress_;
+      stats_.concurrency = totalConcurrency_;
+      stats_.pipelineDepth = totalPipelineDepth_;
+      stats_.minPipelineDepth = pipelineDepths_.empty() ? 0 : *pipelineDepths_.begin();
+      stats_.maxPipelineDepth = pipelineDepths_.empty() ? 0 : *pipelineDepths_.rbegin();
+      stats_.jobsCancelled = nJobsCancelled_;
+      stats_.jobsHedged = nJobsHedged_;
+      stats_.hedgesWon = nHedgesWon_;
+      stats_.coldStarts = nColdStarts_;
+    }
+
+    DelegatorStats Delegator::stats() const
+    {
+      std::unique_lock<std::mutex> lock(statsMutex_);
+      return stats_;
     }
 
     void Delegator::disconnectWorker(const Message& goodbyeFromWorker)
@@ -255,17 +1184,63 @@ namespace stateline
       //first address
       std::string workerId = goodbyeFromWorker.address.front();
 
-      if (!workers_.count(workerId))
+      Worker* found = findWorker(workerId);
+      if (!found)
         return;
 
-      auto w = workers_.find(workerId)->second;
-      for (auto const& j : w.workInProgress)
-        jobQueue_.push_front(j.second);
-      workers_.erase(workerId);
+      Worker& w = *found;
+      unqueueWorker(w);
+      bool typeUncovered = false;
+      for (uint t = w.jobTypesRange.first; t < w.jobTypesRange.second; t++)
+        typeUncovered |= --nWorkersOfType_[t] == 0;
+      for (uint64_t id : w.workInProgress)
+      {
+        Job& j = jobs_[id];
+        j.worker = WorkerHandle();
+
+        // Jobs of requests that were cut short, or that another copy of
+        // has finished, are dropped
+        Request* r = requests_.find(j.request);
+        if (!r || r->jobs[j.requesterIndex] == 0)
+        {
+          unassign(j);
+          jobs_.release(id);
+          continue;
+        }
+
+        // A hedged job carries on with its other copy
+        Job* twin = j.twinId != 0 ? jobs_.find(j.twinId) : nullptr;
+        if (twin && twin->worker.valid())
+        {
+          twin->twinId = 0;
+          r->jobs[j.requesterIndex] = twin->id;
+          unassign(j);
+          jobs_.release(id);
+          continue;
+        }
+
+        j.twinId = 0;
+        unassign(j);
+        enqueue(j, true);
+      }
+      pipelineDepths_.erase(pipelineDepths_.find(w.pipelineDepth));
+      totalPipelineDepth_ -= w.pipelineDepth;
+      totalConcurrency_ -= w.concurrency;
+
+      // The slot stays where it is, so callers still holding the worker
+      // can finish with it, and is reused by the next worker to connect
+      w.connected = false;
+      w.workInProgress.clear();
+      workerSlots_.erase(workerId);
+      freeWorkerSlots_.push_back(w.slot);
 
       workerCount_--;
 
       LOG(INFO)<< "Worker " << workerId << " disconnected: re-assigning their jobs";
+
+      // Other shards may still have workers for the jobs this one can't do
+      if (bridge_ && nShards_ > 1 && typeUncovered)
+        handBackUncoveredRequests();
     }
 
     void Delegator::sendFailed(const Message& msgToWorker)
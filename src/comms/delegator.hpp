@@ -11,16 +11,25 @@
 
 #pragma once
 
+#include "bridge.hpp"
+#include "datatypes.hpp"
 #include "settings.hpp"
 #include "messages.hpp"
+#include "payload.hpp"
 #include "router.hpp"
-#include "serverheartbeat.hpp"
+#include "socket.hpp"
 #include "common/circularbuffer.hpp"
+#include "common/slotpool.hpp"
+#include "common/timerwheel.hpp"
 
+#include <algorithm>
 #include <set>
 #include <string>
-#include <list>
+#include <deque>
+#include <map>
+#include <unordered_map>
 #include <atomic>
+#include <mutex>
 
 #include <zmq.hpp>
 
@@ -28,9 +37,56 @@ namespace stateline
 {
   namespace comms
   {
-    //! Address that the requesters connect their sockets to.
-    // const std::string DELEGATOR_SOCKET_ADDR = "inproc://delegator";
-    const std::string DELEGATOR_SOCKET_ADDR = "ipc:///tmp/sl_delegator.socket";
+    //! Address that requesters in other processes connect their sockets to.
+    //! It includes the port, so that servers on the same host don't collide.
+    //!
+    std::string delegatorSocketAddress(uint port);
+
+    //! Snapshot of the delegator's job queue, for monitoring.
+    //!
+    struct DelegatorStats
+    {
+      //! Number of jobs waiting for a worker.
+      uint queueDepth;
+
+      //! Number of jobs sent to workers that have not yet returned a result.
+      uint jobsInProgress;
+
+      //! Total number of jobs sent to workers.
+      uint64_t jobsDispatched;
+
+      //! Moving average of the time jobs spend queued before being sent
+      //! to a worker, in microseconds.
+      double usDispatchLatency;
+
+      //! Longest time a job has spent queued, in microseconds.
+      double usMaxDispatchLatency;
+
+      //! Sum over the workers of the number of jobs each can run at once,
+      //! one per minion.
+      uint concurrency;
+
+      //! Sum over the workers of the number of jobs each may have in
+      //! progress at once.
+      uint pipelineDepth;
+
+      //! Smallest and largest number of jobs a single worker may have in
+      //! progress at once.
+      uint minPipelineDepth;
+      uint maxPipelineDepth;
+
+      //! Total number of jobs dropped because their request was cut short.
+      uint64_t jobsCancelled;
+
+      //! Total number of overdue jobs that were copied to another worker,
+      //! and the number of those where the copy finished first.
+      uint64_t jobsHedged;
+      uint64_t hedgesWon;
+
+      //! Total number of jobs sent to a worker that hadn't done their job
+      //! type recently.
+      uint64_t coldStarts;
+    };
 
     //! Requester object that takes jobs and returns results. Communicates with
     //! a delegator living in a (possibly) different thread.
@@ -41,8 +97,13 @@ namespace stateline
         //! Create a new delegator.
         //!
         //! \param settings The configuration object.
+        //! \param bridge If not null, also take requests from requesters in
+        //!        this process through the bridge.
+        //! \param shard Which of the settings' shards this delegator is. It
+        //!        listens on the settings' port plus the shard.
         //!
-        Delegator(zmq::context_t& context, const DelegatorSettings& settings, bool& running);
+        Delegator(zmq::context_t& context, const DelegatorSettings& settings, bool& running,
+            Bridge* bridge = nullptr, uint shard = 0);
 
         // Delegators can't be copied.
         Delegator(const Delegator &other) = delete;
@@ -55,23 +116,96 @@ namespace stateline
 
         uint workerCount() const { return workerCount_.load(); }
 
+        //! Get the current job queue statistics. Safe to call from any thread.
+        //!
+        DelegatorStats stats() const;
+
       private:
+        //! Refers to a connected worker by its slot in the registry. A slot
+        //! is reused after its worker leaves, with the next generation, so a
+        //! handle to a worker that has gone doesn't find its successor.
+        //! Generations start at one; a handle with generation zero refers
+        //! to no worker.
+        struct WorkerHandle
+        {
+          uint slot;
+          uint generation;
+
+          bool valid() const { return generation != 0; }
+
+          bool operator==(const WorkerHandle& other) const
+          {
+            return slot == other.slot && generation == other.generation;
+          }
+        };
+
+        // Requests and jobs are records in pools, referred to by their ids.
+        // A reused record gets a new id, so a job id that comes back from a
+        // worker after its record was given back finds nothing. Job ids are
+        // what the workers are sent.
         struct Request
         {
           std::vector<std::string> address;
-          std::set<uint> jobTypes;
-          std::string data;
-          std::vector<std::string> results;
+          uint tenant;
+          std::vector<uint> jobTypes; // in ascending order, numbered among all tenants' types
+          Frame data; // binary wire format
+          Frame textData; // text wire format, created on demand
+          std::vector<double> results; // indexed like jobTypes
+          std::vector<uint64_t> jobs; // the job for each type, or zero once it has a result
           uint nDone;
+          Bridge::Endpoint* local; // requester in this process, or null
+          uint chainId; // the requester's id for the sample
+          double rejectAbove; // cut the request short above this energy
+          double minJobEnergy; // the least energy of any job
+          double energy; // sum of the results so far
         };
 
         struct Job
         {
+          uint64_t id;
           uint type;
-          std::string id;
-          std::string requesterID;
+          uint64_t request;
+          uint tenant;
           uint requesterIndex;
+          WorkerHandle worker; // where it is in progress, if anywhere
+          uint64_t prev; // neighbours in its type's queue while it is queued
+          uint64_t next;
+          std::chrono::high_resolution_clock::time_point enqueueTime;
           std::chrono::high_resolution_clock::time_point startTime;
+          std::chrono::high_resolution_clock::time_point deadline; // when it is overdue
+          double usEstimate; // expected run time when it was dispatched
+          double usVariance; // and its variance
+          bool startedImmediately; // whether a minion was idle when it was dispatched
+          bool coldStart; // whether the worker hadn't done its type recently
+          bool isHedge; // a copy of an overdue job
+          uint64_t twinId; // the other copy of a hedged job, if there is one
+        };
+
+        // A requester sharing the workers, which is given their time in
+        // proportion to its weight. Its pass is the estimated time of the
+        // jobs it has been given, divided by its weight, and the tenant with
+        // the lowest pass goes next.
+        struct Tenant
+        {
+          std::string name;
+          double weight;
+          uint maxJobsInProgress; // zero for no limit
+          uint firstJobType; // its job types start here among all of them
+          uint nJobTypes;
+          uint nQueued;
+          uint nInProgress;
+          double pass;
+
+          bool full() const { return maxJobsInProgress > 0 && nInProgress >= maxJobsInProgress; }
+        };
+
+        // Queued jobs of one type, linked through the jobs themselves
+        struct JobQueue
+        {
+          uint64_t front;
+          uint64_t back;
+
+          bool empty() const { return front == 0; }
         };
 
         struct Result
@@ -84,17 +218,92 @@ namespace stateline
         struct Worker
         {
           std::vector<std::string> address;
+
+          // The worker's slot in the registry, and the slot's generation.
+          // A slot whose worker has left isn't connected until it is reused.
+          uint slot;
+          uint generation;
+          bool connected;
+
           std::pair<uint, uint> jobTypesRange;
-          std::map<std::string, Job> workInProgress;
-          std::map<uint, CircularBuffer<uint>> times;
-          std::chrono::high_resolution_clock::time_point lastResultTime;
+          WireFormat format;
+          std::vector<uint64_t> workInProgress; // job ids, in no particular order
+          std::vector<StatisticsWindow<uint>> times; // indexed by job type - jobTypesRange.first
+
+          // Number of jobs the worker can run at once, one per minion
+          uint concurrency;
+
+          // Whether the worker understands BATCHJOB
+          bool batching;
+
+          // Whether the worker sent a packed header, so is sent them too
+          bool packed;
+
+          // Whether the worker understands CANCEL
+          bool cancels;
+
+          // Number of jobs the worker may have in progress at once: enough
+          // to keep its minions busy while results and new jobs are in
+          // transit between it and the delegator
+          uint pipelineDepth;
+
+          // Moving averages of the time a minion spends on a job, as
+          // reported by the worker, and of the rest of the time between
+          // dispatching a job to an idle minion and getting its result.
+          // Negative until measured.
+          double usService;
+          double usRoundTrip;
+          bool sentUntimedResult; // an old worker, so pipelineDepth is fixed
+
+          // The most recent result times, one per minion. A job can't have
+          // started before the oldest of these, as every minion was busy.
+          CircularBuffer<std::chrono::high_resolution_clock::time_point> resultTimes;
+
+          // Scheduling state. A worker that can take another job sits in the
+          // ready queue of each job type it supports, keyed by when it is
+          // expected to finish that job.
+          uint seq; // unique tie-breaker for equal keys
+          double usOutstanding; // sum of the estimates of the work in progress
+          double usVarOutstanding; // sum of their variances
+          bool ready;
+          bool idle; // in the idle queues as well, as a minion is free
+          std::vector<uint64_t> readyKeys; // indexed by job type - jobTypesRange.first
+
+          // Number of jobs assigned to the worker, and the number it had
+          // been assigned when it was last given each job type (zero if
+          // never), to tell which job types it has done recently
+          uint64_t nAssigned;
+          std::vector<uint64_t> lastAssigned; // indexed by job type - jobTypesRange.first
+
+          // When the worker last sent anything, and was last sent a job or
+          // a heartbeat. Either counts as a heartbeat.
+          hrc::time_point lastHeard;
+          hrc::time_point lastSent;
 
           Worker(std::vector<std::string> address,
-                 std::pair<uint, uint> jobTypesRange)
-            : address(std::move(address)), jobTypesRange(std::move(jobTypesRange)),
-            lastResultTime(std::chrono::high_resolution_clock::now())
+                 std::pair<uint, uint> jobTypesRange,
+                 WireFormat format, uint concurrency, bool batching, bool packed,
+                 bool cancels, uint seq)
+            : address(std::move(address)), slot(0), generation(0), connected(true),
+            jobTypesRange(std::move(jobTypesRange)),
+            format(format), concurrency(concurrency), batching(batching), packed(packed),
+            cancels(cancels),
+            pipelineDepth(0), usService(-1), usRoundTrip(-1),
+            sentUntimedResult(false),
+            resultTimes(concurrency),
+            seq(seq), usOutstanding(0), usVarOutstanding(0), ready(false), idle(false),
+            nAssigned(0)
           {
           }
+
+          //! Take a job out of progress. The last job in progress takes its
+          //! place.
+          void eraseJob(uint64_t id)
+          {
+            auto it = std::find(workInProgress.begin(), workInProgress.end(), id);
+            *it = workInProgress.back();
+            workInProgress.pop_back();
+          }
         };
 
       private:
@@ -102,17 +311,59 @@ namespace stateline
 
         void receiveRequest(const Message& m);
 
-        //! Connect a worker that has previously been sent a problem spec.
+        //! Note that a worker is still alive.
+        //!
+        //! \param m The HEARTBEAT message the worker sent.
+        //!
+        void receiveHeartbeat(const Message& m);
+
+        //! Disconnect a worker that hasn't been heard from for too long, or
+        //! send it a heartbeat if it hasn't been sent anything for a while.
+        //! Called when the worker's heartbeat timer fires.
+        //!
+        void checkHeartbeat(WorkerHandle worker);
+
+        //! The connected worker with the given address, or null.
+        //!
+        Worker* findWorker(const std::string& id);
+
+        //! The worker a handle refers to, or null if it has gone.
+        //!
+        Worker* findWorker(WorkerHandle worker);
+
+        WorkerHandle handle(const Worker& w) const { return { w.slot, w.generation }; }
+
+        //! Take the requests waiting on the bridge. A shard only takes
+        //! requests while it has fewer jobs queued than its workers can run
+        //! at once, and only those it has a worker for every job type of,
+        //! leaving the rest for the other shards.
+        //!
+        void receiveLocalRequests();
+
+        //! Whether a request from the bridge has a connected worker for each
+        //! of its job types.
+        //!
+        bool coversJobTypes(const Bridge::Request& req) const;
+
+        //! Queue the jobs of a new request.
+        //!
+        //! \param id The request's record, with everything but its results
+        //!        and jobs filled in.
+        //! \param finished Job types of the request that another shard has
+        //!        done, with their results, which aren't done again.
+        //!
+        void addRequest(uint64_t id, const std::vector<std::pair<uint, double>>& finished = {});
+
+        //! Connect a worker that has previously been sent a problem spec, or
+        //! update the number of minions of one that is already connected.
         //!
         //! \param m The JOBREQUEST message the connecting worker sent.
         //!
         void connectWorker(const Message& m);
 
-        //! Send a job to a worker that has requested one.
+        //! Send a single job to a worker it has been assigned to.
         //!
-        //! \param m the job request message.
-        //!
-        void sendJob(const Message& m);
+        void sendJob(Worker& worker, const Job& job, Request& r);
 
         //! Disconnect a worker by removing it from the list of connected workers.
         //!
@@ -132,29 +383,191 @@ namespace stateline
         //!
         void receiveResult(const Message& m);
 
-        // TODO: does this need to be a member function?
-        Worker* bestWorker(uint jobType, uint maxJobs);
+        //! Get the results of a batch of jobs from a worker.
+        //!
+        //! \param m The BATCHRESULT message.
+        //!
+        void receiveBatchResult(const Message& m);
+
+        //! Record the result of a job and pass it on to the requester if it
+        //! completes the request.
+        //!
+        //! \param worker The worker the result came from.
+        //! \param jobID The id of the job.
+        //! \param result The result, in the worker's wire format.
+        //! \param usService The time the worker reported its minion took,
+        //!        or negative if it didn't report one.
+        //!
+        void completeJob(Worker& worker, uint64_t jobID, const Frame& result,
+            double usService);
+
+        //! Send the results of a request to its requester and forget it.
+        //!
+        void finishRequest(uint64_t id, Request& r);
+
+        //! Finish a request whose results are already certain to add up to
+        //! more than its cut-off. Its remaining jobs are taken out of the
+        //! queues, and workers that understand CANCEL are told to drop those
+        //! they have. The results of the remaining jobs are infinite.
+        //!
+        void rejectRequest(uint64_t id, Request& r);
+
+        //! Tell the worker a job is in progress at to drop it, if it
+        //! understands CANCEL. The job is gone once the worker is told.
+        //!
+        void cancelJob(uint64_t jobId, uint chainId);
+
+        //! Hand back to the bridge the requests from it that have a job
+        //! queued of a type no worker here supports any more, for another
+        //! shard to take. Requests from other processes stay, as they can
+        //! only be answered through this shard's socket.
+        //!
+        void handBackUncoveredRequests();
+
+        //! Give up a request from the bridge. Its unfinished jobs are dropped
+        //! and done by the shard that takes it instead, which keeps the
+        //! results of the finished ones.
+        //!
+        void handBackRequest(uint64_t id, Request& r);
+
+        //! The job with the given id, if it is in progress at a worker.
+        //!
+        Job* findJob(const Worker& w, uint64_t id);
+
+        //! Add a job to its type's queue, at the back or, for jobs that
+        //! were already sent once, at the front.
+        //!
+        void enqueue(Job& job, bool atFront);
+
+        //! Take a job out of its type's queue.
+        //!
+        void dequeue(Job& job);
+
+        //! Send a copy of a job whose deadline timer has fired to a worker
+        //! with an idle minion, if it is still overdue. A job is only looked
+        //! at once: if every minion is busy then, a copy would only wait
+        //! behind their work.
+        //!
+        void checkDeadline(uint64_t jobId);
+
+        //! Send a copy of an overdue job to the best worker for it with an
+        //! idle minion, other than the one it is overdue at.
+        //!
+        void hedge(Worker& slow, uint64_t jobId);
+
+        //! Put a worker into the ready queues of its job types, re-keyed by
+        //! its current expected completion times, or leave it out if it
+        //! already has as many jobs as it may take.
+        //!
+        void queueWorker(Worker& w);
+
+        //! Change the number of jobs a worker can run at once.
+        //!
+        void setConcurrency(Worker& w, uint concurrency);
+
+        //! Work out how many jobs a worker may have in progress from its
+        //! concurrency and measured times.
+        //!
+        void updatePipelineDepth(Worker& w);
+
+        //! Take a worker out of all the ready queues.
+        //!
+        void unqueueWorker(Worker& w);
+
+        //! Send a queued job to the front worker of its type's ready queue.
+        //! Jobs of other types for the same request that the worker would be
+        //! sent next anyway are sent with it in a batch, if it takes them.
+        //!
+        void dispatch(uint64_t jobId);
+
+        //! The sample of a request in a worker's wire format.
+        //!
+        const Frame& jobData(const Worker& worker, Request& r);
+
+        //! Whether a worker has done a job type recently enough that it is
+        //! likely to still have the job type's data loaded.
+        //!
+        bool isWarm(const Worker& w, uint jobType) const;
+
+        //! Record that a job has been given to a worker.
+        //!
+        void assign(Worker& worker, Job& job);
+
+        //! Record that a job is no longer in progress at a worker.
+        //!
+        void unassign(const Job& job);
 
         zmq::context_t& context_;
 
         // Sockets
         Socket requester_;
-        Socket heartbeat_;
         Socket network_;
         SocketRouter router_;
+        Bridge* bridge_;
+        Wakeup requestWakeup_; // notified of requests on a shared bridge
 
-        std::map<std::string, Worker> workers_;
-        std::map<std::string, Request> requests_;
-        std::list<Job> jobQueue_;
+        // The workers, in slots that are reused once their worker leaves.
+        // The slots don't move as more are added. Messages from workers
+        // only carry their address, which is looked up once per message.
+        std::deque<Worker> workers_;
+        std::vector<uint> freeWorkerSlots_;
+        std::unordered_map<std::string, uint> workerSlots_; // by address
+
+        // Requests and their jobs, from the time they arrive until the
+        // results are sent back. The records are reused, so once there have
+        // been as many at once as there will be, none are allocated.
+        SlotPool<Request> requests_;
+        SlotPool<Job> jobs_;
+
+        // Ready workers ordered by (expected completion time, seq), and
+        // queued jobs in arrival order, both indexed by job type
+        std::vector<std::map<std::pair<uint64_t, uint>, Worker*>> readyWorkers_;
+        std::vector<std::map<std::pair<uint64_t, uint>, Worker*>> idleWorkers_; // ready with a minion free
+        std::vector<JobQueue> jobQueues_;
+        std::vector<uint> nWorkersOfType_; // connected workers supporting each type
+        std::vector<Tenant> tenants_;
+        double virtualTime_; // the pass of the tenant last given a job
+        uint nQueuedJobs_;
+        uint nJobsInProgress_;
+        uint64_t nJobsCancelled_;
+        uint nextWorkerSeq_;
+        bool scheduleNeeded_; // whether jobs or ready workers have been added
+        std::multiset<uint> pipelineDepths_; // one per worker
+        uint totalPipelineDepth_;
+        uint totalConcurrency_;
+
+        uint64_t nJobsHedged_;
+        uint64_t nHedgesWon_;
+        uint64_t nColdStarts_;
+
+        // Moving average of the time each job type takes on the workers
+        // that have done it, or negative until one has. Indexed by job type.
+        std::vector<double> usTypical_;
 
         uint msPollRate_;
         HeartbeatSettings hbSettings_;
+        double riskAversion_;
+        double hedgeAfter_;
+        double affinityTolerance_;
+
+        // Each worker has one timer, for when it next needs a heartbeat
+        // sending or times out
+        TimerWheel<WorkerHandle> heartbeats_;
+
+        // Each job that may be copied has one timer, for its deadline
+        TimerWheel<uint64_t> deadlines_;
 
         bool& running_;
-        uint nextJobId_;
 
         uint nJobTypes_; // Number of job types
+        uint firstJobType_; // of workers that don't say which they take
+        uint port_;
+        uint nShards_;
+        uint shard_;
         std::atomic<uint> workerCount_;
+
+        DelegatorStats stats_;
+        mutable std::mutex statsMutex_;
     };
 
   } // namespace comms
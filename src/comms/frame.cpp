@@ -0,0 +1,103 @@
+//!
+//! \file comms/frame.cpp
+//! \author agent
+//! \date 2026
+//! \license Lesser General Public License version 3 or later
+//! \copyright (c) 2014, NICTA
+//!
+
+#include "comms/frame.hpp"
+
+#include <cstring>
+
+namespace stateline
+{
+  namespace comms
+  {
+    namespace
+    {
+      // Below this size a copy is cheaper than sharing the bytes with zeromq,
+      // which has to allocate a reference counted content block for them.
+      const std::size_t MIN_SHARED_FRAME_SIZE = 256;
+
+      // Called by zeromq (possibly on one of its I/O threads) once it has
+      // finished sending a shared frame.
+      void releaseFrame(void* /*data*/, void* hint)
+      {
+        delete static_cast<std::shared_ptr<const void>*>(hint);
+      }
+    }
+
+    Frame::Frame()
+      : data_(nullptr), size_(0)
+    {
+    }
+
+    Frame::Frame(std::string data)
+      : data_(nullptr), size_(0)
+    {
+      if (data.size() < MIN_SHARED_FRAME_SIZE)
+      {
+        bytes_ = std::move(data);
+      }
+      else
+      {
+        auto owner = std::make_shared<const std::string>(std::move(data));
+        data_ = owner->data();
+        size_ = owner->size();
+        owner_ = std::move(owner);
+      }
+    }
+
+    Frame::Frame(const char* data)
+      : bytes_(data), data_(nullptr), size_(0)
+    {
+    }
+
+    Frame::Frame(zmq::message_t&& message)
+      : data_(nullptr), size_(0)
+    {
+      if (message.size() < MIN_SHARED_FRAME_SIZE)
+      {
+        bytes_.assign(static_cast<const char*>(message.data()), message.size());
+      }
+      else
+      {
+        auto owner = std::make_shared<zmq::message_t>(std::move(message));
+        data_ = static_cast<const char*>(owner->data());
+        size_ = owner->size();
+        owner_ = std::move(owner);
+      }
+    }
+
+    zmq::message_t Frame::message() const
+    {
+      if (!owner_)
+      {
+        zmq::message_t message(bytes_.size());
+        memcpy(message.data(), bytes_.data(), bytes_.size());
+        return message;
+      }
+
+      // Zeromq never writes to the bytes of a message it is sending
+      return zmq::message_t(const_cast<char*>(data_), size_, releaseFrame,
+          new std::shared_ptr<const void>(owner_));
+    }
+
+    bool operator==(const Frame& a, const Frame& b)
+    {
+      return a.size() == b.size() && memcmp(a.data(), b.data(), a.size()) == 0;
+    }
+
+    bool operator!=(const Frame& a, const Frame& b)
+    {
+      return !(a == b);
+    }
+
+    std::ostream& operator<<(std::ostream& os, const Frame& f)
+    {
+      return os.write(f.data(), f.size());
+    }
+
+  } // namespace comms
+} // namespace stateline
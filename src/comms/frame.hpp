@@ -0,0 +1,107 @@
+//!
+//! Contains the representation of a single frame of a network message.
+//!
+//! \file comms/frame.hpp
+//! \author agent
+//! \date 2026
+//! \license Lesser General Public License version 3 or later
+//! \copyright (c) 2014, NICTA
+//!
+
+#pragma once
+
+#include <memory>
+#include <ostream>
+#include <string>
+
+#include <zmq.hpp>
+
+namespace stateline
+{
+  namespace comms
+  {
+    //! An immutable block of bytes sent as one frame of a message. Large
+    //! frames are reference counted: copying one only copies a reference to
+    //! the bytes, so the same payload can be forwarded many times without
+    //! being copied. Large frames that were received keep the underlying
+    //! zmq::message_t alive instead of copying it into a string, and are
+    //! handed to zeromq with zmq_msg_init_data so sending them does not copy
+    //! either. Small frames (ids, job types etc) are simply held by value.
+    //!
+    class Frame
+    {
+      public:
+        //! Create an empty frame.
+        //!
+        Frame();
+
+        //! Create a frame that takes ownership of a string.
+        //!
+        //! \param data The bytes of the frame.
+        //!
+        Frame(std::string data);
+
+        //! Create a frame from a null terminated string.
+        //!
+        //! \param data The bytes of the frame, excluding the terminator.
+        //!
+        Frame(const char* data);
+
+        //! Create a frame that takes ownership of a received zeromq message.
+        //!
+        //! \param message The message that was received.
+        //!
+        explicit Frame(zmq::message_t&& message);
+
+        //! Get a pointer to the bytes of the frame.
+        //!
+        const char* data() const { return owner_ ? data_ : bytes_.data(); }
+
+        //! Get the number of bytes in the frame.
+        //!
+        std::size_t size() const { return owner_ ? size_ : bytes_.size(); }
+
+        //! Check whether the frame contains any bytes.
+        //!
+        bool empty() const { return size() == 0; }
+
+        //! Copy the bytes of the frame into a string.
+        //!
+        std::string str() const { return std::string(data(), size()); }
+
+        //! Check whether the bytes of this frame are shared between copies.
+        //!
+        bool shared() const { return static_cast<bool>(owner_); }
+
+        //! Build a zeromq message for sending this frame. Small frames are
+        //! copied (zeromq stores them inline anyway), larger frames share
+        //! their bytes with the message until zeromq has sent them.
+        //!
+        //! \return A message ready to be sent.
+        //!
+        zmq::message_t message() const;
+
+      private:
+        // Small frames
+        std::string bytes_;
+
+        // Large frames
+        std::shared_ptr<const void> owner_;
+        const char* data_;
+        std::size_t size_;
+    };
+
+    //! Compare the bytes of two frames.
+    //!
+    bool operator==(const Frame& a, const Frame& b);
+
+    //! Compare the bytes of two frames.
+    //!
+    bool operator!=(const Frame& a, const Frame& b);
+
+    //! Print the bytes of a frame for logging and testing purposes.
+    //!
+    std::ostream& operator<<(std::ostream& os, const Frame& f);
+
+  } // namespace comms
+} // namespace stateline
@@ -9,6 +9,7 @@
 #include "comms/messages.hpp"
 
 #include <algorithm>
+#include <cstring>
 #include <ostream>
 
 namespace stateline
@@ -30,23 +31,71 @@ namespace stateline
         case JOB: return "JOB";
         case RESULT: return "RESULT";
         case GOODBYE: return "GOODBYE";
+        case BATCHJOB: return "BATCHJOB";
+        case BATCHRESULT: return "BATCHRESULT";
+        case CANCEL: return "CANCEL";
+        case REDIRECT: return "REDIRECT";
         default: return "UNKNOWN";
       }
     }
 
-    Message::Message(Address address, Subject subject, std::vector<std::string> data)
-      : address(std::move(address)), subject(std::move(subject)), data(std::move(data))
+    Message::Message(Address address, Subject subject, std::vector<Frame> data)
+      : address(std::move(address)), subject(std::move(subject)), data(std::move(data)),
+        packed(false), header()
     {
     }
 
-    Message::Message(Subject subject, std::vector<std::string> data)
-        : subject(std::move(subject)), data(std::move(data))
+    Message::Message(Subject subject, std::vector<Frame> data)
+        : subject(std::move(subject)), data(std::move(data)), packed(false), header()
+    {
+    }
+
+    Message::Message(Address address, Subject subject, const Header& header, std::vector<Frame> data)
+      : address(std::move(address)), subject(subject), data(std::move(data)),
+        packed(true), header(header)
+    {
+    }
+
+    Message::Message(Subject subject, const Header& header, std::vector<Frame> data)
+        : subject(subject), data(std::move(data)), packed(true), header(header)
     {
     }
 
     bool Message::operator==(const Message& m) const
     {
-      return address == m.address && subject == m.subject && data == m.data;
+      bool sameHeader = !packed || (header.jobId == m.header.jobId &&
+          header.jobType == m.header.jobType && header.chainId == m.header.chainId &&
+          header.flags == m.header.flags);
+      return address == m.address && subject == m.subject && data == m.data &&
+        packed == m.packed && sameHeader;
+    }
+
+    // Fields are little-endian, as the host is on all supported platforms
+    Frame packHeader(const Message& m)
+    {
+      std::string bytes(PACKED_HEADER_SIZE, '\0');
+      bytes[0] = PACKED_HEADER_VERSION;
+      bytes[1] = (uint8_t)m.subject;
+      bytes[2] = m.header.flags;
+      std::memcpy(&bytes[4], &m.header.jobType, 4);
+      std::memcpy(&bytes[8], &m.header.jobId, 8);
+      std::memcpy(&bytes[16], &m.header.chainId, 4);
+      return Frame(std::move(bytes));
+    }
+
+    bool unpackHeader(const Frame& frame, Message& m)
+    {
+      const char* bytes = frame.data();
+      if (frame.size() != PACKED_HEADER_SIZE || (uint8_t)bytes[0] != PACKED_HEADER_VERSION)
+        return false;
+
+      m.subject = (Subject)(uint8_t)bytes[1];
+      m.header.flags = bytes[2];
+      std::memcpy(&m.header.jobType, bytes + 4, 4);
+      std::memcpy(&m.header.jobId, bytes + 8, 8);
+      std::memcpy(&m.header.chainId, bytes + 16, 4);
+      m.packed = true;
+      return true;
     }
 
     std::string addressAsString(const Address& address)
@@ -63,7 +112,10 @@ namespace stateline
 
     std::ostream& operator<<(std::ostream& os, const Message& m)
     {
-      os << "|" << addressAsString(m.address) << "|" << subjectString(m.subject) << "|<" << m.data.size() << " data frames>|";
+      os << "|" << addressAsString(m.address) << "|" << subjectString(m.subject);
+      if (m.packed)
+        os << " job " << m.header.jobId << " type " << m.header.jobType << " chain " << m.header.chainId;
+      os << "|<" << m.data.size() << " data frames>|";
       return os;
     }
 
@@ -10,10 +10,12 @@
 
 #pragma once
 
+#include <cstdint>
 #include <string>
 #include <vector>
 
 #include "datatypes.hpp"
+#include "frame.hpp"
 
 namespace stateline
 {
@@ -34,10 +36,34 @@ namespace stateline
       JOB = 3,
       RESULT = 4,
       GOODBYE = 5,
+      BATCHJOB = 6,
+      BATCHRESULT = 7,
+      CANCEL = 8,
+      REDIRECT = 9,
       Size
     };
 
+    //! The fields of a packed header frame besides the subject. Peers that
+    //! understand packed headers use them in place of the decimal subject
+    //! frame, and carry job ids and types in them rather than as strings in
+    //! the data frames (see MESSAGES.SPEC).
+    //!
+    struct Header
+    {
+      uint64_t jobId;
+      uint32_t jobType;
+      uint32_t chainId; // the requester's id for the sample
+      uint8_t flags; // reserved, zero
+    };
+
+    //! The number of bytes in a packed header frame.
+    const std::size_t PACKED_HEADER_SIZE = 20;
+
+    //! The first byte of a packed header frame.
+    const uint8_t PACKED_HEADER_VERSION = 1;
+
     //! Define valid messages to send between delegators and workers.
+    //! Copying a message shares its data frames rather than copying them.
     //!
     struct Message
     {
@@ -48,7 +74,7 @@ namespace stateline
       //! \param data A vector of data to send in the message. Each element of
       //!          the vector is sent as a separate frame.
       //!
-      Message(Address address, Subject subject, std::vector<std::string> data = {});
+      Message(Address address, Subject subject, std::vector<Frame> data = {});
 
       //! Create a new message with no address.
       //!
@@ -56,7 +82,50 @@ namespace stateline
       //! \param data A vector of data to send in the message. Each element of
       //!          the vector is sent as a separate frame.
       //!
-      Message(Subject subject, std::vector<std::string> data = {});
+      Message(Subject subject, std::vector<Frame> data = {});
+
+      //! Build a message that is sent with a packed header.
+      //!
+      //! \param address The address to send the message to.
+      //! \param subject The subject of the message (eg. HELLO, JOB etc).
+      //! \param header The other fields of the header.
+      //! \param data The data frames of the message.
+      //!
+      Message(Address address, Subject subject, const Header& header, std::vector<Frame> data = {});
+
+      //! Build a message with no address that is sent with a packed header.
+      //!
+      //! \param subject The subject of the message (eg. HELLO, JOB etc).
+      //! \param header The other fields of the header.
+      //! \param data The data frames of the message.
+      //!
+      Message(Subject subject, const Header& header, std::vector<Frame> data = {});
+
+      //! Build a message from any container of values convertible to frames
+      //! (eg. a vector of strings).
+      //!
+      //! \param address The address to send the message to.
+      //! \param subject The subject of the message (eg. HELLO, JOB etc).
+      //! \param data The data to send in the message, one frame per element.
+      //!
+      template <class Container>
+      Message(Address address, Subject subject, const Container& data)
+        : address(std::move(address)), subject(subject),
+          data(std::begin(data), std::end(data)), packed(false), header()
+      {
+      }
+
+      //! Build a message with no address from any container of values
+      //! convertible to frames (eg. a vector of strings).
+      //!
+      //! \param subject The subject of the message (eg. HELLO, JOB etc).
+      //! \param data The data to send in the message, one frame per element.
+      //!
+      template <class Container>
+      Message(Subject subject, const Container& data)
+        : subject(subject), data(std::begin(data), std::end(data)), packed(false), header()
+      {
+      }
 
       //! Equality comparator for testing purposes.
       //!
@@ -79,9 +148,30 @@ namespace stateline
       Subject subject;
 
       //! The data that this message contains.
-      std::vector<std::string> data;
+      std::vector<Frame> data;
+
+      //! Whether the message is sent (or was received) with a packed header.
+      bool packed;
+
+      //! The fields of the packed header, if there is one.
+      Header header;
     };
 
+    //! Encode the subject and header of a message as a packed header frame.
+    //!
+    //! \param m The message.
+    //! \return The header frame.
+    //!
+    Frame packHeader(const Message& m);
+
+    //! Decode a packed header frame into the subject and header of a message.
+    //!
+    //! \param frame The frame holding the header.
+    //! \param m The message to fill in.
+    //! \return False if the frame isn't a packed header.
+    //!
+    bool unpackHeader(const Frame& frame, Message& m);
+
     //! Convert an address to a string.
     //!
     //! \param addr The address to convert.
@@ -7,7 +7,8 @@
 //!
 
 #include "comms/minion.hpp"
-#include "common/string.hpp"
+#include "comms/payload.hpp"
+#include "app/serial.hpp"
 
 #include <easylogging/easylogging++.h>
 
@@ -19,7 +20,7 @@ namespace stateline
         : socket_(context, ZMQ_DEALER, "toWorker")
     {
       socket_.connect(socketAddr.c_str());
-      socket_.send({HELLO,{""}});
+      socket_.send({HELLO, Header{0, 0, 0, 0}, {"", wireFormatString(LATEST_WIRE_FORMAT)}});
     }
 
     Minion::Minion(zmq::context_t& context, const std::pair<uint, uint>& jobTypesRange,
@@ -29,28 +30,24 @@ namespace stateline
       socket_.connect(socketAddr.c_str());
       std::string jobstring = std::to_string(jobTypesRange.first) + ":" +
                               std::to_string(jobTypesRange.second);
-      socket_.send({HELLO,{jobstring}});
+      socket_.send({HELLO, Header{0, 0, 0, 0}, {jobstring, wireFormatString(LATEST_WIRE_FORMAT)}});
     }
 
     std::pair<uint, std::vector<double>> Minion::nextJob()
     {
       VLOG(3) << "Minion waiting on next job";
       stateline::comms::Message r = socket_.receive();
-      currentJob_ = r.data[1];
+      currentJob_ = r.header.jobId;
 
-      std::vector<std::string> sampleVectorStr;
-      splitStr(sampleVectorStr, r.data[2], ':');
+      // We asked for the binary wire format and packed headers in our HELLO
+      std::vector<double> sample = unserialise<std::vector<double>>(r.data[0].data(), r.data[0].size());
 
-      std::vector<double> sample(sampleVectorStr.size());
-      for (uint i = 0; i < sample.size(); i++)
-        sample[i] = std::stod(sampleVectorStr[i]);
-
-      return std::make_pair(std::stoi(r.data[0]), sample);
+      return std::make_pair(r.header.jobType, sample);
     }
 
     void Minion::submitResult(double result)
     {
-      socket_.send({RESULT,{currentJob_, std::to_string(result)}});
+      socket_.send({RESULT, Header{currentJob_, 0, 0, 0}, {serialise(result)}});
     }
 
   } // namespace comms
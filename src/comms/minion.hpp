@@ -63,7 +63,7 @@ namespace stateline
 
     private:
       Socket socket_;
-      std::string currentJob_;
+      uint64_t currentJob_;
     };
   } // namespace comms
 } // namespace stateline
@@ -0,0 +1,67 @@
+//!
+//! \file comms/payload.cpp
+//! \author agent
+//! \date 2026
+//! \license Lesser General Public License version 3 or later
+//! \copyright (c) 2014, NICTA
+//!
+
+#include "comms/payload.hpp"
+
+#include "app/serial.hpp"
+#include "common/string.hpp"
+
+#include <cstdio>
+#include <vector>
+
+namespace stateline
+{
+  namespace comms
+  {
+    std::string wireFormatString(WireFormat f)
+    {
+      return std::to_string(static_cast<uint>(f));
+    }
+
+    WireFormat parseWireFormat(const std::string& s)
+    {
+      if (s.empty())
+        return WireFormat::Text;
+
+      uint version = std::stoul(s);
+      if (version >= static_cast<uint>(LATEST_WIRE_FORMAT))
+        return LATEST_WIRE_FORMAT;
+      return static_cast<WireFormat>(version);
+    }
+
+    std::string binaryToText(const std::string& payload)
+    {
+      std::vector<double> values = unserialise<std::vector<double>>(payload);
+
+      // 17 significant digits is enough to round-trip any double exactly
+      std::string result;
+      char buffer[32];
+      for (uint i = 0; i < values.size(); i++)
+      {
+        if (i > 0)
+          result += ':';
+        int n = std::snprintf(buffer, sizeof(buffer), "%.17g", values[i]);
+        result.append(buffer, n);
+      }
+      return result;
+    }
+
+    std::string textToBinary(const std::string& payload)
+    {
+      std::vector<std::string> fields;
+      splitStr(fields, payload, ':');
+
+      std::vector<double> values(fields.size());
+      for (uint i = 0; i < values.size(); i++)
+        values[i] = std::stod(fields[i]);
+
+      return serialise(values);
+    }
+
+  } // namespace comms
+} // namespace stateline
@@ -0,0 +1,68 @@
+//!
+//! Contains the encodings used for job and result payloads on the wire.
+//!
+//! \file comms/payload.hpp
+//! \author agent
+//! \date 2026
+//! \license Lesser General Public License version 3 or later
+//! \copyright (c) 2014, NICTA
+//!
+
+#pragma once
+
+#include <string>
+
+#include "datatypes.hpp"
+
+namespace stateline
+{
+  namespace comms
+  {
+    //! Versions of the encoding used for the data of JOB messages and the
+    //! result of RESULT messages. A minion announces the newest version it
+    //! understands in its HELLO message. Minions that don't announce a
+    //! version are assumed to speak the original text encoding.
+    //!
+    enum class WireFormat
+    {
+      //! Doubles printed as decimal text and joined with ':'.
+      Text = 0,
+
+      //! Raw little-endian doubles (see app/serial.hpp).
+      Binary = 1
+    };
+
+    //! The newest wire format that this build understands.
+    const WireFormat LATEST_WIRE_FORMAT = WireFormat::Binary;
+
+    //! Convert a wire format into the string sent in a HELLO message.
+    //!
+    //! \param f The wire format to convert.
+    //! \return The version number of the format as a string.
+    //!
+    std::string wireFormatString(WireFormat f);
+
+    //! Parse the wire format version sent in a HELLO message. Versions newer
+    //! than this build understands are clamped to the latest known format.
+    //!
+    //! \param s The version string. An empty string means the text format.
+    //! \return The wire format to use when talking to the sender.
+    //!
+    WireFormat parseWireFormat(const std::string& s);
+
+    //! Convert a binary payload of doubles into the text wire format.
+    //!
+    //! \param payload Raw doubles as produced by serialise().
+    //! \return The doubles printed at full precision and joined with ':'.
+    //!
+    std::string binaryToText(const std::string& payload);
+
+    //! Convert a text payload of ':' separated doubles into the binary wire format.
+    //!
+    //! \param payload Text as sent by a text format minion.
+    //! \return Raw doubles as produced by serialise().
+    //!
+    std::string textToBinary(const std::string& payload);
+
+  } // namespace comms
+} // namespace stateline
@@ -0,0 +1,195 @@
+//!
+//! Contains the implementation of the relay.
+//!
+//! \file comms/relay.cpp
+//! \author agent
+//! \date 2026
+//! \license Lesser General Public License version 3 or later
+//! \copyright (c) 2014, NICTA
+//!
+
+#include "comms/relay.hpp"
+
+#include "comms/payload.hpp"
+#include "common/string.hpp"
+#include "app/serial.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <future>
+#include <easylogging/easylogging++.h>
+
+namespace stateline
+{
+  namespace comms
+  {
+    namespace
+    {
+      // The relay's workers that don't say which job types they take are
+      // sent all of those the relay takes
+      DelegatorSettings delegatorSettings(const RelaySettings& settings)
+      {
+        DelegatorSettings delegator = settings.delegator;
+        delegator.firstJobType = settings.jobTypesRange.first;
+        delegator.nJobTypes = settings.jobTypesRange.second;
+        return delegator;
+      }
+    }
+
+    Relay::Relay(zmq::context_t& context, const RelaySettings& settings, bool& running)
+      : network_(context, ZMQ_DEALER, "toNetwork"),
+        router_("relay", {&network_}),
+        endpoint_(bridge_.connect()),
+        delegator_(context, delegatorSettings(settings), running, &bridge_),
+        msPollRate_(settings.msPollRate),
+        hbSettings_(settings.heartbeat),
+        jobTypes_(std::to_string(settings.jobTypesRange.first) + ":" +
+            std::to_string(settings.jobTypesRange.second)),
+        running_(running),
+        nextRequestId_(0),
+        concurrency_(0)
+    {
+      network_.setIdentifier();
+      LOG(INFO) << "Relay connecting to " << settings.networkAddress;
+      network_.connect("tcp://" + settings.networkAddress);
+
+      auto fRcvJob = [&](const Message& m) { receiveJob(m); };
+      auto fRcvBatch = [&](const Message& m) { receiveBatch(m); };
+
+      // Everything the delegator sends is a heartbeat, and the relay says it
+      // doesn't understand CANCEL, so neither needs an answer
+      auto ignore = [](const Message&) {};
+
+      const uint NETWORK_SOCKET = 0;
+      router_.bind(NETWORK_SOCKET, JOB, fRcvJob);
+      router_.bind(NETWORK_SOCKET, BATCHJOB, fRcvBatch);
+      router_.bind(NETWORK_SOCKET, HEARTBEAT, ignore);
+      router_.bind(NETWORK_SOCKET, CANCEL, ignore);
+      router_.bindFd(endpoint_.fd(), [&]() { sendResults(); });
+      router_.bindOnPoll([&]() { onPoll(); });
+    }
+
+    Relay::~Relay()
+    {
+    }
+
+    void Relay::start()
+    {
+      lastSent_ = std::chrono::high_resolution_clock::now();
+      auto delegator = std::async(std::launch::async, [&]() { delegator_.start(); });
+      router_.poll(msPollRate_, running_);
+      delegator.wait();
+    }
+
+    void Relay::receiveJob(const Message& m)
+    {
+      uint id = nextRequestId_++;
+      Pending& p = pending_[id];
+      if (m.packed)
+      {
+        p.jobTypes = { m.header.jobType };
+        p.jobIds = { m.header.jobId };
+      }
+      else
+      {
+        p.jobTypes = { (uint)std::stoul(m.data[0].str()) };
+        p.jobIds = { std::stoull(m.data[1].str()) };
+      }
+      p.startTime = std::chrono::high_resolution_clock::now();
+      endpoint_.submit(id, p.jobTypes, (m.packed ? m.data[0] : m.data[2]).str());
+    }
+
+    void Relay::receiveBatch(const Message& m)
+    {
+      std::vector<std::string> jobTypes, jobIds;
+      splitStr(jobTypes, m.data[0].str(), ':');
+      splitStr(jobIds, m.data[1].str(), ':');
+      assert(jobTypes.size() == jobIds.size());
+
+      uint id = nextRequestId_++;
+      Pending& p = pending_[id];
+      for (uint i = 0; i < jobIds.size(); i++)
+      {
+        p.jobTypes.push_back(std::stoul(jobTypes[i]));
+        p.jobIds.push_back(std::stoull(jobIds[i]));
+      }
+      p.batchIds = m.data[1];
+      p.startTime = std::chrono::high_resolution_clock::now();
+      endpoint_.submit(id, p.jobTypes, m.data[2].str());
+    }
+
+    void Relay::sendResults()
+    {
+      Bridge::Result result;
+      while (endpoint_.poll(result))
+      {
+        auto it = pending_.find(result.id);
+        if (it == pending_.end())
+          continue;
+
+        // The whole time the jobs were at the relay counts as service time
+        Pending& p = it->second;
+        auto now = std::chrono::high_resolution_clock::now();
+        double usService = std::chrono::duration_cast<std::chrono::microseconds>(
+            now - p.startTime).count();
+
+        if (p.batchIds.empty())
+        {
+          network_.send({RESULT, Header{p.jobIds[0], 0, 0, 0},
+              {serialise(result.results[0]), serialise(usService)}});
+        }
+        else
+        {
+          // The results come back in order of job type, and go on in the
+          // order of the batch
+          std::vector<uint> sorted = p.jobTypes;
+          std::sort(sorted.begin(), sorted.end());
+          std::vector<Frame> data = { p.batchIds };
+          for (uint t : p.jobTypes)
+          {
+            uint i = std::lower_bound(sorted.begin(), sorted.end(), t) - sorted.begin();
+            data.push_back(serialise(result.results[i]));
+          }
+          std::vector<std::string> usServices(p.jobTypes.size(),
+              std::to_string((uint64_t)usService));
+          data.push_back(joinStr(usServices, ":"));
+          network_.send({BATCHRESULT, Header{0, 0, 0, 0}, data});
+        }
+        lastSent_ = now;
+        pending_.erase(it);
+      }
+    }
+
+    void Relay::onPoll()
+    {
+      // The delegator is only told about the relay once it has workers, and
+      // the relay leaves when they all have, so that the delegator sends
+      // their jobs elsewhere
+      auto now = std::chrono::high_resolution_clock::now();
+      uint concurrency = delegator_.stats().concurrency;
+      if (concurrency != concurrency_)
+      {
+        if (concurrency == 0)
+        {
+          LOG(INFO) << "Relay has no workers left, leaving the delegator";
+          network_.send({GOODBYE});
+        }
+        else
+        {
+          VLOG(1) << "Relay's workers now have " << concurrency << " minions";
+          network_.send({HELLO, Header{0, 0, 0, 0}, {jobTypes_,
+              wireFormatString(WireFormat::Binary), std::to_string(concurrency), "1", "0"}});
+        }
+        concurrency_ = concurrency;
+        lastSent_ = now;
+      }
+      else if (concurrency_ > 0 &&
+          now - lastSent_ >= std::chrono::milliseconds(hbSettings_.msRate))
+      {
+        network_.send({HEARTBEAT});
+        lastSent_ = now;
+      }
+    }
+
+  } // namespace comms
+} // namespace stateline
@@ -0,0 +1,116 @@
+//!
+//! A relay stands between a delegator and workers of its own, so that a
+//! large number of workers can be spread over several machines that each
+//! keep a share of the connections. Toward the delegator the relay is a
+//! single worker, with as many minions as its own workers have between
+//! them. Toward its workers it is a delegator.
+//!
+//! A job, or batch of jobs, from the delegator is handed to the relay's own
+//! delegator as one request, which schedules and batches it among the
+//! relay's workers, and its results go back together. The heartbeats of
+//! the relay's workers stop at the relay, which only heartbeats the
+//! delegator for itself.
+//!
+//! \file comms/relay.hpp
+//! \author agent
+//! \date 2026
+//! \license Lesser General Public License version 3 or later
+//! \copyright (c) 2014, NICTA
+//!
+
+#pragma once
+
+#include "bridge.hpp"
+#include "delegator.hpp"
+#include "messages.hpp"
+#include "router.hpp"
+#include "settings.hpp"
+#include "socket.hpp"
+
+#include <chrono>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <zmq.hpp>
+
+namespace stateline
+{
+  namespace comms
+  {
+    //! Passes jobs from a delegator on to workers that connect to the relay,
+    //! and their results back.
+    //!
+    class Relay
+    {
+      public:
+        //! Create a new relay.
+        //!
+        //! \param settings The configuration object.
+        //!
+        Relay(zmq::context_t& context, const RelaySettings& settings, bool& running);
+
+        // Relays can't be copied.
+        Relay(const Relay& other) = delete;
+
+        ~Relay();
+
+        void start();
+
+      private:
+        //! Jobs from the delegator that are being done by the relay's
+        //! workers, as one request.
+        struct Pending
+        {
+          std::vector<uint> jobTypes; // in the order they came in
+          std::vector<uint64_t> jobIds;
+          Frame batchIds; // as they came in a BATCHJOB, or empty for a JOB
+          std::chrono::high_resolution_clock::time_point startTime;
+        };
+
+        //! Hand a job from the delegator to the relay's workers.
+        //!
+        //! \param m The JOB message.
+        //!
+        void receiveJob(const Message& m);
+
+        //! Hand a batch of jobs from the delegator to the relay's workers.
+        //!
+        //! \param m The BATCHJOB message.
+        //!
+        void receiveBatch(const Message& m);
+
+        //! Send the results the relay's workers have finished back to the
+        //! delegator.
+        //!
+        void sendResults();
+
+        //! Tell the delegator how many minions the relay's workers have, if
+        //! it has changed, and heartbeat it if it hasn't been sent anything
+        //! for a while.
+        //!
+        void onPoll();
+
+        Socket network_;
+        SocketRouter router_;
+        Bridge bridge_;
+        Bridge::Endpoint& endpoint_;
+        Delegator delegator_;
+
+        uint msPollRate_;
+        HeartbeatSettings hbSettings_;
+        std::string jobTypes_; // as sent in HELLO
+
+        bool& running_;
+
+        std::unordered_map<uint, Pending> pending_; // by request id
+        uint nextRequestId_;
+
+        // The number of minions the delegator has been told about, zero if
+        // the relay has no workers and is not connected
+        uint concurrency_;
+        std::chrono::high_resolution_clock::time_point lastSent_;
+    };
+
+  } // namespace comms
+} // namespace stateline
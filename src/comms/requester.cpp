@@ -9,7 +9,9 @@
 #include "comms/requester.hpp"
 #include "comms/delegator.hpp"
 #include "common/string.hpp"
+#include "app/serial.hpp"
 
+#include <cmath>
 #include <iterator>
 #include <string>
 
@@ -17,38 +19,60 @@ namespace stateline
 {
   namespace comms
   {
-    Requester::Requester(zmq::context_t& context)
-        : socket_(context, ZMQ_DEALER ,"toDelegator")
+    Requester::Requester(zmq::context_t& context, const std::string& address)
+        : socket_(new Socket(context, ZMQ_DEALER ,"toDelegator")),
+          local_(nullptr)
     {
-      socket_.setIdentifier();
-      socket_.connect(DELEGATOR_SOCKET_ADDR.c_str());
+      socket_->setIdentifier();
+      socket_->connect(address);
     }
 
-    void Requester::submit(uint id, const std::vector<uint>& jobTypes, const Eigen::VectorXd& data)
+    Requester::Requester(Bridge& bridge, uint tenant)
+        : local_(&bridge.connect(tenant))
     {
+    }
+
+    void Requester::submit(uint id, const std::vector<uint>& jobTypes, const Eigen::VectorXd& data,
+        double rejectAbove, double minJobEnergy)
+    {
+      if (local_)
+      {
+        local_->submit(id, jobTypes, serialise(data), rejectAbove, minJobEnergy);
+        return;
+      }
+
       std::vector<std::string> jobTypesStr;
       std::transform(jobTypes.begin(), jobTypes.end(),
                      std::back_inserter(jobTypesStr),
                      [](uint x) { return std::to_string(x); });
       std::string jtstring = joinStr(jobTypesStr, ":");
 
-      std::vector<std::string> dataVectorStr;
-      for (uint i = 0; i < data.size(); i++) {
-        dataVectorStr.push_back(std::to_string(data(i)));
+      // The delegator always receives the binary wire format and converts it
+      // for any minions that only understand text.
+      std::vector<std::string> frames = { jtstring, serialise(data) };
+      if (!std::isinf(rejectAbove))
+      {
+        frames.push_back(serialise(rejectAbove));
+        frames.push_back(serialise(minJobEnergy));
       }
-
-      socket_.send({{ std::to_string(id)}, REQUEST, { jtstring, joinStr(dataVectorStr, ":") }});
+      socket_->send({{ std::to_string(id)}, REQUEST, frames });
     }
 
     std::pair<uint, std::vector<double>> Requester::retrieve()
     {
-      Message r = socket_.receive();
+      if (local_)
+      {
+        Bridge::Result r = local_->retrieve();
+        return std::make_pair(r.id, std::move(r.results));
+      }
+
+      Message r = socket_->receive();
       uint id = std::stoul(r.address[0]);
 
       std::vector<double> results;
       for (const auto& x : r.data)
       {
-        results.push_back(std::stod(x));
+        results.push_back(unserialise<double>(x.data(), x.size()));
       }
 
       return std::make_pair(id, results);
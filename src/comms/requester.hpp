@@ -1,7 +1,8 @@
 //!
 //! Object which actually requests work and returns a result. Many of these can
 //! live in the same executable, but only 1 per thread. They forward requests to
-//! a shared (threadsafe) delegator object using zeromq inproc messaging
+//! a shared (threadsafe) delegator object, through a bridge if it is in the
+//! same process or over zeromq ipc messaging otherwise
 //!
 //! \file comms/requester.hpp
 //! \author Lachlan McCalman
@@ -12,9 +13,12 @@
 
 #pragma once
 
+#include <limits>
+#include <memory>
 #include <string>
 #include <Eigen/Eigen>
 
+#include "bridge.hpp"
 #include "datatypes.hpp"
 #include "messages.hpp"
 #include "socket.hpp"
@@ -30,21 +34,40 @@ namespace stateline
     {
     public:
 
-      //! Create a new Requester.
+      //! Create a new Requester for a delegator in another process.
       //!
-      //! \param d A reference to the delegator object to communicate with
+      //! \param address The delegator's requester socket address (see
+      //!        delegatorSocketAddress).
       //!
-      Requester(zmq::context_t& context);
+      Requester(zmq::context_t& context, const std::string& address);
+
+      //! Create a new Requester for a delegator in this process.
+      //!
+      //! \param bridge The bridge the delegator takes requests from.
+      //! \param tenant The tenant the requests belong to, whose job types
+      //!        they are numbered among. Requesters in another process
+      //!        belong to the first tenant.
+      //!
+      Requester(Bridge& bridge, uint tenant = 0);
 
       //! Submits a batch of jobs for computation and immediately returns. An id is
       //! included to allow the batch to be identified later, because when batches
       //! are retrieved they may not arrive in the order they were submitted.
       //!
+      //! A batch can be cut short once its results are known to sum to more
+      //! than a given energy. The results of the jobs that were cut are then
+      //! retrieved as infinity, and the jobs are cancelled.
+      //!
       //! \param id The id of the batch
-      //! \param jobs The vector of jobs to compute
-      //! \return The results of the job computations
+      //! \param jobTypes The job types to compute for this sample
+      //! \param data The sample, sent in the binary wire format
+      //! \param rejectAbove Cut the batch short when the sum of its results
+      //!        is certain to be above this.
+      //! \param minJobEnergy The least result any job can have.
       //!
-      void submit(uint id, const std::vector<uint>& jobTypes, const Eigen::VectorXd& data);
+      void submit(uint id, const std::vector<uint>& jobTypes, const Eigen::VectorXd& data,
+          double rejectAbove = std::numeric_limits<double>::infinity(),
+          double minJobEnergy = 0.0);
 
       //! Retrieves a batch of jobs that have previously been submitted for computation.
       //! A pair is returned, with the id of the batch (from the submit call),
@@ -56,8 +79,10 @@ namespace stateline
       std::pair<uint, std::vector<double>> retrieve();
 
     private:
-      // Communicates with another inproc socket in the delegator
-      Socket socket_;
+      // Communicates with the delegator's requester socket, or through the
+      // bridge if that is null
+      std::unique_ptr<Socket> socket_;
+      Bridge::Endpoint* local_;
     };
   } // namespace comms
 } // namespace stateline
@@ -14,6 +14,13 @@
 
 typedef std::chrono::high_resolution_clock hrc;
 
+namespace
+{
+  // Most messages handled between calls to the on-poll function, so that
+  // a flood of messages can't hold it up for long
+  const uint MAX_MESSAGES_PER_POLL = 1024;
+}
+
 namespace stateline
 {
   namespace comms
@@ -50,6 +57,12 @@ namespace stateline
       onPoll_ = f;
     }
 
+    void SocketRouter::bindFd(int fd, const std::function<void(void)>& f)
+    {
+      pollList_.push_back({nullptr, fd, ZMQ_POLLIN, 0});
+      fdCallbacks_.push_back(f);
+    }
+
     // this is an int because -1 indicates no timeout
     void SocketRouter::poll(int msWait, bool& running)
     {
@@ -59,16 +72,31 @@ namespace stateline
         // block until a message arrives
         zmq::poll(&(pollList_[0]), pollList_.size(), msWait);
 
-        // figure out which socket it's from
-        for (uint i = 0; i < pollList_.size(); i++)
+        for (uint i = sockets_.size(); i < pollList_.size(); i++)
         {
-          bool newMsg = pollList_[i].revents & ZMQ_POLLIN;
-          if (newMsg)
+          if (pollList_[i].revents & ZMQ_POLLIN)
+            fdCallbacks_[i - sockets_.size()]();
+        }
+
+        // Take every waiting message before calling the on-poll function,
+        // one from each socket in turn so a busy socket doesn't hold up the
+        // others
+        uint nReceived = 0;
+        bool received = true;
+        while (received && nReceived < MAX_MESSAGES_PER_POLL)
+        {
+          received = false;
+          for (uint i = 0; i < sockets_.size(); i++)
           {
+            if (!sockets_[i]->hasMessage())
+              continue;
+
             Message msg = sockets_[i]->receive();
 
             VLOG(4) << "Router " << name_ << " received new message from socket " << sockets_[i]->name() << ": " << msg;
             callbacks_[index(i, msg.subject)](msg);
+            received = true;
+            nReceived++;
           }
         }
         onPoll_();
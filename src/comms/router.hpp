@@ -29,7 +29,9 @@ namespace stateline
 
     //! Implements polling and configurable routing between an
     //! arbitrary number of (pre-constructed) sockets. Functionality
-    //! is attached through a signal interface.
+    //! is attached through a signal interface. Each time the poll wakes up,
+    //! all the messages waiting on the sockets are handled before the
+    //! on-poll function is called.
     //!
     class SocketRouter
     {
@@ -44,8 +46,16 @@ namespace stateline
 
         void bind(uint socketIndex, const Subject& s, const Callback& f);
 
+        //! Call a function after each batch of messages has been handled,
+        //! and whenever the poll times out.
+        //!
         void bindOnPoll(const std::function<void(void)>& f);
 
+        //! Call a function whenever a file descriptor is readable. The
+        //! function must read whatever made it readable.
+        //!
+        void bindFd(int fd, const std::function<void(void)>& f);
+
         //! Start the router polling with a polling loop frequency
         void poll(int msPerPoll, bool& running);
 
@@ -54,6 +64,7 @@ namespace stateline
         std::vector<Socket*> sockets_; // TODO: do we need to store the sockets?
         std::vector<zmq::pollitem_t> pollList_;
         std::vector<Callback> callbacks_;
+        std::vector<std::function<void(void)>> fdCallbacks_; // after the sockets in pollList_
         std::function<void(void)> onPoll_;
     };
 
@@ -11,6 +11,8 @@
 #pragma once
 
 #include <string>
+#include <utility>
+#include <vector>
 
 #include "../typedefs.hpp"
 
@@ -18,14 +20,15 @@ namespace stateline
 {
   namespace comms
   {
-    //! Settings for controlling heartbeat threads.
+    //! Settings for controlling heartbeats.
     //!
     struct HeartbeatSettings
     {
       //! The number of milliseconds between each heartbeat.
       uint msRate;
 
-      //! The rate at which the heartbeat sockets are polled.
+      //! The rate at which the heartbeat sockets are polled. The delegator
+      //! checks its workers' heartbeats this often.
       int msPollRate;
 
       //! The heartbeat timeout in milliseconds.
@@ -50,6 +53,27 @@ namespace stateline
       }
     };
 
+    //! Settings for one of several samplers, or other requesters, that
+    //! share a delegator and its workers.
+    //!
+    struct TenantSettings
+    {
+      //! Name of the tenant, for the logs.
+      std::string name;
+
+      //! The tenant's share of the workers' time, relative to the weights
+      //! of the other tenants with jobs waiting.
+      double weight;
+
+      //! The most jobs of the tenant that may be in progress at once, or
+      //! zero for no limit.
+      uint maxJobsInProgress;
+
+      //! Number of job types. The tenant numbers its job types from zero.
+      //! Workers see them numbered after those of the tenants before it.
+      uint nJobTypes;
+    };
+
     //! Settings to control the behaviour of delegators.
     //!
     struct DelegatorSettings
@@ -66,6 +90,41 @@ namespace stateline
       //! number of job types.
       uint nJobTypes;
 
+      //! The first job type of workers that don't say which job types they
+      //! take. They are given those from here up to nJobTypes.
+      uint firstJobType;
+
+      //! The number of standard deviations of a worker's job times that are
+      //! added to its expected completion time when choosing a worker for a
+      //! job. Higher values favour workers with consistent times; zero
+      //! schedules on expected times alone.
+      double riskAversion;
+
+      //! A job is overdue once it has taken this many times longer than its
+      //! worker was expected to take, and a copy of it is sent to another
+      //! worker with an idle minion. The first result is used. Zero turns
+      //! this off.
+      double hedgeAfter;
+
+      //! A worker that hasn't done a job type recently has to load that job
+      //! type's data before it can start on it. It is only sent the job if
+      //! it is expected to finish more than this fraction sooner than the
+      //! best worker that has done the job type recently. Zero ignores
+      //! which job types workers have done.
+      double affinityTolerance;
+
+      //! Number of delegators, or shards, to run. Each has its own thread,
+      //! its own workers and its own port, counting up from port, and they
+      //! take requests from the same queue. Workers that connect to the
+      //! first are spread over them.
+      uint nShards;
+
+      //! The requesters sharing the delegator, each with its own job types
+      //! and share of the workers. Jobs are dispatched to give each tenant
+      //! with jobs waiting its share of the time the workers spend on them.
+      //! Empty for a single tenant with all nJobTypes job types.
+      std::vector<TenantSettings> tenants;
+
       //! Default delegator settings
       static DelegatorSettings Default(uint port)
       {
@@ -74,6 +133,11 @@ namespace stateline
         settings.port = port;
         settings.heartbeat = HeartbeatSettings::DelegatorDefault();
         settings.nJobTypes = 1;
+        settings.firstJobType = 0;
+        settings.riskAversion = 1.0;
+        settings.hedgeAfter = 4.0;
+        settings.affinityTolerance = 0.5;
+        settings.nShards = 1;
         return settings;
       }
     };
@@ -106,6 +170,41 @@ namespace stateline
         return settings;
       }
     };
+
+    //! Settings to control the behaviour of relays.
+    //!
+    struct RelaySettings
+    {
+      //! The rate at which the socket to the delegator is polled. Heartbeats
+      //! are sent and the relay's capacity checked this often.
+      int msPollRate;
+
+      //! The address of the delegator to connect to.
+      std::string networkAddress;
+
+      //! The job types to take from the delegator, as first and one past the
+      //! last. The relay's own workers that don't say which job types they
+      //! take are sent all of these.
+      std::pair<uint, uint> jobTypesRange;
+
+      //! Settings for the heartbeats sent to the delegator.
+      HeartbeatSettings heartbeat;
+
+      //! Settings for the delegator the relay's own workers connect to.
+      DelegatorSettings delegator;
+
+      //! Default relay settings
+      static RelaySettings Default(const std::string& networkAddress, uint port)
+      {
+        RelaySettings settings;
+        settings.msPollRate = 100;
+        settings.networkAddress = networkAddress;
+        settings.jobTypesRange = std::make_pair(0, 1);
+        settings.heartbeat = HeartbeatSettings::WorkerDefault();
+        settings.delegator = DelegatorSettings::Default(port);
+        return settings;
+      }
+    };
   }
 }
 
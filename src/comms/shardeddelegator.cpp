@@ -0,0 +1,84 @@
+//!
+//! Contains the implementation of the sharded delegator.
+//!
+//! \file comms/shardeddelegator.cpp
+//! \author agent
+//! \date 2026
+//! \license Lesser General Public License version 3 or later
+//! \copyright (c) 2014, NICTA
+//!
+
+#include "comms/shardeddelegator.hpp"
+
+#include <algorithm>
+#include <future>
+#include <limits>
+
+namespace stateline
+{
+  namespace comms
+  {
+    ShardedDelegator::ShardedDelegator(zmq::context_t& context, const DelegatorSettings& settings,
+        bool& running, Bridge& bridge)
+    {
+      uint nShards = std::max(settings.nShards, 1U);
+      for (uint i = 0; i < nShards; i++)
+        shards_.emplace_back(new Delegator(context, settings, running, &bridge, i));
+    }
+
+    void ShardedDelegator::start()
+    {
+      std::vector<std::future<void>> threads;
+      for (uint i = 1; i < shards_.size(); i++)
+        threads.push_back(std::async(std::launch::async, [this, i]() { shards_[i]->start(); }));
+      shards_[0]->start();
+      for (auto& thread : threads)
+        thread.wait();
+    }
+
+    uint ShardedDelegator::workerCount() const
+    {
+      uint count = 0;
+      for (const auto& shard : shards_)
+        count += shard->workerCount();
+      return count;
+    }
+
+    DelegatorStats ShardedDelegator::stats() const
+    {
+      if (shards_.size() == 1)
+        return shards_[0]->stats();
+
+      DelegatorStats total = {0, 0, 0, 0.0, 0.0, 0, 0, 0, 0, 0, 0, 0, 0};
+      uint minPipelineDepth = std::numeric_limits<uint>::max();
+      for (const auto& shard : shards_)
+      {
+        DelegatorStats s = shard->stats();
+        total.queueDepth += s.queueDepth;
+        total.jobsInProgress += s.jobsInProgress;
+        total.jobsDispatched += s.jobsDispatched;
+        // Weighted by the jobs each shard has dispatched
+        total.usDispatchLatency += s.usDispatchLatency * s.jobsDispatched;
+        total.usMaxDispatchLatency = std::max(total.usMaxDispatchLatency, s.usMaxDispatchLatency);
+        total.concurrency += s.concurrency;
+        total.pipelineDepth += s.pipelineDepth;
+        // Shards without workers have no pipeline depths
+        if (s.pipelineDepth > 0)
+        {
+          minPipelineDepth = std::min(minPipelineDepth, s.minPipelineDepth);
+          total.maxPipelineDepth = std::max(total.maxPipelineDepth, s.maxPipelineDepth);
+        }
+        total.jobsCancelled += s.jobsCancelled;
+        total.jobsHedged += s.jobsHedged;
+        total.hedgesWon += s.hedgesWon;
+        total.coldStarts += s.coldStarts;
+      }
+      if (total.jobsDispatched > 0)
+        total.usDispatchLatency /= total.jobsDispatched;
+      if (total.pipelineDepth > 0)
+        total.minPipelineDepth = minPipelineDepth;
+      return total;
+    }
+
+  } // namespace comms
+} // namespace stateline
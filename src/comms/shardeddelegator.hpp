@@ -0,0 +1,68 @@
+//!
+//! A set of delegators, each with a thread and a port of its own, that
+//! share the requests of one bridge. One delegator can only keep so many
+//! workers busy before its thread is the bottleneck, so a large cluster is
+//! split between shards. Workers that connect to the first port are
+//! redirected to a shard chosen from their address, and each shard takes
+//! requests from the bridge while its workers have room for them.
+//!
+//! \file comms/shardeddelegator.hpp
+//! \author agent
+//! \date 2026
+//! \license Lesser General Public License version 3 or later
+//! \copyright (c) 2014, NICTA
+//!
+
+#pragma once
+
+#include "bridge.hpp"
+#include "delegator.hpp"
+#include "settings.hpp"
+
+#include <memory>
+#include <vector>
+
+#include <zmq.hpp>
+
+namespace stateline
+{
+  namespace comms
+  {
+    //! Delegators that split the workers between them and share the
+    //! requests of a bridge.
+    //!
+    class ShardedDelegator
+    {
+      public:
+        //! Create the settings' number of shards.
+        //!
+        //! \param settings The settings of every shard. The shards listen
+        //!        on consecutive ports starting from the settings' port.
+        //! \param bridge The bridge the shards take requests from.
+        //!
+        ShardedDelegator(zmq::context_t& context, const DelegatorSettings& settings, bool& running,
+            Bridge& bridge);
+
+        // Sharded delegators can't be copied.
+        ShardedDelegator(const ShardedDelegator &other) = delete;
+
+        //! Run every shard until running is false, the first in this thread
+        //! and the others in threads of their own.
+        //!
+        void start();
+
+        uint nShards() const { return shards_.size(); }
+
+        uint workerCount() const;
+
+        //! Get the job queue statistics of all the shards together. Safe to
+        //! call from any thread.
+        //!
+        DelegatorStats stats() const;
+
+      private:
+        std::vector<std::unique_ptr<Delegator>> shards_;
+    };
+
+  } // namespace comms
+} // namespace stateline
@@ -36,13 +36,21 @@ namespace stateline
       return result;
     }
 
-    bool sendString(zmq::socket_t & socket, const std::string & string)
+    Frame receiveFrame(zmq::socket_t & socket, bool& isMore)
     {
-      // Taken from zhelpers.hpp
-      zmq::message_t message(string.size());
-      memcpy(message.data(), string.data(), string.size());
-
-      return socket.send(message);
+      zmq::message_t message;
+      try
+      {
+        socket.recv(&message);
+      }
+      catch(const zmq::error_t& e)
+      {
+        VLOG(1) << "ZMQ receive has thrown with type " << e.what();
+        throw;
+      }
+      isMore = message.more();
+      // Keep hold of the received bytes rather than copying them
+      return Frame(std::move(message));
     }
 
     bool sendStringPart(zmq::socket_t & socket, const std::string & string)
@@ -54,6 +62,12 @@ namespace stateline
       return socket.send(message, ZMQ_SNDMORE);
     }
 
+    bool sendFrame(zmq::socket_t & socket, const Frame & frame, int flags)
+    {
+      zmq::message_t message = frame.message();
+      return socket.send(message, flags);
+    }
+
     Socket::Socket(zmq::context_t& context, int type, const std::string& name, int linger)
       : socket_(context, type),
         name_(name),
@@ -67,6 +81,11 @@ namespace stateline
       socket_.connect(address.c_str());
     }
 
+    void Socket::disconnect(const std::string& address)
+    {
+      socket_.disconnect(address.c_str());
+    }
+
     void Socket::bind(const std::string& address)
     {
       try
@@ -96,26 +115,26 @@ namespace stateline
         sendStringPart(socket_, "");
 
         // Send subject, then data if there is any
-        auto subjectString = std::to_string(m.subject);
+        Frame subjectFrame = m.packed ? packHeader(m) : Frame(std::to_string(m.subject));
         uint dataSize = m.data.size();
         if (dataSize > 0)
         {
           // The subject
-          sendStringPart(socket_, subjectString);
+          sendFrame(socket_, subjectFrame, ZMQ_SNDMORE);
 
           // The data -- multipart
           for (auto it = m.data.begin(); it != std::prev(m.data.end()); ++it)
           {
-            sendStringPart(socket_, *it);
+            sendFrame(socket_, *it, ZMQ_SNDMORE);
           }
 
           // final or only part
-          sendString(socket_, m.data.back());
+          sendFrame(socket_, m.data.back(), 0);
         }
         else
         {
           // The subject
-          sendString(socket_, subjectString);
+          sendFrame(socket_, subjectFrame, 0);
         }
       }
       catch(...)
@@ -144,26 +163,31 @@ namespace stateline
       // address is a stack, so reverse it to get the right way around
       std::reverse(address.begin(), address.end());
 
-      // We've just read the delimiter, so now get subject
-      auto subjectString = receiveString(socket_);
-      //the underlying representation is (explicitly) an int so fairly safe
-      Subject subject = (Subject)std::stoi(subjectString);
-      std::vector<std::string> data;
-      while (true)
+      // We've just read the delimiter, so now get the subject: a packed
+      // header, or the subject alone as a decimal string
+      bool more;
+      Frame subjectFrame = receiveFrame(socket_, more);
+      Message message{std::move(address), HELLO};
+      if (!unpackHeader(subjectFrame, message))
       {
-        int isMore = 0;
-        size_t moreSize = sizeof(isMore);
-        socket_.getsockopt(ZMQ_RCVMORE, &isMore, &moreSize);
-        if (!isMore)
-          break;
-        data.push_back(receiveString(socket_));
+        //the underlying representation is (explicitly) an int so fairly safe
+        message.subject = (Subject)std::stoi(subjectFrame.str());
       }
+      while (more)
+        message.data.push_back(receiveFrame(socket_, more));
 
-      Message message{std::move(address), subject, std::move(data)};
       VLOG(5) << "Socket " << name_ << " received " << message;
       return message;
     }
 
+    bool Socket::hasMessage()
+    {
+      int events = 0;
+      size_t eventsSize = sizeof(events);
+      socket_.getsockopt(ZMQ_EVENTS, &events, &eventsSize);
+      return events & ZMQ_POLLIN;
+    }
+
     // Options
     void Socket::setFallback(const std::function<void(const Message& m)>& sendCallback)
     {
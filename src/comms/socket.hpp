@@ -19,9 +19,13 @@ namespace stateline
         Socket& operator=(const Socket&) = delete;
 
         void connect(const std::string& address);
+        void disconnect(const std::string& address);
         void bind(const std::string& address);
         void send(const Message& m);
         Message receive();
+
+        // Check, without blocking, whether a message is waiting to be received
+        bool hasMessage();
         void setFallback(const std::function<void(const Message& m)>& sendCallback);
         void setLinger(int l);
         void setHWM(int n);
@@ -10,7 +10,12 @@
 
 #include "comms/worker.hpp"
 #include "comms/thread.hpp"
+#include "comms/payload.hpp"
+#include "common/string.hpp"
+#include "app/serial.hpp"
 
+#include <algorithm>
+#include <cassert>
 #include <cstdlib>
 #include <easylogging/easylogging++.h>
 
@@ -21,48 +26,156 @@ namespace stateline
 
     Worker::Worker(zmq::context_t& context, const WorkerSettings& settings, bool& running)
       : context_(context),
-        minion_(context, ZMQ_DEALER, "toMinion"),
+        minion_(context, ZMQ_ROUTER, "toMinion"),
         heartbeat_(context, ZMQ_PAIR, "toHBRouter"),
         network_(context, ZMQ_DEALER, "toNetwork"),
         router_("main", {&minion_, &heartbeat_, &network_}),
         msPollRate_(settings.msPollRate),
         hbSettings_(settings.heartbeat),
         running_(running),
-        minionWaiting_(true)
+        networkAddress_(settings.networkAddress),
+        nMinions_(0)
     {
       // Initialise the local sockets
       minion_.bind(settings.workerAddress);
       heartbeat_.bind(CLIENT_HB_SOCKET_ADDR);
       network_.setIdentifier();
-      LOG(INFO) << "Worker connecting to " << settings.networkAddress;
-      network_.connect("tcp://" + settings.networkAddress);
+      LOG(INFO) << "Worker connecting to " << networkAddress_;
+      network_.connect("tcp://" + networkAddress_);
 
       // Specify the Worker functionality
       //
-      auto onJobFromNetwork = [&] (const Message& m) { 
-        if (minionWaiting_) 
-        {
-          minion_.send(m);
-          minionWaiting_ = false;
-        }
+      auto onHelloFromMinion = [&] (const Message& m)
+      {
+        // Minions that predate the binary wire format only send the job types
+        std::vector<Frame> hello = m.data;
+        if (hello.size() < 2)
+          hello.push_back(wireFormatString(WireFormat::Text));
+        hello.resize(2);
+
+        if (nMinions_ == 0)
+          hello_ = hello;
+        else if (hello[0].str() != hello_[0].str() || hello[1].str() != hello_[1].str())
+          LOG(WARNING) << "Minion supports job types " << hello[0].str() << " with wire format "
+            << hello[1].str() << ", but it will be sent jobs for the first minion's "
+            << hello_[0].str() << " with wire format " << hello_[1].str();
+
+        nMinions_++;
+        idleMinions_.push_back(m.address);
+        if (m.packed)
+          packedMinions_.insert(m.address.front());
+        VLOG(1) << "Minion connected, " << nMinions_ << " minions in total";
+
+        // Each HELLO updates the number of minions the delegator knows about
+        sendHello();
+        sendQueuedJobs();
+      };
+
+      auto onRedirectFromNetwork = [&] (const Message& m)
+      {
+        // The server runs several delegators, and this worker belongs to the
+        // one on another port of the same host. The delegator it was
+        // connected to hasn't given it anything, so it just starts again.
+        std::string address = networkAddress_.substr(0, networkAddress_.rfind(':') + 1) +
+          m.data[0].str();
+        if (address == networkAddress_)
+          return;
+
+        LOG(INFO) << "Worker redirected to " << address;
+        network_.disconnect("tcp://" + networkAddress_);
+        networkAddress_ = address;
+        network_.connect("tcp://" + networkAddress_);
+        sendHello();
+      };
+
+      auto onJobFromNetwork = [&] (const Message& m)
+      {
+        if (m.packed)
+          queue_.push_back(m);
         else
+          queue_.push_back({JOB, Header{std::stoull(m.data[1].str()), (uint32_t)std::stoul(m.data[0].str()), 0, 0},
+              {m.data[2]}});
+        sendQueuedJobs();
+      };
+
+      auto onBatchFromNetwork = [&] (const Message& m)
+      {
+        // Each job in the batch shares the sample frame
+        std::vector<std::string> jobTypes, jobIds;
+        splitStr(jobTypes, m.data[0].str(), ':');
+        splitStr(jobIds, m.data[1].str(), ':');
+        assert(jobTypes.size() == jobIds.size());
+
+        auto batch = std::make_shared<Batch>();
+        batch->jobIds = m.data[1];
+        batch->results.resize(jobIds.size());
+        batch->usServices.resize(jobIds.size());
+        batch->nDone = 0;
+        for (uint i = 0; i < jobIds.size(); i++)
         {
-          queue_.push(m);
+          uint64_t id = std::stoull(jobIds[i]);
+          batchJobs_[id] = std::make_pair(batch, i);
+          queue_.push_back({JOB, Header{id, (uint32_t)std::stoul(jobTypes[i]), m.header.chainId, 0},
+              {m.data[2]}});
         }
+        sendQueuedJobs();
       };
 
       auto onResultFromMinion = [&] (const Message & m)
       {
-        network_.send(m);
-        if (queue_.size() > 0)
+        uint64_t jobId = m.packed ? m.header.jobId : std::stoull(m.data[0].str());
+        const Frame& result = m.packed ? m.data[0] : m.data[1];
+        double usService = 0;
+        auto start = startTimes_.find(jobId);
+        if (start != startTimes_.end())
         {
-          minion_.send(queue_.front());
-          queue_.pop();
+          usService = std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::high_resolution_clock::now() - start->second).count();
+          startTimes_.erase(start);
+        }
+
+        auto batchJob = batchJobs_.find(jobId);
+        if (cancelled_.erase(jobId))
+        {
+          VLOG(2) << "Dropping the result of cancelled job " << jobId;
+        }
+        else if (batchJob == batchJobs_.end())
+        {
+          network_.send({RESULT, Header{jobId, 0, 0, 0}, {result, serialise(usService)}});
         }
         else
         {
-          minionWaiting_ = true;
+          Batch& batch = *batchJob->second.first;
+          batch.results[batchJob->second.second] = result;
+          batch.usServices[batchJob->second.second] = std::to_string((uint64_t)usService);
+          batch.nDone++;
+          if (batch.nDone == batch.results.size())
+          {
+            std::vector<Frame> data = { batch.jobIds };
+            data.insert(data.end(), batch.results.begin(), batch.results.end());
+            data.push_back(joinStr(batch.usServices, ":"));
+            network_.send({BATCHRESULT, Header{0, 0, 0, 0}, data});
+          }
+          batchJobs_.erase(batchJob);
         }
+        idleMinions_.push_back(m.address);
+        sendQueuedJobs();
+      };
+
+      auto onCancelFromNetwork = [&] (const Message& m)
+      {
+        // Jobs that came in a batch still run, as the batch's results are
+        // sent back together. The delegator ignores their results.
+        uint64_t jobId = m.packed ? m.header.jobId : std::stoull(m.data[0].str());
+        if (batchJobs_.count(jobId))
+          return;
+
+        auto queued = std::find_if(queue_.begin(), queue_.end(),
+            [&](const Message& job) { return job.header.jobId == jobId; });
+        if (queued != queue_.end())
+          queue_.erase(queued);
+        else if (startTimes_.count(jobId))
+          cancelled_.insert(jobId);
       };
 
 
@@ -79,10 +192,13 @@ namespace stateline
 
       // Bind functionality to the router
       router_.bind(MINION_SOCKET, RESULT, onResultFromMinion);
-      router_.bind(MINION_SOCKET, HELLO, forwardToNetwork);
+      router_.bind(MINION_SOCKET, HELLO, onHelloFromMinion);
       router_.bind(HB_SOCKET, HEARTBEAT, forwardToNetwork);
       router_.bind(HB_SOCKET, GOODBYE, disconnect);
       router_.bind(NETWORK_SOCKET, JOB, onJobFromNetwork);
+      router_.bind(NETWORK_SOCKET, BATCHJOB, onBatchFromNetwork);
+      router_.bind(NETWORK_SOCKET, CANCEL, onCancelFromNetwork);
+      router_.bind(NETWORK_SOCKET, REDIRECT, onRedirectFromNetwork);
       router_.bind(NETWORK_SOCKET, HEARTBEAT, forwardToHB);
       router_.bind(NETWORK_SOCKET, HELLO, forwardToHB);
       router_.bind(NETWORK_SOCKET, GOODBYE, forwardToHB);
@@ -92,6 +208,31 @@ namespace stateline
     {
     }
 
+    void Worker::sendHello()
+    {
+      // The last frames say that batches of jobs, CANCEL and REDIRECT are
+      // understood
+      network_.send({HELLO, Header{0, 0, 0, 0},
+          {hello_[0], hello_[1], std::to_string(nMinions_), "1", "1", "1"}});
+    }
+
+    void Worker::sendQueuedJobs()
+    {
+      while (!queue_.empty() && !idleMinions_.empty())
+      {
+        const Message& job = queue_.front();
+        const auto& minion = idleMinions_.front();
+        startTimes_[job.header.jobId] = std::chrono::high_resolution_clock::now();
+        if (packedMinions_.count(minion.front()))
+          minion_.send({minion, JOB, job.header, job.data});
+        else
+          minion_.send({minion, JOB, {std::to_string(job.header.jobType),
+              std::to_string(job.header.jobId), job.data[0]}});
+        idleMinions_.pop_front();
+        queue_.pop_front();
+      }
+    }
+
     void Worker::start()
     {
       // Start the heartbeat thread and router
@@ -3,6 +3,14 @@
 //! to a set of minions that actually perform the work. These minions then
 //! return the worker results, which are forwarded back to the delegator.
 //!
+//! Any number of minions can connect to one worker. Jobs are queued in the
+//! worker and handed to whichever minion is idle, and the worker tells the
+//! delegator how many minions it has so that it is sent enough work to keep
+//! them all busy. A batch of jobs for the same sample is split between the
+//! minions and their results are sent back together. Each result carries the
+//! time its minion spent on it, from which the delegator works out how many
+//! jobs to keep queued here.
+//!
 //! \file comms/worker.hpp
 //! \author Lachlan McCalman
 //! \date 2014
@@ -12,8 +20,12 @@
 
 #pragma once
 
+#include <chrono>
+#include <deque>
+#include <map>
+#include <memory>
 #include <string>
-#include <queue>
+#include <set>
 
 #include <zmq.hpp>
 
@@ -51,6 +63,24 @@ namespace stateline
       void start();
 
     private:
+      //! Send queued jobs to idle minions until there are no more of either.
+      //!
+      void sendQueuedJobs();
+
+      //! Tell the delegator the job types and number of minions of this
+      //! worker.
+      //!
+      void sendHello();
+
+      //! The jobs of a BATCHJOB message, whose results are sent back together.
+      struct Batch
+      {
+        Frame jobIds; // as they came in the BATCHJOB
+        std::vector<Frame> results;
+        std::vector<std::string> usServices;
+        uint nDone;
+      };
+
       zmq::context_t& context_; 
 
       Socket minion_;
@@ -63,8 +93,32 @@ namespace stateline
 
       bool& running_;
 
-      std::queue<Message> queue_;
-      bool minionWaiting_;
+      // The delegator's host and port, which change if it redirects the
+      // worker to another of the server's delegators
+      std::string networkAddress_;
+
+      // Jobs waiting for a minion, with their ids and types in packed headers
+      std::deque<Message> queue_;
+
+      // Addresses of the minions waiting for a job
+      std::deque<std::vector<std::string>> idleMinions_;
+
+      // Minions that sent a packed header, so are sent them too
+      std::set<std::string> packedMinions_;
+
+      // The HELLO of the first minion, which all minions must match
+      std::vector<Frame> hello_;
+      uint nMinions_;
+
+      // The batch and index within it of each job that came in a batch
+      std::map<uint64_t, std::pair<std::shared_ptr<Batch>, uint>> batchJobs_;
+
+      // When each job being worked on was given to a minion
+      std::map<uint64_t, std::chrono::high_resolution_clock::time_point> startTimes_;
+
+      // Jobs cancelled while a minion was working on them, whose results
+      // are dropped
+      std::set<uint64_t> cancelled_;
     };
 
     //! Forward a message to the delegator.
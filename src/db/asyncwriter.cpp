@@ -0,0 +1,91 @@
+//!
+//! Contains the implementation of the background chain writer.
+//!
+//! \file db/asyncwriter.cpp
+//! \author agent
+//! \date 2026
+//! \license Lesser General Public License version 3 or later
+//! \copyright (c) 2014, NICTA
+//!
+
+#include "db/asyncwriter.hpp"
+
+namespace stateline
+{
+  namespace db
+  {
+    AsyncChainArrayWriter::AsyncChainArrayWriter(std::unique_ptr<ChainArrayWriter> writer,
+        uint maxQueuedStates)
+      : writer_(std::move(writer)),
+        maxQueuedStates_(maxQueuedStates),
+        nQueuedStates_(0),
+        stopping_(false),
+        thread_(&AsyncChainArrayWriter::run, this)
+    {
+    }
+
+    AsyncChainArrayWriter::~AsyncChainArrayWriter()
+    {
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        stopping_ = true;
+      }
+      queued_.notify_one();
+      thread_.join();
+    }
+
+    void AsyncChainArrayWriter::append(int id, std::vector<mcmc::State>::iterator start,
+        std::vector<mcmc::State>::iterator end)
+    {
+      Batch batch { id, std::vector<mcmc::State>(start, end) };
+      uint n = batch.states.size();
+
+      std::unique_lock<std::mutex> lock(mutex_);
+      // A batch larger than the whole queue is let through once it's empty
+      written_.wait(lock, [&]() {
+          return nQueuedStates_ == 0 || nQueuedStates_ + n <= maxQueuedStates_; });
+      queue_.push_back(std::move(batch));
+      nQueuedStates_ += n;
+      lock.unlock();
+      queued_.notify_one();
+    }
+
+    std::vector<std::uint64_t> AsyncChainArrayWriter::sync()
+    {
+      // Holding the lock keeps the writer thread away from the writer
+      std::unique_lock<std::mutex> lock(mutex_);
+      written_.wait(lock, [&]() { return nQueuedStates_ == 0; });
+      return writer_->sync();
+    }
+
+    void AsyncChainArrayWriter::run()
+    {
+      std::deque<Batch> writing;
+      while (true)
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        queued_.wait(lock, [&]() { return !queue_.empty() || stopping_; });
+        if (queue_.empty())
+          return;
+
+        // Take everything queued so far and write it without holding the lock
+        std::swap(writing, queue_);
+        lock.unlock();
+
+        uint n = 0;
+        for (auto& batch : writing)
+        {
+          writer_->append(batch.id, batch.states.begin(), batch.states.end());
+          n += batch.states.size();
+        }
+        writing.clear();
+
+        lock.lock();
+        nQueuedStates_ -= n;
+        lock.unlock();
+        written_.notify_all();
+      }
+    }
+
+  } // namespace db
+} // namespace stateline
@@ -0,0 +1,71 @@
+//!
+//! Contains a chain writer that writes from a background thread.
+//!
+//! \file db/asyncwriter.hpp
+//! \author agent
+//! \date 2026
+//! \license Lesser General Public License version 3 or later
+//! \copyright (c) 2014, NICTA
+//!
+
+#pragma once
+
+#include "db/db.hpp"
+
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+namespace stateline
+{
+  namespace db
+  {
+    //! Hands batches of states to another writer running in its own thread,
+    //! so that appending doesn't wait for file I/O.
+    //!
+    class AsyncChainArrayWriter : public ChainArrayWriter
+    {
+      public:
+        //! Start the writer thread.
+        //!
+        //! \param writer The writer that does the writing.
+        //! \param maxQueuedStates The number of states that can be waiting to
+        //!        be written. Appending blocks while the queue is full.
+        //!
+        AsyncChainArrayWriter(std::unique_ptr<ChainArrayWriter> writer, uint maxQueuedStates);
+
+        //! Writes everything still queued, then stops the writer thread.
+        //!
+        ~AsyncChainArrayWriter();
+
+        void append(int id, std::vector<mcmc::State>::iterator start,
+          std::vector<mcmc::State>::iterator end) override;
+
+        std::vector<std::uint64_t> sync() override;
+
+      private:
+        struct Batch
+        {
+          int id;
+          std::vector<mcmc::State> states;
+        };
+
+        void run();
+
+        std::unique_ptr<ChainArrayWriter> writer_;
+        uint maxQueuedStates_;
+
+        std::deque<Batch> queue_;
+        uint nQueuedStates_; // including those being written
+        bool stopping_;
+
+        std::mutex mutex_;
+        std::condition_variable queued_;
+        std::condition_variable written_;
+        std::thread thread_;
+    };
+
+  } // namespace db
+} // namespace stateline
@@ -0,0 +1,183 @@
+//!
+//! Contains the implementation of the binary column-oriented chain format.
+//!
+//! \file db/binary.cpp
+//! \author agent
+//! \date 2026
+//! \license Lesser General Public License version 3 or later
+//! \copyright (c) 2014, NICTA
+//!
+
+#include "db/binary.hpp"
+
+#include <cstring>
+#include <stdexcept>
+
+namespace stateline
+{
+  namespace db
+  {
+    namespace
+    {
+      template <class T>
+      void put(std::vector<char>& buffer, std::size_t& pos, T value)
+      {
+        std::memcpy(buffer.data() + pos, &value, sizeof(T));
+        pos += sizeof(T);
+      }
+
+      template <class T>
+      T get(const std::vector<char>& buffer, std::size_t& pos)
+      {
+        T value;
+        std::memcpy(&value, buffer.data() + pos, sizeof(T));
+        pos += sizeof(T);
+        return value;
+      }
+
+      std::size_t chunkSize(uint nStates, uint nDims)
+      {
+        return nStates * ((nDims + 3) * sizeof(double) + 2 * sizeof(uint8_t));
+      }
+
+      const std::size_t HEADER_SIZE = sizeof(BINARY_CHAIN_MAGIC) + 4 * sizeof(uint32_t);
+    }
+
+    BinaryChainArrayWriter::BinaryChainArrayWriter(const std::string& directory, uint numChains,
+        const std::vector<std::uint64_t>& resumeSizes)
+          : filenames_(numChains), chainFiles_(numChains), headerWritten_(numChains, false)
+    {
+      for (uint i = 0; i < numChains; i++) {
+        filenames_[i] = directory + "/" + std::to_string(i) + ".bin";
+        if (resumeSizes.empty())
+        {
+          chainFiles_[i].open(filenames_[i],
+              std::ofstream::out | std::ofstream::binary | std::ofstream::trunc);
+        }
+        else
+        {
+          truncateChainFile(filenames_[i], resumeSizes[i]);
+          chainFiles_[i].open(filenames_[i],
+              std::ofstream::out | std::ofstream::binary | std::ofstream::app);
+          headerWritten_[i] = resumeSizes[i] > 0;
+        }
+        assert(chainFiles_[i].good());
+      }
+    }
+
+    void BinaryChainArrayWriter::append(int id, std::vector<mcmc::State>::iterator start,
+        std::vector<mcmc::State>::iterator end)
+    {
+      assert(id >= 0 && (uint)id < chainFiles_.size());
+      uint nStates = end - start;
+      if (nStates == 0)
+        return;
+
+      uint nDims = start->sample.size();
+      std::size_t pos = 0;
+      buffer_.resize(HEADER_SIZE + sizeof(uint32_t) + chunkSize(nStates, nDims));
+
+      if (!headerWritten_[id])
+      {
+        std::memcpy(buffer_.data(), BINARY_CHAIN_MAGIC, sizeof(BINARY_CHAIN_MAGIC));
+        pos += sizeof(BINARY_CHAIN_MAGIC);
+        put<uint32_t>(buffer_, pos, BINARY_CHAIN_VERSION);
+        put<uint32_t>(buffer_, pos, nDims);
+        put<uint32_t>(buffer_, pos, chainFiles_.size());
+        put<uint32_t>(buffer_, pos, id);
+        headerWritten_[id] = true;
+      }
+
+      put<uint32_t>(buffer_, pos, nStates);
+      for (uint d = 0; d < nDims; d++)
+        for (auto s = start; s != end; ++s)
+          put<double>(buffer_, pos, s->sample(d));
+      for (auto s = start; s != end; ++s)
+        put<double>(buffer_, pos, s->energy);
+      for (auto s = start; s != end; ++s)
+        put<double>(buffer_, pos, s->sigma);
+      for (auto s = start; s != end; ++s)
+        put<double>(buffer_, pos, s->beta);
+      for (auto s = start; s != end; ++s)
+        put<uint8_t>(buffer_, pos, s->accepted);
+      for (auto s = start; s != end; ++s)
+        put<uint8_t>(buffer_, pos, (uint8_t)s->swapType);
+
+      chainFiles_[id].write(buffer_.data(), pos);
+      chainFiles_[id].flush();
+    }
+
+    std::vector<std::uint64_t> BinaryChainArrayWriter::sync()
+    {
+      std::vector<std::uint64_t> sizes;
+      for (uint i = 0; i < chainFiles_.size(); i++)
+        sizes.push_back(syncChainFile(chainFiles_[i], filenames_[i]));
+      return sizes;
+    }
+
+    BinaryChainReader::BinaryChainReader(const std::string& filename)
+      : file_(filename, std::ifstream::in | std::ifstream::binary),
+        nDims_(0), nStacks_(0), stack_(0)
+    {
+      if (!file_.good())
+        throw std::runtime_error("Could not open chain file " + filename);
+
+      // Nothing has been written to the file yet
+      if (file_.peek() == std::ifstream::traits_type::eof())
+        return;
+
+      buffer_.resize(HEADER_SIZE);
+      file_.read(buffer_.data(), HEADER_SIZE);
+      if (file_.gcount() != (std::streamsize)HEADER_SIZE ||
+          std::memcmp(buffer_.data(), BINARY_CHAIN_MAGIC, sizeof(BINARY_CHAIN_MAGIC)) != 0)
+        throw std::runtime_error(filename + " is not a binary chain file");
+
+      std::size_t pos = sizeof(BINARY_CHAIN_MAGIC);
+      uint32_t version = get<uint32_t>(buffer_, pos);
+      if (version > BINARY_CHAIN_VERSION)
+        throw std::runtime_error(filename + " has unsupported version " + std::to_string(version));
+      nDims_ = get<uint32_t>(buffer_, pos);
+      nStacks_ = get<uint32_t>(buffer_, pos);
+      stack_ = get<uint32_t>(buffer_, pos);
+    }
+
+    bool BinaryChainReader::readChunk(std::vector<mcmc::State>& states)
+    {
+      uint32_t nStates;
+      if (!file_.read(reinterpret_cast<char*>(&nStates), sizeof(nStates)))
+        return false;
+
+      buffer_.resize(chunkSize(nStates, nDims_));
+      if (!file_.read(buffer_.data(), buffer_.size()))
+        return false; // the chunk was cut short
+
+      states.resize(nStates);
+      std::size_t pos = 0;
+      for (auto& s : states)
+        s.sample.resize(nDims_);
+      for (uint d = 0; d < nDims_; d++)
+        for (auto& s : states)
+          s.sample(d) = get<double>(buffer_, pos);
+      for (auto& s : states)
+        s.energy = get<double>(buffer_, pos);
+      for (auto& s : states)
+        s.sigma = get<double>(buffer_, pos);
+      for (auto& s : states)
+        s.beta = get<double>(buffer_, pos);
+      for (auto& s : states)
+        s.accepted = get<uint8_t>(buffer_, pos);
+      for (auto& s : states)
+        s.swapType = (mcmc::SwapType)get<uint8_t>(buffer_, pos);
+      return true;
+    }
+
+    std::vector<mcmc::State> BinaryChainReader::readAll()
+    {
+      std::vector<mcmc::State> all, chunk;
+      while (readChunk(chunk))
+        all.insert(all.end(), chunk.begin(), chunk.end());
+      return all;
+    }
+
+  } // namespace db
+} // namespace stateline
@@ -0,0 +1,110 @@
+//!
+//! Contains the binary column-oriented chain file format.
+//!
+//! A chain file starts with a header, followed by any number of chunks that
+//! each hold a batch of states appended together:
+//!
+//! \code
+//! header: "SLCHAIN\0"  magic (8 bytes)
+//!         uint32       format version
+//!         uint32       number of dimensions of a sample
+//!         uint32       number of stacks
+//!         uint32       the stack this file belongs to
+//! chunk:  uint32       number of states n
+//!         double[n*d]  samples, one column of n values per dimension
+//!         double[n]    energy
+//!         double[n]    sigma
+//!         double[n]    beta
+//!         uint8[n]     accepted
+//!         uint8[n]     swap type
+//! \endcode
+//!
+//! Values are in host byte order (little-endian on all supported platforms).
+//! The header is written with the first chunk, so a file with no states may
+//! be empty. A chunk cut short by a crash is ignored by the reader.
+//!
+//! \file db/binary.hpp
+//! \author agent
+//! \date 2026
+//! \license Lesser General Public License version 3 or later
+//! \copyright (c) 2014, NICTA
+//!
+
+#pragma once
+
+#include "db/db.hpp"
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace stateline
+{
+  namespace db
+  {
+    //! Identifies a binary chain file.
+    const char BINARY_CHAIN_MAGIC[8] = { 'S', 'L', 'C', 'H', 'A', 'I', 'N', '\0' };
+
+    //! The version of the binary chain format written.
+    const uint32_t BINARY_CHAIN_VERSION = 1;
+
+    //! Writes chains to binary column-oriented files named <id>.bin.
+    //!
+    class BinaryChainArrayWriter : public ChainArrayWriter
+    {
+      public:
+        //! \param resumeSizes If not empty, the files are continued from
+        //!        these sizes rather than started afresh.
+        BinaryChainArrayWriter(const std::string& directory, uint numChains,
+            const std::vector<std::uint64_t>& resumeSizes = {});
+
+        void append(int id, std::vector<mcmc::State>::iterator start,
+          std::vector<mcmc::State>::iterator end) override;
+
+        std::vector<std::uint64_t> sync() override;
+
+      private:
+        std::vector<std::string> filenames_;
+        std::vector<std::ofstream> chainFiles_;
+        std::vector<bool> headerWritten_;
+        std::vector<char> buffer_; // reused between chunks
+    };
+
+    //! Reads a chain file written by BinaryChainArrayWriter.
+    //!
+    class BinaryChainReader
+    {
+      public:
+        //! Open a chain file and read its header.
+        //!
+        //! \param filename The path of the file.
+        //! \throws std::runtime_error If the file isn't a binary chain file.
+        //!
+        BinaryChainReader(const std::string& filename);
+
+        uint numDims() const { return nDims_; }
+        uint numStacks() const { return nStacks_; }
+        uint stack() const { return stack_; }
+
+        //! Read the next chunk of states.
+        //!
+        //! \param states Replaced by the states in the chunk.
+        //! \return False if there are no more complete chunks.
+        //!
+        bool readChunk(std::vector<mcmc::State>& states);
+
+        //! Read all the remaining states in the file.
+        //!
+        std::vector<mcmc::State> readAll();
+
+      private:
+        std::ifstream file_;
+        uint nDims_;
+        uint nStacks_;
+        uint stack_;
+        std::vector<char> buffer_;
+    };
+
+  } // namespace db
+} // namespace stateline
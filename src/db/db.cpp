@@ -10,6 +10,15 @@
 //!
 
 #include "db/db.hpp"
+#include "db/binary.hpp"
+
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 namespace stateline
 {
@@ -24,12 +33,22 @@ namespace stateline
       return os;
     }
 
-    CSVChainArrayWriter::CSVChainArrayWriter(const std::string& directory, uint numChains)
-          : chainFiles_(numChains)
+    CSVChainArrayWriter::CSVChainArrayWriter(const std::string& directory, uint numChains,
+        const std::vector<std::uint64_t>& resumeSizes)
+          : filenames_(numChains), chainFiles_(numChains)
     {
       for (uint i = 0; i < numChains; i++) {
-        chainFiles_[i].open(directory + "/" + std::to_string(i) + ".csv",
-            std::fstream::in | std::fstream::out | std::fstream::trunc);
+        filenames_[i] = directory + "/" + std::to_string(i) + ".csv";
+        if (resumeSizes.empty())
+        {
+          chainFiles_[i].open(filenames_[i],
+              std::fstream::in | std::fstream::out | std::fstream::trunc);
+        }
+        else
+        {
+          truncateChainFile(filenames_[i], resumeSizes[i]);
+          chainFiles_[i].open(filenames_[i], std::fstream::out | std::fstream::app);
+        }
         assert(chainFiles_[i].good());
       }
     }
@@ -38,13 +57,67 @@ namespace stateline
         std::vector<mcmc::State>::iterator end)
     {
       // TODO: needs to be transactional
-      assert(id >= 0 && id < chainFiles_.size());
+      assert(id >= 0 && (uint)id < chainFiles_.size());
       
       std::for_each(start, end, [&](const mcmc::State &s){
           chainFiles_[id] << s << "\n";});
     
       chainFiles_[id] << std::flush;
     }
+
+    std::vector<std::uint64_t> CSVChainArrayWriter::sync()
+    {
+      std::vector<std::uint64_t> sizes;
+      for (uint i = 0; i < chainFiles_.size(); i++)
+        sizes.push_back(syncChainFile(chainFiles_[i], filenames_[i]));
+      return sizes;
+    }
+
+    void truncateChainFile(const std::string& filename, std::uint64_t size)
+    {
+      struct stat info;
+      if (::stat(filename.c_str(), &info) != 0)
+      {
+        // Nothing had been written at the checkpoint either
+        if (size == 0)
+          return;
+        throw std::runtime_error("Could not find chain file " + filename + " to resume");
+      }
+
+      if ((std::uint64_t)info.st_size < size)
+        throw std::runtime_error("Chain file " + filename + " is shorter than at the checkpoint");
+
+      if (::truncate(filename.c_str(), size) != 0)
+        throw std::runtime_error("Could not truncate " + filename + ": " + std::strerror(errno));
+    }
+
+    std::uint64_t syncChainFile(std::ostream& file, const std::string& filename)
+    {
+      file.flush();
+
+      // Streams can't be synced directly, but any descriptor for the file will do
+      int fd = ::open(filename.c_str(), O_RDONLY);
+      if (fd < 0)
+        throw std::runtime_error("Could not sync " + filename + ": " + std::strerror(errno));
+      ::fsync(fd);
+
+      struct stat info;
+      ::fstat(fd, &info);
+      ::close(fd);
+      return info.st_size;
+    }
+
+    std::unique_ptr<ChainArrayWriter> makeChainArrayWriter(ChainFileFormat format,
+        const std::string& directory, uint numChains,
+        const std::vector<std::uint64_t>& resumeSizes)
+    {
+      if (format == ChainFileFormat::Binary)
+        return std::unique_ptr<ChainArrayWriter>(
+            new BinaryChainArrayWriter(directory, numChains, resumeSizes));
+      else
+        return std::unique_ptr<ChainArrayWriter>(
+            new CSVChainArrayWriter(directory, numChains, resumeSizes));
+    }
   } // namespace db
 } // namespace stateline
 
@@ -13,6 +13,8 @@
 #include <string>
 #include <vector>
 #include <fstream>
+#include <memory>
+#include <cstdint>
 #include <cassert>
 
 #include "settings.hpp"
@@ -26,17 +28,78 @@ namespace stateline
   {
     std::ostream& operator<<(std::ostream& os, const mcmc::State& s);
 
+    //! The file formats chains can be stored in.
+    //!
+    enum class ChainFileFormat
+    {
+      //! One text line per state. See CSVChainArrayWriter.
+      CSV,
+
+      //! Chunked binary columns. See BinaryChainArrayWriter.
+      Binary
+    };
+
     // Database writer interface
-    class CSVChainArrayWriter
+    class ChainArrayWriter
     {
       public:
-        CSVChainArrayWriter(const std::string& directory, uint numChains);
+        virtual ~ChainArrayWriter() = default;
+
+        //! Append states to the end of a chain's file.
+        //!
+        //! \param id The index of the chain's file.
+        //! \param start The first state to append.
+        //! \param end One past the last state to append.
+        //!
+        virtual void append(int id, std::vector<mcmc::State>::iterator start,
+          std::vector<mcmc::State>::iterator end) = 0;
+
+        //! Wait until everything appended so far is on disk.
+        //!
+        //! \return The size in bytes of each chain's file.
+        //!
+        virtual std::vector<std::uint64_t> sync() = 0;
+    };
+
+    class CSVChainArrayWriter : public ChainArrayWriter
+    {
+      public:
+        //! \param resumeSizes If not empty, the files are continued from
+        //!        these sizes rather than started afresh.
+        CSVChainArrayWriter(const std::string& directory, uint numChains,
+            const std::vector<std::uint64_t>& resumeSizes = {});
         void append(int id, std::vector<mcmc::State>::iterator start,
-          std::vector<mcmc::State>::iterator end);
+          std::vector<mcmc::State>::iterator end) override;
+        std::vector<std::uint64_t> sync() override;
 
       private:
+        std::vector<std::string> filenames_;
         std::vector<std::fstream> chainFiles_;
     };
 
+    //! Cut a chain file back to the size it had at a checkpoint, discarding
+    //! anything written after it.
+    //!
+    //! \throws std::runtime_error If the file is shorter than that size.
+    //!
+    void truncateChainFile(const std::string& filename, std::uint64_t size);
+
+    //! Flush a chain file to disk.
+    //!
+    //! \return The size of the file in bytes.
+    //!
+    std::uint64_t syncChainFile(std::ostream& file, const std::string& filename);
+
+    //! Create a writer for chain files in the given format.
+    //!
+    //! \param format The format of the files.
+    //! \param directory The directory to write the files into.
+    //! \param numChains The number of chain files to write.
+    //! \param resumeSizes If not empty, the sizes to continue the files from.
+    //!
+    std::unique_ptr<ChainArrayWriter> makeChainArrayWriter(ChainFileFormat format,
+        const std::string& directory, uint numChains,
+        const std::vector<std::uint64_t>& resumeSizes = {});
+
   } // namespace db
 } // namespace stateline
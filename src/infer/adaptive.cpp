@@ -33,7 +33,7 @@ namespace stateline
       : nStacks_(nStacks), nTemps_(nTemps), min_cap_(min_cap), 
       max_cap_(max_cap), optimalRate_(optimalRate),
       mu_xy_(nTemps), mu_xx_(nTemps), weight_(nTemps), count_(nTemps),
-      window_(nTemps*nStacks), window_sum_(nTemps*nStacks, 0), 
+      window_(nTemps*nStacks, CircularBuffer<int>(n_window_)), window_sum_(nTemps*nStacks, 0), 
       rates_(nStacks*nTemps, 0.), values_(nStacks*nTemps, 1.)
     {
       // Initialialise a valid configuration
@@ -79,15 +79,12 @@ namespace stateline
 
       // Logging: update the accept rate using a circular buffer
       int ia = acc;  // accepted as an int
-      window_[chainID].push_back(ia);
+      CircularBuffer<int>& window = window_[chainID];
+      if (window.full())
+        window_sum_[chainID] -= window.front(); // about to be overwritten
+      window.push_back(ia);
       window_sum_[chainID] += ia;
-      uint n = window_[chainID].size();
-      if (n >= n_window_)
-      {
-        window_sum_[chainID] -= window_[chainID][0];
-        window_[chainID].pop_front();
-      }
-      rates_[chainID] = (double) window_sum_[chainID] / (double) n;
+      rates_[chainID] = (double) window_sum_[chainID] / (double) window.size();
     }
 
     // Generic predictor
@@ -150,6 +147,42 @@ namespace stateline
       return rates_;
     }
 
+    void RegressionAdapter::save(CheckpointWriter& out) const
+    {
+      out.write(nStacks_);
+      out.write(nTemps_);
+      out.write(mu_xy_);
+      out.write(mu_xx_);
+      out.write(weight_);
+      out.write(count_);
+      for (const auto& window : window_)
+        out.write(std::vector<int>(window.begin(), window.end()));
+      out.write(window_sum_);
+      out.write(rates_);
+      out.write(values_);
+    }
+
+    void RegressionAdapter::load(CheckpointReader& in)
+    {
+      in.expect(nStacks_, "number of stacks");
+      in.expect(nTemps_, "number of temperatures");
+      in.read(mu_xy_);
+      in.read(mu_xx_);
+      in.read(weight_);
+      in.read(count_);
+      for (auto& window : window_)
+      {
+        std::vector<int> values;
+        in.read(values);
+        window.clear();
+        for (int x : values)
+          window.push_back(x);
+      }
+      in.read(window_sum_);
+      in.read(rates_);
+      in.read(values_);
+    }
+
 
 
     ProposalShaper::ProposalShaper(uint nStacks, uint nTemps, 
@@ -212,6 +245,22 @@ namespace stateline
     {
       return N_;
     }
+
+    void ProposalShaper::save(CheckpointWriter& out) const
+    {
+      out.write(nDims_);
+      out.write(count_);
+      out.write(L_);
+      out.write(N_);
+    }
+
+    void ProposalShaper::load(CheckpointReader& in)
+    {
+      in.expect(nDims_, "number of dimensions");
+      in.read(count_);
+      in.read(L_);
+      in.read(N_);
+    }
     
   } // mcmc
 } // stateline
@@ -12,6 +12,7 @@
 #include <Eigen/Core>
 #include <json.hpp>
 #include "../infer/datatypes.hpp"
+#include "../infer/checkpoint.hpp"
 #include "../common/circularbuffer.hpp"
 
 namespace stateline
@@ -34,6 +35,9 @@ namespace stateline
         const std::vector<double>& rates() const;
         const std::vector<double>& values() const;
 
+        void save(CheckpointWriter& out) const;
+        void load(CheckpointReader& in);
+
       private:
 
         uint nStacks_;
@@ -49,7 +53,7 @@ namespace stateline
         std::vector<double> count_;
 
         // For estimating the accept rates using a rolling window
-        std::vector<std::deque<int>> window_;
+        std::vector<CircularBuffer<int>> window_;
         std::vector<int> window_sum_;
         std::vector<double> rates_;
         std::vector<double> values_;
@@ -64,6 +68,9 @@ namespace stateline
         void update(uint i, const Eigen::VectorXd& stepv);
         const std::vector<Eigen::MatrixXd> &Ns() const;
 
+        void save(CheckpointWriter& out) const;
+        void load(CheckpointReader& in);
+
       private:
         double nDims_;
         double prop_norm_;
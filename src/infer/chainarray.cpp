@@ -10,10 +10,12 @@
 //!
 
 #include "infer/chainarray.hpp"
+#include "db/asyncwriter.hpp"
 
 #include <iostream>
 #include <easylogging/easylogging++.h>
 #include <random>
+#include <algorithm>
 
 namespace stateline
 {
@@ -25,14 +27,12 @@ namespace stateline
     //! \param newState The proposed state.
     //! \param oldState The current state of the chain.
     //! \param beta The inverse temperature of the chain.
+    //! \param uniform A uniform draw on [0,1).
     //! \return True if the proposal was accepted.
     //!
-    bool acceptProposal(const State& newState, const State& oldState, double beta)
+    bool ChainArray::acceptProposal(const State& newState, const State& oldState, double beta,
+        double uniform)
     {
-      static std::random_device rd;
-      static std::mt19937 generator(rd());
-      static std::uniform_real_distribution<> rand; // defaults to [0,1)
-
       if (std::isinf(newState.energy))
         return false;
 
@@ -40,7 +40,7 @@ namespace stateline
       double probToAccept = std::exp(-1.0 * beta * deltaEnergy);
 
       // Roll the dice to determine acceptance
-      bool accept = rand(generator) < probToAccept;
+      bool accept = uniform < probToAccept;
       return accept;
     }
 
@@ -52,30 +52,32 @@ namespace stateline
     //! \param betaHigh The inverse temperature of the high temperature chain.
     //! \return True if the swap was accepted.
     //!
-    bool acceptSwap(const State& stateLow, const State& stateHigh, double betaLow, double betaHigh)
+    bool ChainArray::acceptSwap(const State& stateLow, const State& stateHigh, double betaLow, double betaHigh)
     {
-      static std::random_device rd;
-      static std::mt19937 generator(rd());
-      static std::uniform_real_distribution<> rand; // defaults to [0,1)
-
       // Compute the probability of swapping
       double deltaEnergy = stateHigh.energy - stateLow.energy;
       double deltaBeta = betaHigh - betaLow;
       double probToSwap = std::exp(deltaEnergy * deltaBeta);
-      bool swapAccepted = rand(generator) < probToSwap;
+      bool swapAccepted = rand_(generator_) < probToSwap;
       return swapAccepted;
     }
 
 
-    ChainArray::ChainArray(uint nStacks, uint nTemps, const std::string& outputPath)
-        : writer_(outputPath, nStacks),
+    ChainArray::ChainArray(uint nStacks, uint nTemps, const ChainSettings& settings)
+        : writer_(new db::AsyncChainArrayWriter(
+              db::makeChainArrayWriter(settings.outputFormat, settings.outputPath, nStacks,
+                settings.resumeFileSizes),
+              nStacks * settings.cacheLength)),
           nstacks_(nStacks),
           ntemps_(nTemps),
           lengthOnDisk_(nStacks * nTemps, 0),
           beta_(nStacks * nTemps),
           sigma_(nStacks * nTemps),
           cache_(nStacks * nTemps),
-          lastFlushTime_(std::chrono::high_resolution_clock::now())
+          cacheLength_(std::max(settings.cacheLength, 2u)),
+          flushInterval_(settings.msFlushInterval),
+          lastFlushTime_(std::chrono::high_resolution_clock::now()),
+          generator_(std::random_device()())
     {
     }
 
@@ -91,11 +93,21 @@ namespace stateline
       return result;
     }
 
+    double ChainArray::drawUniform()
+    {
+      return rand_(generator_);
+    }
+
     bool ChainArray::append(uint id, const Eigen::VectorXd& sample, double energy)
+    {
+      return append(id, sample, energy, drawUniform());
+    }
+
+    bool ChainArray::append(uint id, const Eigen::VectorXd& sample, double energy, double uniform)
     {
       State newState = {sample, energy, sigma_[id], beta_[id], false, SwapType::NoAttempt};
       State last = lastState(id);
-      bool accepted = acceptProposal(newState, last, beta_[id]);
+      bool accepted = acceptProposal(newState, last, beta_[id], uniform);
 
       if (accepted)
         cache_[id].push_back(newState);
@@ -105,12 +117,12 @@ namespace stateline
       cache_[id].back().accepted = accepted;
       cache_[id].back().swapType = SwapType::NoAttempt;
       
-      //Flush the chains every so often
-      const uint flushTime = 10; //TODO make a setting
+      //Flush the chains every so often, and whenever a cache fills up
+      if (cache_[id].size() >= cacheLength_)
+        flushToDisk(id);
+
       auto now = std::chrono::high_resolution_clock::now();
-      uint secs = std::chrono::duration_cast<std::chrono::seconds>(
-      now - lastFlushTime_).count();
-      if (secs >= flushTime)
+      if (now - lastFlushTime_ >= flushInterval_)
       {
         lastFlushTime_ = now;
         for (uint i = 0; i < nstacks_*ntemps_; i++)
@@ -141,7 +153,7 @@ namespace stateline
       if (chainIndex(id) == 0)
       {
         VLOG(3) << "Flushing cache of chain " << id << ". new length on disk: " << newLength;
-        writer_.append(id / numTemps(), std::begin(cache_[id]), 
+        writer_->append(id / numTemps(), std::begin(cache_[id]), 
             std::end(cache_[id])-1);
       }
 
@@ -154,6 +166,59 @@ namespace stateline
       cache_[id].push_back(recent);
     }
 
+    std::vector<std::uint64_t> ChainArray::sync()
+    {
+      for (uint i = 0; i < nstacks_*ntemps_; i++)
+        flushToDisk(i);
+      return writer_->sync();
+    }
+
+    void ChainArray::save(CheckpointWriter& out) const
+    {
+      out.write(nstacks_);
+      out.write(ntemps_);
+      out.write(lengthOnDisk_);
+      out.write(beta_);
+      out.write(sigma_);
+      for (uint i = 0; i < nstacks_*ntemps_; i++)
+      {
+        // Only the last state is kept after a flush
+        const State& s = cache_[i].back();
+        out.write(s.sample);
+        out.write(s.energy);
+        out.write(s.sigma);
+        out.write(s.beta);
+        out.write(s.accepted);
+        out.write((int)s.swapType);
+      }
+      out.writeRandom(generator_);
+      out.writeRandom(rand_);
+    }
+
+    void ChainArray::load(CheckpointReader& in)
+    {
+      in.expect(nstacks_, "number of stacks");
+      in.expect(ntemps_, "number of temperatures");
+      in.read(lengthOnDisk_);
+      in.read(beta_);
+      in.read(sigma_);
+      for (uint i = 0; i < nstacks_*ntemps_; i++)
+      {
+        State s;
+        int swapType;
+        in.read(s.sample);
+        in.read(s.energy);
+        in.read(s.sigma);
+        in.read(s.beta);
+        in.read(s.accepted);
+        in.read(swapType);
+        s.swapType = (SwapType)swapType;
+        cache_[i].assign(1, s);
+      }
+      in.readRandom(generator_);
+      in.readRandom(rand_);
+    }
+
     State ChainArray::lastState(uint id) const
     {
       return cache_[id].back();
@@ -12,13 +12,48 @@
 #pragma once
 
 #include <chrono>
+#include <random>
 #include "../db/db.hpp"
 #include "../infer/datatypes.hpp"
+#include "../infer/checkpoint.hpp"
 
 namespace stateline
 {
   namespace mcmc
   {
+    //! Settings for storing the chains.
+    //!
+    struct ChainSettings
+    {
+      //! The directory to write the cold chains into.
+      std::string outputPath;
+
+      //! The file format of the cold chains.
+      db::ChainFileFormat outputFormat;
+
+      //! How often all the chains are written out, in milliseconds.
+      uint msFlushInterval;
+
+      //! The number of states a chain keeps in memory before they are
+      //! written out, regardless of the flush interval.
+      uint cacheLength;
+
+      //! If not empty, the chain files are continued from these sizes, as
+      //! returned by ChainArray::sync() when the checkpoint was made.
+      std::vector<std::uint64_t> resumeFileSizes;
+
+      //! Default settings
+      static ChainSettings Default(const std::string& outputPath)
+      {
+        ChainSettings settings;
+        settings.outputPath = outputPath;
+        settings.outputFormat = db::ChainFileFormat::CSV;
+        settings.msFlushInterval = 10000;
+        settings.cacheLength = 1000;
+        return settings;
+      }
+    };
+
     //! Manager for all the states and handle reading / writing from / to database.
     //!
     //! \section id The chain ID used by MCMC sampler.
@@ -36,6 +71,9 @@ namespace stateline
     //! id 7 = stack 2 chain 4 // highest temperature chain of stack 2
     //! \endcode
     //!
+    //! States are written out by a background thread, so the sampler doesn't
+    //! wait on file I/O.
+    //!
     class ChainArray
     {
       public:
@@ -46,7 +84,7 @@ namespace stateline
         //! \param nTemps The number of chains in each stack.
         //! \param settings The Chain array settings object
         //
-        ChainArray(uint nStacks, uint nTemps, const std::string& outputPath);
+        ChainArray(uint nStacks, uint nTemps, const ChainSettings& settings);
 
         // Move constructor only
         ChainArray(ChainArray&& other);
@@ -69,6 +107,21 @@ namespace stateline
         //!
         bool append(uint id, const Eigen::VectorXd& sample, double energy);
 
+        //! Append a state to a chain, deciding whether to accept it with a
+        //! uniform draw made in advance (see \ref drawUniform).
+        //!
+        //! \param id The id of the chain (see \ref id).
+        //! \param uniform The draw to compare the acceptance probability with.
+        //! \return Whether the state accepted or rejected (in which case last state is reappended).
+        //!
+        bool append(uint id, const Eigen::VectorXd& sample, double energy, double uniform);
+
+        //! Draw from the uniform distribution on [0,1) used to accept
+        //! proposals. Drawing before a proposal is evaluated fixes the most
+        //! energy it can have and be accepted.
+        //!
+        double drawUniform();
+
         //! Initialise a chain (by definitely accepting a new state).
         //!
         //! \param id The id of the chain (see \ref id).
@@ -83,6 +136,21 @@ namespace stateline
         //!
         void flushToDisk(uint id);
 
+        //! Flush all the chains and wait until they are written to disk.
+        //!
+        //! \return The size of each output file, to resume from.
+        //!
+        std::vector<std::uint64_t> sync();
+
+        //! Save the chains to a checkpoint. Call sync() first so that the
+        //! output files are consistent with it.
+        //!
+        void save(CheckpointWriter& out) const;
+
+        //! Restore the chains from a checkpoint, instead of initialising them.
+        //!
+        void load(CheckpointReader& in);
+
         //! Return the last state from a chain.
         //!
         //! \param id The id of the chain (see \ref id).
@@ -153,23 +221,24 @@ namespace stateline
         bool isColdestInStack(uint id) const;
 
       private:
-        void setLastState(uint id, const State& state);
+        bool acceptProposal(const State& newState, const State& oldState, double beta,
+            double uniform);
 
-        //! Recover a particular chain from disk.
-        //!
-        //! \param id The id of the chain to recover.
-        //!
-        void recoverFromDisk(uint id);
+        bool acceptSwap(const State& stateLow, const State& stateHigh, double betaLow, double betaHigh);
 
         //mutable db::Database db_; // Mutable so that chain queries can be const
-        db::CSVChainArrayWriter writer_;
+        std::unique_ptr<db::ChainArrayWriter> writer_;
         uint nstacks_;
         uint ntemps_;
         std::vector<uint> lengthOnDisk_;
         std::vector<double> beta_;
         std::vector<double> sigma_;
         std::vector<std::vector<State>> cache_;
+        uint cacheLength_;
+        std::chrono::milliseconds flushInterval_;
         std::chrono::high_resolution_clock::time_point lastFlushTime_;
+        std::mt19937 generator_;
+        std::uniform_real_distribution<> rand_; // defaults to [0,1)
     };
 
   } // namespace mcmc
@@ -0,0 +1,120 @@
+//!
+//! Contains the implementation of sampler checkpoints.
+//!
+//! \file infer/checkpoint.cpp
+//! \author agent
+//! \date 2026
+//! \license Lesser General Public License version 3 or later
+//! \copyright (c) 2014, NICTA
+//!
+
+#include "infer/checkpoint.hpp"
+
+#include <cerrno>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace stateline
+{
+  namespace mcmc
+  {
+    namespace
+    {
+      const char CHECKPOINT_MAGIC[8] = { 'S', 'L', 'C', 'K', 'P', 'T', '\0', '\0' };
+
+      void fail(const std::string& what, const std::string& filename)
+      {
+        throw std::runtime_error(what + " " + filename + ": " + std::strerror(errno));
+      }
+    }
+
+    CheckpointWriter::CheckpointWriter()
+      : buffer_(CHECKPOINT_MAGIC, sizeof(CHECKPOINT_MAGIC))
+    {
+      write(CHECKPOINT_VERSION);
+    }
+
+    void CheckpointWriter::write(const std::string& value)
+    {
+      write<uint64_t>(value.size());
+      buffer_.append(value);
+    }
+
+    void CheckpointWriter::commit(const std::string& filename) const
+    {
+      // Write to a temporary file and rename it over the old checkpoint, which
+      // replaces it atomically
+      std::string tmpFilename = filename + ".tmp";
+      int fd = ::open(tmpFilename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+      if (fd < 0)
+        fail("Could not create checkpoint", tmpFilename);
+
+      std::size_t written = 0;
+      while (written < buffer_.size())
+      {
+        ssize_t n = ::write(fd, buffer_.data() + written, buffer_.size() - written);
+        if (n < 0)
+        {
+          ::close(fd);
+          fail("Could not write checkpoint", tmpFilename);
+        }
+        written += n;
+      }
+
+      if (::fsync(fd) != 0 || ::close(fd) != 0)
+        fail("Could not write checkpoint", tmpFilename);
+
+      if (std::rename(tmpFilename.c_str(), filename.c_str()) != 0)
+        fail("Could not replace checkpoint", filename);
+
+      // Make the rename itself durable
+      std::size_t slash = filename.find_last_of('/');
+      std::string directory = slash == std::string::npos ? "." : filename.substr(0, slash);
+      int dirFd = ::open(directory.c_str(), O_RDONLY);
+      if (dirFd >= 0)
+      {
+        ::fsync(dirFd);
+        ::close(dirFd);
+      }
+    }
+
+    CheckpointReader::CheckpointReader(const std::string& filename)
+      : pos_(0)
+    {
+      std::ifstream file(filename, std::ifstream::in | std::ifstream::binary);
+      if (!file)
+        fail("Could not open checkpoint", filename);
+      buffer_.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+
+      if (buffer_.size() < sizeof(CHECKPOINT_MAGIC) ||
+          buffer_.compare(0, sizeof(CHECKPOINT_MAGIC), CHECKPOINT_MAGIC, sizeof(CHECKPOINT_MAGIC)) != 0)
+        throw std::runtime_error(filename + " is not a checkpoint");
+      pos_ = sizeof(CHECKPOINT_MAGIC);
+
+      uint32_t version;
+      read(version);
+      if (version != CHECKPOINT_VERSION)
+        throw std::runtime_error(filename + " has unsupported version " + std::to_string(version));
+    }
+
+    void CheckpointReader::read(std::string& value)
+    {
+      uint64_t n;
+      read(n);
+      value.resize(n);
+      take(&value[0], n);
+    }
+
+    void CheckpointReader::take(char* data, std::size_t size)
+    {
+      if (pos_ + size > buffer_.size())
+        throw std::runtime_error("Checkpoint is truncated");
+      std::memcpy(data, buffer_.data() + pos_, size);
+      pos_ += size;
+    }
+  }
+}
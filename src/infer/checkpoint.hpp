@@ -0,0 +1,172 @@
+//!
+//! Contains reading and writing of sampler checkpoints.
+//!
+//! A checkpoint is a flat binary archive. Each component writes its state in
+//! its save() method and reads it back in the same order in load(), so the
+//! archive itself has no structure beyond a header.
+//!
+//! \file infer/checkpoint.hpp
+//! \author agent
+//! \date 2026
+//! \license Lesser General Public License version 3 or later
+//! \copyright (c) 2014, NICTA
+//!
+
+#pragma once
+
+#include <Eigen/Core>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+namespace stateline
+{
+  namespace mcmc
+  {
+    //! The version of the checkpoint format written.
+    const uint32_t CHECKPOINT_VERSION = 1;
+
+    //! Accumulates a checkpoint in memory and writes it out atomically.
+    //!
+    class CheckpointWriter
+    {
+      public:
+        CheckpointWriter();
+
+        template <class T>
+        typename std::enable_if<std::is_arithmetic<T>::value>::type write(T value)
+        {
+          buffer_.append(reinterpret_cast<const char*>(&value), sizeof(T));
+        }
+
+        void write(const std::string& value);
+
+        template <class T>
+        void write(const std::vector<T>& values)
+        {
+          write<uint64_t>(values.size());
+          for (const T& x : values)
+            write(x);
+        }
+
+        template <class T>
+        void write(const std::deque<T>& values)
+        {
+          write<uint64_t>(values.size());
+          for (const T& x : values)
+            write(x);
+        }
+
+        template <int Rows, int Cols, int Options, int MaxRows, int MaxCols>
+        void write(const Eigen::Matrix<double, Rows, Cols, Options, MaxRows, MaxCols>& m)
+        {
+          write<uint64_t>(m.rows());
+          write<uint64_t>(m.cols());
+          buffer_.append(reinterpret_cast<const char*>(m.data()), m.size() * sizeof(double));
+        }
+
+        //! Write a random number engine or distribution, which can only be
+        //! saved through its stream operator.
+        //!
+        template <class Engine>
+        void writeRandom(const Engine& engine)
+        {
+          std::ostringstream os;
+          os << engine;
+          write(os.str());
+        }
+
+        //! Replace the file at a path with the checkpoint. The file is either
+        //! the old checkpoint or the new one, even if the process crashes.
+        //!
+        //! \throws std::runtime_error If the file couldn't be written.
+        //!
+        void commit(const std::string& filename) const;
+
+      private:
+        std::string buffer_;
+    };
+
+    //! Reads a checkpoint written by CheckpointWriter.
+    //!
+    class CheckpointReader
+    {
+      public:
+        //! Read a checkpoint file.
+        //!
+        //! \throws std::runtime_error If the file can't be read or isn't a
+        //!         checkpoint.
+        //!
+        CheckpointReader(const std::string& filename);
+
+        template <class T>
+        typename std::enable_if<std::is_arithmetic<T>::value>::type read(T& value)
+        {
+          take(reinterpret_cast<char*>(&value), sizeof(T));
+        }
+
+        void read(std::string& value);
+
+        template <class T>
+        void read(std::vector<T>& values)
+        {
+          uint64_t n;
+          read(n);
+          values.resize(n);
+          for (T& x : values)
+            read(x);
+        }
+
+        template <class T>
+        void read(std::deque<T>& values)
+        {
+          uint64_t n;
+          read(n);
+          values.resize(n);
+          for (T& x : values)
+            read(x);
+        }
+
+        template <int Rows, int Cols, int Options, int MaxRows, int MaxCols>
+        void read(Eigen::Matrix<double, Rows, Cols, Options, MaxRows, MaxCols>& m)
+        {
+          uint64_t rows, cols;
+          read(rows);
+          read(cols);
+          m.resize(rows, cols);
+          take(reinterpret_cast<char*>(m.data()), m.size() * sizeof(double));
+        }
+
+        template <class Engine>
+        void readRandom(Engine& engine)
+        {
+          std::string state;
+          read(state);
+          std::istringstream is(state);
+          is >> engine;
+        }
+
+        //! Read a value, throwing if it differs from the expected one.
+        //!
+        template <class T>
+        void expect(const T& expected, const std::string& what)
+        {
+          T value;
+          read(value);
+          if (value != expected)
+            throw std::runtime_error("Checkpoint has a different " + what + " to the current settings");
+        }
+
+      private:
+        void take(char* data, std::size_t size);
+
+        std::string buffer_;
+        std::size_t pos_;
+    };
+  }
+}
@@ -86,9 +86,9 @@ namespace stateline
       }
     }
 
-    void TableLogger::updateApi(ApiResources& res, const ChainArray& chains)
+    void TableLogger::updateApi(ApiResources& res, const ChainArray& chains, const std::string& prefix)
     {
-      res.set("config", json({
+      res.set(prefix + "config", json({
         { "stacks", chains.numStacks() },
         { "chainsPerStack", chains.numTemps() }
       }));
@@ -107,7 +107,7 @@ namespace stateline
           { "swapRate", nSwapsGlobal_[i] / (double)nSwapAttemptsGlobal_[i] }
         }));
       }
-      res.set("chains", result);
+      res.set(prefix + "chains", result);
     }
   } // namespace mcmc
 } // namespace stateline
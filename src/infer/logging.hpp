@@ -36,7 +36,10 @@ namespace stateline
             const std::vector<double>& betas,
             const std::vector<double>& swapRates);
 
-        void updateApi(ApiResources& res, const ChainArray& array);
+        //! Set the config and chains resources, with their names after a
+        //! prefix that tells apart the problems of a server.
+        //!
+        void updateApi(ApiResources& res, const ChainArray& array, const std::string& prefix = "");
 
       private:
         ch::steady_clock::time_point lastPrintTime_;
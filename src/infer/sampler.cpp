@@ -10,8 +10,10 @@
 //!
 
 #include "infer/sampler.hpp"
+#include <cmath>
 #include <functional>
 #include <iostream>
+#include <limits>
 
 namespace ph = std::placeholders;
 
@@ -101,6 +103,20 @@ namespace stateline
     {
       proposalShape_.update(id, stepv);
     }
+
+    void GaussianProposal::save(CheckpointWriter& out) const
+    {
+      out.writeRandom(gen_);
+      out.writeRandom(rand_);
+      proposalShape_.save(out);
+    }
+
+    void GaussianProposal::load(CheckpointReader& in)
+    {
+      in.readRandom(gen_);
+      in.readRandom(rand_);
+      proposalShape_.load(in);
+    }
     
     //ProposalFunction& proposal,
     Sampler::Sampler(comms::Requester& requester, 
@@ -109,7 +125,10 @@ namespace stateline
                      mcmc::GaussianProposal& proposal, 
                      RegressionAdapter& sigmaAdapter,
                      RegressionAdapter& betaAdapter,
-                     uint swapInterval)
+                     uint swapInterval,
+                     uint proposalsInFlight,
+                     bool earlyRejection,
+                     double minJobEnergy)
       : requester_(requester),
         jobTypes_(std::move(jobTypes)),
         chains_(chainArray),
@@ -118,9 +137,10 @@ namespace stateline
         betaAdapter_(betaAdapter),
         nstacks_(chains_.numStacks()),
         nchains_(chains_.numTemps()),
-        propStates_(nstacks_*nchains_),
+        speculator_(nstacks_ * nchains_, proposalsInFlight),
         swapInterval_(swapInterval),
-        numOutstandingJobs_(0),
+        earlyRejection_(earlyRejection),
+        minJobEnergy_(minJobEnergy),
         locked_(nstacks_ * nchains_, false),
         haveFlushed_(true)
     {
@@ -142,17 +162,18 @@ namespace stateline
     std::pair<uint, State> Sampler::step()
     {
 
-      // Retrieve a result {id, likelihood factors}
-      auto result = requester_.retrieve();
-      uint id = result.first;
-      double energy = 0.0;
-      for (const auto& r : result.second)
-        energy += r;
-      numOutstandingJobs_--;
+      // Results for speculative proposals are held until their chain
+      // gets to them
+      while (ready_.empty())
+        retrieve();
+      uint id = ready_.front();
+      ready_.pop_front();
 
       // Advance the Markov chain (accept or reject logic inside append)
       State previous_state = chains_.lastState(id);
-      chains_.append(id, propStates_[id], energy);  // TODO: return something?
+      const SpeculativeProposal& proposal = *speculator_.current(id);
+      bool accepted = chains_.append(id, proposal.sample, proposal.energy, proposal.uniform);
+      speculator_.resolve(id, accepted);
       State state = chains_.lastState(id); 
       haveFlushed_ = false;
 
@@ -171,9 +192,8 @@ namespace stateline
         // The chain above is waiting -> attempt a swap
         // TODO(Al) - make swap return a bool?
         bool swapped = chains_.swap(id, id + 1) == SwapType::Accept;  
-
-        // Propagate the swap to the rung below:
-        unlock(id);  // Proposes for id+1 and locks id-1
+        if (swapped)
+          speculator_.discard(id);
 
         // Apply temperature update logic:
         betaAdapter_.betaUpdate(id, chains_.beta(id), chains_.beta(id+1), swapped);
@@ -182,8 +202,12 @@ namespace stateline
             betaAdapter_.computeBetaStack(id);
 
         // We just finished an interval - set last interval's optimum
-        // temperature to the guy we just unlocked...
+        // temperature to the guy we are about to unlock. This is done
+        // before it proposes, as the cut-off of each proposal depends on it.
         chains_.setBeta(id+1, betaAdapter_.values()[id+1]);
+
+        // Propagate the swap to the rung below:
+        unlock(id);  // Proposes for id+1 and locks id-1
       }
       else if (chains_.isHottestInStack(id)
               && chains_.length(id) % swapInterval_ == 0 
@@ -191,6 +215,7 @@ namespace stateline
       {
         // Start a swap cascade from the hottest chain.
         locked_[id - 1] = true;
+        speculator_.discard(id);
       }
       else
       {
@@ -207,33 +232,95 @@ namespace stateline
     {
       // todo(Al) - should we be getting this from the chains directly?
       double sigma = sigmaAdapter_.values()[id];
-      propStates_[id] = proposal_(id, chains_.lastState(id).sample, sigma);
-      requester_.submit(id, jobTypes_, propStates_[id]);
-      numOutstandingJobs_++;
+      auto proposeFrom = [&](const Eigen::VectorXd& from) { return proposal_(id, from, sigma); };
+
+      // The hottest chain stops to swap at the end of each swap interval,
+      // so there is no point speculating past it
+      uint maxDepth = std::numeric_limits<uint>::max();
+      if (chains_.isHottestInStack(id) && chains_.numTemps() > 1)
+        maxDepth = swapInterval_ - chains_.length(id) % swapInterval_;
+
+      State state = chains_.lastState(id);
+      auto jobs = speculator_.fill(id, state.sample,
+          sigmaAdapter_.rates()[id], maxDepth, proposeFrom);
+      for (const auto& job : jobs)
+      {
+        // Drawing the uniform now fixes the most energy the proposal can
+        // have and be accepted, if we know what it will be compared with
+        SpeculativeProposal& p = *speculator_.proposal(job.first);
+        p.uniform = chains_.drawUniform();
+        double rejectAbove = std::numeric_limits<double>::infinity();
+        if (earlyRejection_ && p.fromChainState)
+          rejectAbove = state.energy - std::log(p.uniform) / chains_.beta(id);
+        requester_.submit(job.first, jobTypes_, job.second, rejectAbove, minJobEnergy_);
+      }
+
+      if (speculator_.current(id)->evaluated)
+        ready_.push_back(id);
     }
 
+    bool Sampler::retrieve()
+    {
+      auto result = requester_.retrieve();
+      double energy = 0.0;
+      for (const auto& r : result.second)
+        energy += r;
+
+      uint id;
+      if (!speculator_.evaluated(result.first, energy, id))
+        return false;
+      ready_.push_back(id);
+      return true;
+    }
 
     void Sampler::flush()
     {
       haveFlushed_ = true;
       // Retrieve all outstanding job results.
-      while (numOutstandingJobs_--)
+      while (speculator_.numOutstanding() > 0)
+        retrieve();
+
+      // Advance each chain by its evaluated proposal
+      for (uint id : ready_)
       {
-        auto result = requester_.retrieve();
-        uint id = result.first;
-        double energy = 0.0;
-        for (const auto& r : result.second)
-        {
-          energy += r;
-        }
-        chains_.append(id, propStates_[id], energy);
+        const SpeculativeProposal& proposal = *speculator_.current(id);
+        speculator_.resolve(id, chains_.append(id, proposal.sample, proposal.energy,
+              proposal.uniform));
       }
+      ready_.clear();
 
       // Manually flush any chain states that are in memory to disk
       for (uint i = 0; i < chains_.numTotalChains(); i++)
         chains_.flushToDisk(i);
     }
 
+    void Sampler::save(CheckpointWriter& out) const
+    {
+      // Outstanding proposals aren't saved; they are proposed afresh on resume
+      std::vector<uint8_t> locked(locked_.begin(), locked_.end());
+      std::vector<uint8_t> proposing;
+      for (uint i = 0; i < chains_.numTotalChains(); i++)
+        proposing.push_back(speculator_.current(i) != nullptr);
+      out.write(locked);
+      out.write(proposing);
+    }
+
+    void Sampler::load(CheckpointReader& in)
+    {
+      std::vector<uint8_t> locked, proposing;
+      in.read(locked);
+      in.read(proposing);
+      if (locked.size() != locked_.size() || proposing.size() != locked_.size())
+        throw std::runtime_error("Checkpoint has a different number of chains to the current settings");
+
+      // Every chain started proposing on construction. Those that were
+      // waiting to swap drop their proposals.
+      locked_.assign(locked.begin(), locked.end());
+      for (uint i = 0; i < chains_.numTotalChains(); i++)
+        if (!proposing[i])
+          speculator_.discard(i);
+    }
+
     void Sampler::unlock(uint id)
     {
       // Unlock this chain
@@ -253,7 +340,11 @@ namespace stateline
       {
         // This is the coldest chain and there is no one to swap with
         propose(id);
+        return;
       }
+
+      // This chain now waits to swap with the chain below
+      speculator_.discard(id);
     }
   
   }
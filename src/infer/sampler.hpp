@@ -15,9 +15,11 @@
 #include "../infer/datatypes.hpp"
 #include "../infer/adaptive.hpp"
 #include "../infer/chainarray.hpp"
+#include "../infer/speculation.hpp"
 #include "../app/jsonsettings.hpp"
 
 #include <json.hpp>
+#include <deque>
 #include <random>
 
 namespace stateline
@@ -74,6 +76,9 @@ namespace stateline
 
         void update(uint id, const Eigen::VectorXd &sample);
 
+        void save(CheckpointWriter& out) const;
+        void load(CheckpointReader& in);
+
       private:
         std::mt19937 gen_;
         std::normal_distribution<> rand_; // Standard normal generator
@@ -88,13 +93,25 @@ namespace stateline
     {
       public:
         // look into ProposalFunction& proposal
+        //
+        // proposalsInFlight is the number of proposals each chain keeps
+        // submitted. Above one, proposals are made speculatively from the
+        // possible outcomes of those not yet resolved.
+        //
+        // With earlyRejection, the job types must all have energies of at
+        // least minJobEnergy. A proposal is then cut short once the energies
+        // of its finished job types make it certain to be rejected, and its
+        // other job types are cancelled.
         Sampler(comms::Requester& requester, 
                 std::vector<uint> jobTypes,
                 ChainArray& chainArray,
                 mcmc::GaussianProposal& proposal, 
                 RegressionAdapter& sigmaAdapter,
                 RegressionAdapter& betaAdapter,
-                uint swapInterval);
+                uint swapInterval,
+                uint proposalsInFlight = 1,
+                bool earlyRejection = false,
+                double minJobEnergy = 0.0);
 
         ~Sampler();
       
@@ -102,12 +119,26 @@ namespace stateline
 
         void flush();
 
+        //! Save which chains are proposing and which are waiting to swap.
+        //!
+        void save(CheckpointWriter& out) const;
+
+        //! Restore which chains are proposing and which are waiting to swap.
+        //! Must be called straight after construction, with the chains
+        //! restored from the same checkpoint.
+        //!
+        void load(CheckpointReader& in);
+
       private:
 
         void propose(uint id);
 
         void unlock(uint id);
 
+        // Wait for a result, returning false if it wasn't for a proposal
+        // that can be resolved yet.
+        bool retrieve();
+
         comms::Requester& requester_;
 
         std::vector<uint> jobTypes_;
@@ -129,13 +160,17 @@ namespace stateline
         const uint nchains_;
 
         // The proposed states in the process of being computed
-        std::vector<Eigen::VectorXd> propStates_;
+        ProposalSpeculator speculator_;
+
+        // Chains whose current proposal has been evaluated
+        std::deque<uint> ready_;
 
         // How often to attempt a swap
         uint swapInterval_;
 
-        // How many jobs haven't been retrieved?
-        uint numOutstandingJobs_;
+        // Whether to cut proposals short, and the least energy of a job
+        bool earlyRejection_;
+        double minJobEnergy_;
 
         // Whether a chain is locked. A locked chain will wait for any outstanding
         // job results and propagate the lock.
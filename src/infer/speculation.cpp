@@ -0,0 +1,169 @@
+//!
+//! Contains the implementation of speculative proposal evaluation.
+//!
+//! \file infer/speculation.cpp
+//! \author agent
+//! \date 2026
+//! \license Lesser General Public License version 3 or later
+//! \copyright (c) 2014, NICTA
+//!
+
+#include "infer/speculation.hpp"
+
+#include <algorithm>
+#include <cassert>
+
+namespace stateline
+{
+  namespace mcmc
+  {
+    namespace
+    {
+      void markDiscarded(SpeculativeProposal* p)
+      {
+        if (!p)
+          return;
+        p->discarded = true;
+        markDiscarded(p->ifAccepted.get());
+        markDiscarded(p->ifRejected.get());
+      }
+
+      uint treeSize(const SpeculativeProposal* p)
+      {
+        if (!p)
+          return 0;
+        return 1 + treeSize(p->ifAccepted.get()) + treeSize(p->ifRejected.get());
+      }
+
+      // The most probable outcome that hasn't been speculated on yet
+      struct Slot
+      {
+        SpeculativeProposal* parent;
+        bool accepted;
+        double probability;
+      };
+
+      void findBestSlot(SpeculativeProposal* p, double acceptRate, uint maxDepth, Slot& best)
+      {
+        if (p->depth >= maxDepth)
+          return;
+
+        for (bool accepted : { true, false })
+        {
+          auto& child = accepted ? p->ifAccepted : p->ifRejected;
+          double probability = p->probability * (accepted ? acceptRate : 1.0 - acceptRate);
+          if (child)
+            findBestSlot(child.get(), acceptRate, maxDepth, best);
+          else if (!best.parent || probability > best.probability)
+            best = { p, accepted, probability };
+        }
+      }
+    }
+
+    ProposalSpeculator::ProposalSpeculator(uint nChains, uint maxProposals)
+      : maxProposals_(std::max(maxProposals, 1u)),
+        nextJobId_(0),
+        current_(nChains)
+    {
+    }
+
+    SpeculativeProposal* ProposalSpeculator::current(uint chain) const
+    {
+      return current_[chain].get();
+    }
+
+    SpeculativeProposal* ProposalSpeculator::proposal(uint jobId) const
+    {
+      auto it = outstanding_.find(jobId);
+      return it == outstanding_.end() ? nullptr : it->second.get();
+    }
+
+    ProposalSpeculator::ProposalPtr ProposalSpeculator::makeProposal(uint chain,
+        const Eigen::VectorXd& from, double probability, uint depth, bool fromChainState,
+        const ProposeFunction& propose, std::vector<std::pair<uint, Eigen::VectorXd>>& jobs)
+    {
+      ProposalPtr p(new SpeculativeProposal { chain, from, propose(from), 0.0,
+          false, false, probability, fromChainState, 0.0, depth, nullptr, nullptr });
+      uint jobId = nextJobId_++;
+      outstanding_.insert(std::make_pair(jobId, p));
+      jobs.push_back(std::make_pair(jobId, p->sample));
+      return p;
+    }
+
+    std::vector<std::pair<uint, Eigen::VectorXd>> ProposalSpeculator::fill(uint chain,
+        const Eigen::VectorXd& state, double acceptRate, uint maxDepth,
+        const ProposeFunction& propose)
+    {
+      std::vector<std::pair<uint, Eigen::VectorXd>> jobs;
+      auto& root = current_[chain];
+      if (!root)
+        root = makeProposal(chain, state, 1.0, 1, true, propose, jobs);
+
+      // Stop speculating on outcomes that are (almost) certain not to happen
+      acceptRate = std::min(std::max(acceptRate, 0.01), 0.99);
+
+      for (uint size = treeSize(root.get()); size < maxProposals_; size++)
+      {
+        Slot best = { nullptr, false, 0.0 };
+        findBestSlot(root.get(), acceptRate, maxDepth, best);
+        if (!best.parent)
+          break;
+
+        // Only rejections lead back to the state the chain has now
+        const Eigen::VectorXd& from = best.accepted ? best.parent->sample : best.parent->from;
+        auto& child = best.accepted ? best.parent->ifAccepted : best.parent->ifRejected;
+        bool fromChainState = !best.accepted && best.parent->fromChainState;
+        child = makeProposal(chain, from, best.probability, best.parent->depth + 1,
+            fromChainState, propose, jobs);
+      }
+
+      return jobs;
+    }
+
+    bool ProposalSpeculator::evaluated(uint jobId, double energy, uint& chain)
+    {
+      auto it = outstanding_.find(jobId);
+      assert(it != outstanding_.end());
+      ProposalPtr p = it->second;
+      outstanding_.erase(it);
+
+      chain = p->chain;
+      p->energy = energy;
+      p->evaluated = true;
+      return !p->discarded && p == current_[chain];
+    }
+
+    void ProposalSpeculator::resolve(uint chain, bool accepted)
+    {
+      ProposalPtr p = current_[chain];
+      assert(p && p->evaluated);
+      markDiscarded(accepted ? p->ifRejected.get() : p->ifAccepted.get());
+      current_[chain] = accepted ? p->ifAccepted : p->ifRejected;
+
+      // The new current proposal is made from the chain's new state
+      if (current_[chain])
+        current_[chain]->fromChainState = true;
+
+      // Re-root the probabilities at the new current proposal
+      std::vector<SpeculativeProposal*> stack = { current_[chain].get() };
+      double scale = current_[chain] ? 1.0 / current_[chain]->probability : 1.0;
+      while (!stack.empty())
+      {
+        SpeculativeProposal* q = stack.back();
+        stack.pop_back();
+        if (!q)
+          continue;
+        q->probability *= scale;
+        q->depth--;
+        stack.push_back(q->ifAccepted.get());
+        stack.push_back(q->ifRejected.get());
+      }
+    }
+
+    void ProposalSpeculator::discard(uint chain)
+    {
+      markDiscarded(current_[chain].get());
+      current_[chain] = nullptr;
+    }
+  }
+}
@@ -0,0 +1,152 @@
+//!
+//! Contains speculative evaluation of future MCMC proposals.
+//!
+//! Only one proposal per chain can be resolved at a time, because each
+//! proposal is made from the state the previous one led to. Speculation
+//! evaluates future proposals before the current one is resolved: one
+//! proposal is made from the state the chain moves to if the current
+//! proposal is accepted, and another from the state it keeps if it is
+//! rejected, and so on down the tree. Once the current proposal is
+//! resolved, the speculation for the other outcome is dropped.
+//!
+//! The accept/reject step is unchanged, so each chain still follows
+//! exactly one path of proposals and acceptances.
+//!
+//! \file infer/speculation.hpp
+//! \author agent
+//! \date 2026
+//! \license Lesser General Public License version 3 or later
+//! \copyright (c) 2014, NICTA
+//!
+
+#pragma once
+
+#include <Eigen/Core>
+#include <functional>
+#include <map>
+#include <memory>
+#include <vector>
+
+namespace stateline
+{
+  namespace mcmc
+  {
+    //! A proposal that has been submitted for evaluation.
+    //!
+    struct SpeculativeProposal
+    {
+      uint chain;
+
+      //! The state the proposal was made from.
+      Eigen::VectorXd from;
+
+      //! The proposed state.
+      Eigen::VectorXd sample;
+
+      double energy;
+      bool evaluated;
+
+      //! Set when the chain can no longer reach this proposal.
+      bool discarded;
+
+      //! Estimated probability of the chain reaching this proposal.
+      double probability;
+
+      //! Set when the proposal is known to be made from the chain's current
+      //! state, so the energy it will be compared with is known.
+      bool fromChainState;
+
+      //! Uniform draw that decides whether the proposal is accepted.
+      double uniform;
+
+      //! Depth in the tree, where the chain's current proposal is 1.
+      uint depth;
+
+      //! Proposals made assuming this one is accepted or rejected.
+      std::shared_ptr<SpeculativeProposal> ifAccepted;
+      std::shared_ptr<SpeculativeProposal> ifRejected;
+    };
+
+    //! Keeps up to a given number of proposals per chain submitted for
+    //! evaluation, speculating on the outcomes of those not yet resolved.
+    //!
+    class ProposalSpeculator
+    {
+      public:
+        using ProposeFunction = std::function<Eigen::VectorXd(const Eigen::VectorXd& from)>;
+
+        //! Create a speculator.
+        //!
+        //! \param nChains The total number of chains.
+        //! \param maxProposals The maximum number of proposals per chain to
+        //!        keep submitted. A value of one disables speculation.
+        //!
+        ProposalSpeculator(uint nChains, uint maxProposals);
+
+        //! The proposal the chain is currently evaluating, or nullptr if it
+        //! isn't evaluating one.
+        //!
+        SpeculativeProposal* current(uint chain) const;
+
+        //! The proposal submitted with a job id, or nullptr if it has been
+        //! evaluated.
+        //!
+        SpeculativeProposal* proposal(uint jobId) const;
+
+        //! Make sure a chain is evaluating a proposal from its current state
+        //! and speculate on it until the chain has the maximum number of
+        //! proposals. The most probable outcomes are speculated on first.
+        //!
+        //! \param chain The chain id.
+        //! \param state The current state of the chain.
+        //! \param acceptRate The estimated acceptance rate of the chain.
+        //! \param maxDepth The number of steps the chain will take before
+        //!        its state may be changed other than by a proposal.
+        //! \param propose Makes a proposal from a state.
+        //! \return The new proposals as (job id, sample) pairs, to be
+        //!         submitted for evaluation.
+        //!
+        std::vector<std::pair<uint, Eigen::VectorXd>> fill(uint chain,
+            const Eigen::VectorXd& state, double acceptRate, uint maxDepth,
+            const ProposeFunction& propose);
+
+        //! Record the energy of an evaluated proposal.
+        //!
+        //! \param jobId The id the proposal was submitted with.
+        //! \param energy The energy of the proposal.
+        //! \param chain Set to the chain the proposal belongs to.
+        //! \return Whether the proposal is the current proposal of its chain,
+        //!         and so can be resolved.
+        //!
+        bool evaluated(uint jobId, double energy, uint& chain);
+
+        //! Resolve the current proposal of a chain. Speculation on the
+        //! outcome that happened is kept and becomes current.
+        //!
+        void resolve(uint chain, bool accepted);
+
+        //! Drop all speculation for a chain, for when its state is changed
+        //! by something other than a proposal.
+        //!
+        void discard(uint chain);
+
+        //! The number of proposals submitted that haven't been evaluated,
+        //! including those that were discarded.
+        //!
+        uint numOutstanding() const { return outstanding_.size(); }
+
+      private:
+        using ProposalPtr = std::shared_ptr<SpeculativeProposal>;
+
+        ProposalPtr makeProposal(uint chain, const Eigen::VectorXd& from,
+            double probability, uint depth, bool fromChainState, const ProposeFunction& propose,
+            std::vector<std::pair<uint, Eigen::VectorXd>>& jobs);
+
+        uint maxProposals_;
+        uint nextJobId_;
+
+        std::vector<ProposalPtr> current_;
+        std::map<uint, ProposalPtr> outstanding_;
+    };
+  }
+}
@@ -0,0 +1,107 @@
+//!
+//! Contains tests for the background chain writer.
+//!
+//! \file test/asyncwriter.cpp
+//! \author agent
+//! \date 2026
+//! \license Lesser General Public License version 3 or later
+//! \copyright (c) 2014, NICTA
+//!
+
+#include "gtest/gtest.h"
+
+#include "db/asyncwriter.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <thread>
+
+using namespace stateline;
+using namespace stateline::db;
+
+namespace
+{
+  // Records what it is asked to write, optionally waiting to be released
+  class RecordingWriter : public ChainArrayWriter
+  {
+    public:
+      RecordingWriter(std::vector<std::pair<int, double>>& written, std::atomic<bool>& blocked)
+        : written_(written), blocked_(blocked)
+      {
+      }
+
+      void append(int id, std::vector<mcmc::State>::iterator start,
+          std::vector<mcmc::State>::iterator end) override
+      {
+        while (blocked_)
+          std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        for (auto s = start; s != end; ++s)
+          written_.push_back(std::make_pair(id, s->energy));
+      }
+
+      std::vector<std::uint64_t> sync() override
+      {
+        return { written_.size() };
+      }
+
+    private:
+      std::vector<std::pair<int, double>>& written_;
+      std::atomic<bool>& blocked_;
+  };
+
+  std::vector<mcmc::State> makeStates(std::initializer_list<double> energies)
+  {
+    std::vector<mcmc::State> states;
+    for (double e : energies)
+      states.push_back({ Eigen::VectorXd::Zero(1), e, 1.0, 1.0, true, mcmc::SwapType::NoAttempt });
+    return states;
+  }
+}
+
+TEST(AsyncWriterTest, writesEverythingInOrderBeforeDestruction)
+{
+  std::vector<std::pair<int, double>> written;
+  std::atomic<bool> blocked(false);
+  {
+    AsyncChainArrayWriter writer(std::unique_ptr<ChainArrayWriter>(
+          new RecordingWriter(written, blocked)), 100);
+    auto a = makeStates({ 1.0, 2.0 });
+    auto b = makeStates({ 3.0 });
+    writer.append(0, a.begin(), a.end());
+    writer.append(1, b.begin(), b.end());
+  }
+
+  std::vector<std::pair<int, double>> expected = { {0, 1.0}, {0, 2.0}, {1, 3.0} };
+  EXPECT_EQ(expected, written);
+}
+
+TEST(AsyncWriterTest, syncWaitsForQueuedStates)
+{
+  std::vector<std::pair<int, double>> written;
+  std::atomic<bool> blocked(false);
+  AsyncChainArrayWriter writer(std::unique_ptr<ChainArrayWriter>(
+        new RecordingWriter(written, blocked)), 100);
+  auto a = makeStates({ 1.0, 2.0, 3.0 });
+  writer.append(0, a.begin(), a.end());
+  EXPECT_EQ(std::vector<std::uint64_t>{ 3 }, writer.sync());
+}
+
+TEST(AsyncWriterTest, appendBlocksOnlyWhenQueueIsFull)
+{
+  std::vector<std::pair<int, double>> written;
+  std::atomic<bool> blocked(true);
+  AsyncChainArrayWriter writer(std::unique_ptr<ChainArrayWriter>(
+        new RecordingWriter(written, blocked)), 3);
+
+  // Fits in the queue while the writer is stuck
+  auto a = makeStates({ 1.0, 2.0, 3.0 });
+  writer.append(0, a.begin(), a.end());
+
+  auto b = makeStates({ 4.0 });
+  auto future = std::async(std::launch::async, [&]() { writer.append(0, b.begin(), b.end()); });
+  EXPECT_EQ(std::future_status::timeout, future.wait_for(std::chrono::milliseconds(50)));
+
+  blocked = false;
+  EXPECT_EQ(std::future_status::ready, future.wait_for(std::chrono::seconds(5)));
+}
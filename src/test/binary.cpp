@@ -0,0 +1,119 @@
+//!
+//! Contains tests for the binary chain file format.
+//!
+//! \file test/binary.cpp
+//! \author agent
+//! \date 2026
+//! \license Lesser General Public License version 3 or later
+//! \copyright (c) 2014, NICTA
+//!
+
+#include "gtest/gtest.h"
+
+#include "db/binary.hpp"
+
+#include <cstdio>
+
+using namespace stateline;
+using namespace stateline::db;
+
+namespace
+{
+  mcmc::State makeState(double x, bool accepted, mcmc::SwapType swapType)
+  {
+    Eigen::VectorXd sample(3);
+    sample << x, x / 3.0, -x;
+    return { sample, x * 0.1, 0.5, 1.0 / 7.0, accepted, swapType };
+  }
+
+  void expectSameState(const mcmc::State& a, const mcmc::State& b)
+  {
+    EXPECT_EQ(a.sample, b.sample);
+    EXPECT_EQ(a.energy, b.energy);
+    EXPECT_EQ(a.sigma, b.sigma);
+    EXPECT_EQ(a.beta, b.beta);
+    EXPECT_EQ(a.accepted, b.accepted);
+    EXPECT_EQ(a.swapType, b.swapType);
+  }
+}
+
+class BinaryChainTest : public testing::Test
+{
+  protected:
+    ~BinaryChainTest()
+    {
+      std::remove("0.bin");
+      std::remove("1.bin");
+    }
+};
+
+TEST_F(BinaryChainTest, roundTripsStatesExactly)
+{
+  std::vector<mcmc::State> first = {
+    makeState(1.0, true, mcmc::SwapType::NoAttempt),
+    makeState(2.0, false, mcmc::SwapType::Accept) };
+  std::vector<mcmc::State> second = {
+    makeState(3.0, true, mcmc::SwapType::Reject) };
+
+  {
+    BinaryChainArrayWriter writer(".", 2);
+    writer.append(1, first.begin(), first.end());
+    writer.append(1, second.begin(), second.end());
+  }
+
+  BinaryChainReader reader("1.bin");
+  EXPECT_EQ(3U, reader.numDims());
+  EXPECT_EQ(2U, reader.numStacks());
+  EXPECT_EQ(1U, reader.stack());
+
+  auto states = reader.readAll();
+  ASSERT_EQ(3U, states.size());
+  expectSameState(first[0], states[0]);
+  expectSameState(first[1], states[1]);
+  expectSameState(second[0], states[2]);
+}
+
+TEST_F(BinaryChainTest, emptyChainHasNoStates)
+{
+  {
+    BinaryChainArrayWriter writer(".", 1);
+  }
+
+  BinaryChainReader reader("0.bin");
+  EXPECT_EQ(0U, reader.readAll().size());
+}
+
+TEST_F(BinaryChainTest, ignoresTruncatedChunk)
+{
+  std::vector<mcmc::State> states = {
+    makeState(1.0, true, mcmc::SwapType::NoAttempt),
+    makeState(2.0, false, mcmc::SwapType::NoAttempt) };
+  {
+    BinaryChainArrayWriter writer(".", 1);
+    writer.append(0, states.begin(), states.begin() + 1);
+    writer.append(0, states.begin() + 1, states.end());
+  }
+
+  // Cut the last chunk short, as if the writer crashed part way through it
+  std::FILE* f = std::fopen("0.bin", "rb");
+  std::vector<char> bytes(4096);
+  bytes.resize(std::fread(bytes.data(), 1, bytes.size(), f));
+  std::fclose(f);
+  f = std::fopen("0.bin", "wb");
+  std::fwrite(bytes.data(), 1, bytes.size() - 5, f);
+  std::fclose(f);
+
+  BinaryChainReader reader("0.bin");
+  auto read = reader.readAll();
+  ASSERT_EQ(1U, read.size());
+  expectSameState(states[0], read[0]);
+}
+
+TEST_F(BinaryChainTest, rejectsOtherFiles)
+{
+  std::FILE* f = std::fopen("0.bin", "wb");
+  std::fputs("0.5,1.0,2.0,1,0\n", f);
+  std::fclose(f);
+
+  EXPECT_THROW(BinaryChainReader("0.bin"), std::runtime_error);
+}
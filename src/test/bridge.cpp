@@ -0,0 +1,552 @@
+//!
+//! Contains tests for the in-process bridge between requesters and the
+//! delegator.
+//!
+//! \file test/bridge.cpp
+//! \author agent
+//! \date 2026
+//! \license Lesser General Public License version 3 or later
+//! \copyright (c) 2014, NICTA
+//!
+
+#include "gtest/gtest.h"
+
+#include "comms/bridge.hpp"
+#include "comms/delegator.hpp"
+#include "comms/requester.hpp"
+#include "comms/shardeddelegator.hpp"
+#include "comms/socket.hpp"
+#include "common/mpscqueue.hpp"
+#include "app/serial.hpp"
+
+#include <cmath>
+#include <functional>
+#include <future>
+#include <limits>
+#include <set>
+#include <thread>
+
+using namespace stateline;
+using namespace stateline::comms;
+
+TEST(MpscQueueTest, keepsEachProducersOrder)
+{
+  const uint nProducers = 4, nPerProducer = 10000;
+  MpscQueue<std::pair<uint, uint>> queue;
+
+  std::vector<std::thread> producers;
+  for (uint p = 0; p < nProducers; p++)
+    producers.emplace_back([&queue, p]()
+    {
+      for (uint i = 0; i < nPerProducer; i++)
+        queue.push(std::make_pair(p, i));
+    });
+
+  std::vector<uint> next(nProducers, 0);
+  uint nPopped = 0;
+  std::pair<uint, uint> value;
+  while (nPopped < nProducers * nPerProducer)
+  {
+    if (!queue.pop(value))
+      continue;
+    ASSERT_EQ(next[value.first], value.second);
+    next[value.first]++;
+    nPopped++;
+  }
+  EXPECT_FALSE(queue.pop(value));
+
+  for (auto& t : producers)
+    t.join();
+}
+
+TEST(BridgeTest, resultsGoBackToTheirEndpoint)
+{
+  Bridge bridge;
+  Bridge::Endpoint& a = bridge.connect();
+  Bridge::Endpoint& b = bridge.connect();
+
+  a.submit(1, { 0 }, "a");
+  b.submit(2, { 0, 1 }, "b");
+
+  Bridge::Request request;
+  ASSERT_TRUE(bridge.receive(request));
+  EXPECT_EQ(&a, request.from);
+  EXPECT_EQ(1U, request.id);
+  ASSERT_TRUE(bridge.receive(request));
+  EXPECT_EQ(&b, request.from);
+  EXPECT_EQ(std::vector<uint>({ 0, 1 }), request.jobTypes);
+  EXPECT_FALSE(bridge.receive(request));
+
+  bridge.send(b, { 2, { 3.0, 4.0 } });
+  auto result = b.retrieve();
+  EXPECT_EQ(2U, result.id);
+  EXPECT_EQ(std::vector<double>({ 3.0, 4.0 }), result.results);
+}
+
+TEST(BridgeTest, handedBackRequestsAreLookedAtOncePerKind)
+{
+  Bridge bridge;
+  Bridge::Endpoint& endpoint = bridge.connect();
+  double inf = std::numeric_limits<double>::infinity();
+  for (uint i = 0; i < 100; i++)
+    bridge.handBack({ &endpoint, i, { 0, 1 }, "", inf, 0.0, {} });
+  bridge.handBack({ &endpoint, 100, { 0 }, "", inf, 0.0, {} });
+
+  // Only the oldest of each kind is looked at
+  uint nLooked = 0;
+  auto onlyFirstType = [&](const Bridge::Request& r)
+  {
+    nLooked++;
+    return r.jobTypes.size() == 1;
+  };
+  Bridge::Request request;
+  ASSERT_TRUE(bridge.receive(request, onlyFirstType));
+  EXPECT_EQ(100U, request.id);
+  EXPECT_EQ(2U, nLooked);
+
+  nLooked = 0;
+  EXPECT_FALSE(bridge.receive(request, onlyFirstType));
+  EXPECT_EQ(1U, nLooked);
+
+  // They come back in the order they were handed back
+  auto any = [](const Bridge::Request&) { return true; };
+  ASSERT_TRUE(bridge.receive(request, any));
+  EXPECT_EQ(0U, request.id);
+  ASSERT_TRUE(bridge.receive(request, any));
+  EXPECT_EQ(1U, request.id);
+}
+
+TEST(BridgeTest, closeWakesWaitingRequester)
+{
+  Bridge bridge;
+  Bridge::Endpoint& endpoint = bridge.connect();
+  auto waiting = std::async(std::launch::async, [&]() { endpoint.retrieve(); });
+
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  bridge.close();
+  EXPECT_THROW(waiting.get(), std::runtime_error);
+}
+
+TEST(BridgeTest, delegatorAnswersLocalRequester)
+{
+  zmq::context_t context{1};
+  DelegatorSettings settings = DelegatorSettings::Default(5556);
+  settings.msPollRate = 100;
+  settings.nJobTypes = 2;
+  Bridge bridge;
+  bool running = true;
+  auto delegator = std::async(std::launch::async, [&]()
+  {
+    Delegator d(context, settings, running, &bridge);
+    d.start();
+  });
+
+  Socket worker{context, ZMQ_DEALER, "mockWorker", 0};
+  worker.setIdentifier("worker");
+  worker.connect("tcp://localhost:5556");
+  worker.send({ HELLO, { "0:2", "1", "2" }});
+
+  Requester requester(bridge);
+  Eigen::VectorXd sample(1);
+  sample << 1.0;
+  requester.submit(42, { 0, 1 }, sample);
+
+  // Answer each job with its type
+  for (uint i = 0; i < 2; i++)
+  {
+    Message job = worker.receive();
+    while (job.subject == HEARTBEAT)
+      job = worker.receive();
+    ASSERT_EQ(JOB, job.subject);
+    EXPECT_EQ(sample, unserialise<Eigen::VectorXd>(job.data[2].str()));
+    double type = std::stoi(job.data[0].str());
+    worker.send({ RESULT, { job.data[1], serialise(type) }});
+  }
+
+  auto result = requester.retrieve();
+  EXPECT_EQ(42U, result.first);
+  EXPECT_EQ(std::vector<double>({ 0.0, 1.0 }), result.second);
+
+  running = false;
+  delegator.wait();
+}
+
+TEST(BridgeTest, shardsShareTheRequestsOfABridge)
+{
+  zmq::context_t context{1};
+  DelegatorSettings settings = DelegatorSettings::Default(5570);
+  settings.msPollRate = 10;
+  settings.nJobTypes = 1;
+  settings.nShards = 2;
+  Bridge bridge;
+  bool running = true;
+  auto delegator = std::async(std::launch::async, [&]()
+  {
+    ShardedDelegator d(context, settings, running, bridge);
+    d.start();
+  });
+
+  // A worker of the second shard, which connects to its port directly
+  Socket worker{context, ZMQ_DEALER, "mockWorker", 0};
+  worker.setIdentifier("worker");
+  worker.connect("tcp://localhost:5571");
+  worker.send({ HELLO, { "0:1", "1", "1" }});
+
+  Requester requester(bridge);
+  Eigen::VectorXd sample(1);
+  sample << 1.0;
+  for (uint i = 0; i < 3; i++)
+  {
+    requester.submit(i, { 0 }, sample);
+    Message job = worker.receive();
+    while (job.subject == HEARTBEAT)
+      job = worker.receive();
+    ASSERT_EQ(JOB, job.subject);
+    worker.send({ RESULT, { job.data[1], serialise(double(i)) }});
+    auto result = requester.retrieve();
+    EXPECT_EQ(i, result.first);
+    EXPECT_EQ(std::vector<double>({ double(i) }), result.second);
+  }
+
+  running = false;
+  delegator.wait();
+}
+
+TEST(BridgeTest, firstShardRedirectsWorkersToTheirShard)
+{
+  zmq::context_t context{1};
+  DelegatorSettings settings = DelegatorSettings::Default(5572);
+  settings.msPollRate = 10;
+  settings.nJobTypes = 1;
+  settings.nShards = 2;
+  Bridge bridge;
+  bool running = true;
+  auto delegator = std::async(std::launch::async, [&]()
+  {
+    ShardedDelegator d(context, settings, running, bridge);
+    d.start();
+  });
+
+  // Find a worker address that belongs to the second shard
+  std::string id = "worker";
+  while (std::hash<std::string>()(id) % 2 != 1)
+    id += "x";
+
+  Socket worker{context, ZMQ_DEALER, "mockWorker", 0};
+  worker.setIdentifier(id);
+  worker.connect("tcp://localhost:5572");
+  worker.send({ HELLO, { "0:1", "1", "1", "1", "1", "1" }});
+
+  Message redirect = worker.receive();
+  while (redirect.subject == HEARTBEAT)
+    redirect = worker.receive();
+  ASSERT_EQ(REDIRECT, redirect.subject);
+  EXPECT_EQ("5573", redirect.data[0]);
+
+  running = false;
+  delegator.wait();
+}
+
+TEST(BridgeTest, requestsOfAShardThatLosesItsWorkersGoToAnother)
+{
+  zmq::context_t context{1};
+  DelegatorSettings settings = DelegatorSettings::Default(5577);
+  settings.msPollRate = 10;
+  settings.nJobTypes = 2;
+  settings.nShards = 2;
+  Bridge bridge;
+  bool running = true;
+  auto delegator = std::async(std::launch::async, [&]()
+  {
+    ShardedDelegator d(context, settings, running, bridge);
+    d.start();
+  });
+
+  auto receiveJob = [](Socket& worker)
+  {
+    Message job = worker.receive();
+    while (job.subject == HEARTBEAT)
+      job = worker.receive();
+    return job;
+  };
+
+  // The only worker of the second shard takes the request, as the first
+  // shard has none
+  Socket leaving{context, ZMQ_DEALER, "mockLeavingWorker", 0};
+  leaving.setIdentifier("leaving");
+  leaving.connect("tcp://localhost:5578");
+  leaving.send({ HELLO, { "0:2", "1", "1" }});
+
+  // It finishes one of the request's jobs before leaving
+  Requester requester(bridge);
+  Eigen::VectorXd sample(1);
+  sample << 1.0;
+  requester.submit(7, { 0, 1 }, sample);
+  Message first = receiveJob(leaving);
+  Message second = receiveJob(leaving);
+  ASSERT_EQ(JOB, first.subject);
+  ASSERT_EQ(JOB, second.subject);
+  Message finished = first.data[0] == "0" ? first : second;
+  leaving.send({ RESULT, { finished.data[1], serialise(5.0) }});
+
+  // Once it leaves, the unfinished job goes to the first shard's worker,
+  // and the finished one keeps its result
+  Socket staying{context, ZMQ_DEALER, "mockStayingWorker", 0};
+  staying.setIdentifier("staying");
+  staying.connect("tcp://localhost:5577");
+  staying.send({ HELLO, { "0:2", "1", "1" }});
+  leaving.send({ GOODBYE });
+
+  Message job = receiveJob(staying);
+  ASSERT_EQ(JOB, job.subject);
+  EXPECT_EQ("1", job.data[0]);
+  EXPECT_EQ(sample, unserialise<Eigen::VectorXd>(job.data[2].str()));
+  staying.send({ RESULT, { job.data[1], serialise(1.0) }});
+  auto result = requester.retrieve();
+  EXPECT_EQ(7U, result.first);
+  EXPECT_EQ(std::vector<double>({ 5.0, 1.0 }), result.second);
+
+  running = false;
+  delegator.wait();
+}
+
+TEST(BridgeTest, requestsGoToShardsWithWorkersForAllTheirTypes)
+{
+  zmq::context_t context{1};
+  DelegatorSettings settings = DelegatorSettings::Default(5579);
+  settings.msPollRate = 10;
+  settings.nJobTypes = 2;
+  settings.nShards = 2;
+  Bridge bridge;
+  bool running = true;
+  auto delegator = std::async(std::launch::async, [&]()
+  {
+    ShardedDelegator d(context, settings, running, bridge);
+    d.start();
+  });
+
+  auto receiveJob = [](Socket& worker)
+  {
+    Message job = worker.receive();
+    while (job.subject == HEARTBEAT)
+      job = worker.receive();
+    return job;
+  };
+
+  // The first shard's worker only does the first job type. It has done a
+  // job, so it is known to be connected before the other worker.
+  Socket partial{context, ZMQ_DEALER, "mockPartialWorker", 0};
+  partial.setIdentifier("partial");
+  partial.connect("tcp://localhost:5579");
+  partial.send({ HELLO, { "0:1", "1", "1" }});
+
+  Requester requester(bridge);
+  Eigen::VectorXd sample(1);
+  sample << 1.0;
+  requester.submit(0, { 0 }, sample);
+  Message job = receiveJob(partial);
+  partial.send({ RESULT, { job.data[1], serialise(0.0) }});
+  requester.retrieve();
+
+  // Requests for both types only go to the second shard's worker, though
+  // the first shard's is idle
+  Socket full{context, ZMQ_DEALER, "mockFullWorker", 0};
+  full.setIdentifier("full");
+  full.connect("tcp://localhost:5580");
+  full.send({ HELLO, { "0:2", "1", "1" }});
+  for (uint i = 1; i < 4; i++)
+  {
+    requester.submit(i, { 0, 1 }, sample);
+    for (uint j = 0; j < 2; j++)
+    {
+      job = receiveJob(full);
+      ASSERT_EQ(JOB, job.subject);
+      full.send({ RESULT, { job.data[1], serialise(std::stod(job.data[0].str())) }});
+    }
+    auto result = requester.retrieve();
+    EXPECT_EQ(i, result.first);
+    EXPECT_EQ(std::vector<double>({ 0.0, 1.0 }), result.second);
+  }
+
+  running = false;
+  delegator.wait();
+}
+
+TEST(TenantTest, tenantsShareTheWorkersByWeight)
+{
+  zmq::context_t context{1};
+  DelegatorSettings settings = DelegatorSettings::Default(5574);
+  settings.msPollRate = 10;
+  settings.tenants = { { "heavy", 3.0, 0, 1 }, { "light", 1.0, 0, 1 } };
+  Bridge bridge;
+  bool running = true;
+  auto delegator = std::async(std::launch::async, [&]()
+  {
+    Delegator d(context, settings, running, &bridge);
+    d.start();
+  });
+
+  // Both tenants have plenty waiting before the worker arrives
+  Requester heavy(bridge, 0), light(bridge, 1);
+  Eigen::VectorXd sample(1);
+  sample << 1.0;
+  for (uint i = 0; i < 40; i++)
+  {
+    heavy.submit(i, { 0 }, sample);
+    light.submit(i, { 0 }, sample);
+  }
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+  // Every job takes the worker's minion the same time
+  Socket worker{context, ZMQ_DEALER, "mockWorker", 0};
+  worker.setIdentifier("worker");
+  worker.connect("tcp://localhost:5574");
+  worker.send({ HELLO, { "0:2", "1", "1" }});
+
+  uint nHeavy = 0;
+  for (uint i = 0; i < 40; i++)
+  {
+    Message job = worker.receive();
+    while (job.subject == HEARTBEAT)
+      job = worker.receive();
+    ASSERT_EQ(JOB, job.subject);
+    if (job.data[0] == "0")
+      nHeavy++;
+    worker.send({ RESULT, { job.data[1], serialise(0.0), "1000" }});
+  }
+  EXPECT_GE(nHeavy, 28U);
+  EXPECT_LE(nHeavy, 32U);
+
+  running = false;
+  delegator.wait();
+}
+
+TEST(TenantTest, tenantsHaveTheirOwnJobTypesAndLimits)
+{
+  zmq::context_t context{1};
+  DelegatorSettings settings = DelegatorSettings::Default(5575);
+  settings.msPollRate = 10;
+  settings.tenants = { { "first", 1.0, 0, 2 }, { "second", 1.0, 1, 1 } };
+  Bridge bridge;
+  bool running = true;
+  auto delegator = std::async(std::launch::async, [&]()
+  {
+    Delegator d(context, settings, running, &bridge);
+    d.start();
+  });
+
+  Requester first(bridge, 0), second(bridge, 1);
+  Eigen::VectorXd sample(1);
+  sample << 1.0;
+  second.submit(0, { 0 }, sample);
+  second.submit(1, { 0 }, sample);
+  first.submit(2, { 0, 1 }, sample);
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+  Socket worker{context, ZMQ_DEALER, "mockWorker", 0};
+  worker.setIdentifier("worker");
+  worker.connect("tcp://localhost:5575");
+  worker.send({ HELLO, { "0:3", "1", "4" }});
+
+  // The second tenant's job type comes after the first's, and only one of
+  // its jobs is sent at a time
+  auto receiveJob = [&]()
+  {
+    Message job = worker.receive();
+    while (job.subject == HEARTBEAT)
+      job = worker.receive();
+    return job;
+  };
+  std::multiset<std::string> types;
+  std::vector<Message> jobs;
+  for (uint i = 0; i < 3; i++)
+  {
+    jobs.push_back(receiveJob());
+    types.insert(jobs.back().data[0].str());
+  }
+  EXPECT_EQ(std::multiset<std::string>({ "0", "1", "2" }), types);
+
+  for (const Message& job : jobs)
+    worker.send({ RESULT, { job.data[1], serialise(std::stod(job.data[0].str())) }});
+  Message next = receiveJob();
+  EXPECT_EQ("2", next.data[0]);
+  worker.send({ RESULT, { next.data[1], serialise(2.0) }});
+
+  auto result = first.retrieve();
+  EXPECT_EQ(std::vector<double>({ 0.0, 1.0 }), result.second);
+  EXPECT_EQ(std::vector<double>({ 2.0 }), second.retrieve().second);
+  EXPECT_EQ(std::vector<double>({ 2.0 }), second.retrieve().second);
+
+  // Job types beyond the tenant's own are refused
+  second.submit(3, { 1 }, sample);
+  result = second.retrieve();
+  EXPECT_EQ(3U, result.first);
+  EXPECT_TRUE(std::isinf(result.second[0]));
+
+  running = false;
+  delegator.wait();
+}
+
+TEST(TenantTest, overdueJobsOfAFullTenantAreNotCopied)
+{
+  zmq::context_t context{1};
+  DelegatorSettings settings = DelegatorSettings::Default(5576);
+  settings.msPollRate = 10;
+  settings.tenants = { { "only", 1.0, 1, 1 } };
+  Bridge bridge;
+  bool running = true;
+  auto delegator = std::async(std::launch::async, [&]()
+  {
+    Delegator d(context, settings, running, &bridge);
+    d.start();
+  });
+
+  auto receiveJob = [](Socket& worker)
+  {
+    Message job = worker.receive();
+    while (job.subject == HEARTBEAT)
+      job = worker.receive();
+    return job;
+  };
+
+  Socket worker{context, ZMQ_DEALER, "mockWorker", 0};
+  worker.setIdentifier("worker");
+  worker.connect("tcp://localhost:5576");
+  worker.send({ HELLO, { "0:1", "1", "1", "0", "1" }});
+
+  // The first job gives the worker a time of a tenth of a second to go by
+  Requester requester(bridge);
+  Eigen::VectorXd sample(1);
+  sample << 1.0;
+  requester.submit(0, { 0 }, sample);
+  Message job = receiveJob(worker);
+  worker.send({ RESULT, { job.data[1], serialise(0.0), "100000" }});
+  requester.retrieve();
+
+  // The worker holds on to the second job until well past its deadline,
+  // while another worker sits idle
+  requester.submit(1, { 0 }, sample);
+  Message slowJob = receiveJob(worker);
+  Socket otherWorker{context, ZMQ_DEALER, "mockOtherWorker", 0};
+  otherWorker.setIdentifier("otherWorker");
+  otherWorker.connect("tcp://localhost:5576");
+  otherWorker.send({ HELLO, { "0:1", "1", "1" }});
+  std::this_thread::sleep_for(std::chrono::milliseconds(1000));
+
+  worker.send({ RESULT, { slowJob.data[1], serialise(1.0) }});
+  EXPECT_EQ(std::vector<double>({ 1.0 }), requester.retrieve().second);
+  worker.send({ GOODBYE });
+
+  // The tenant was at its limit, so the first job the other worker gets is
+  // the next one rather than a copy of the slow one
+  Eigen::VectorXd nextSample(1);
+  nextSample << 2.0;
+  requester.submit(2, { 0 }, nextSample);
+  Message next = receiveJob(otherWorker);
+  EXPECT_EQ(nextSample, unserialise<Eigen::VectorXd>(next.data[2].str()));
+  otherWorker.send({ RESULT, { next.data[1], serialise(2.0) }});
+  EXPECT_EQ(2U, requester.retrieve().first);
+
+  running = false;
+  delegator.wait();
+}
@@ -0,0 +1,132 @@
+//!
+//! Contains tests for sampler checkpoints.
+//!
+//! \file test/checkpoint.cpp
+//! \author agent
+//! \date 2026
+//! \license Lesser General Public License version 3 or later
+//! \copyright (c) 2014, NICTA
+//!
+
+#include "gtest/gtest.h"
+
+#include "infer/checkpoint.hpp"
+#include "db/binary.hpp"
+
+#include <cstdio>
+#include <fstream>
+#include <random>
+
+using namespace stateline;
+using namespace stateline::mcmc;
+
+namespace
+{
+  const std::string FILENAME = "test.ckpt";
+
+  mcmc::State makeState(double x)
+  {
+    Eigen::VectorXd sample(2);
+    sample << x, -x;
+    return { sample, x, 1.0, 1.0, true, mcmc::SwapType::NoAttempt };
+  }
+}
+
+class CheckpointTest : public testing::Test
+{
+  protected:
+    ~CheckpointTest()
+    {
+      std::remove(FILENAME.c_str());
+      std::remove("0.bin");
+    }
+};
+
+TEST_F(CheckpointTest, roundTripsValuesExactly)
+{
+  Eigen::MatrixXd m(2, 3);
+  m << 1.0 / 3.0, 2, 3, 4, 5, 1e-300;
+  std::deque<double> d = { 0.1, 0.2 };
+  std::mt19937 engine(42);
+  engine.discard(1000);
+
+  CheckpointWriter out;
+  out.write(7u);
+  out.write(std::vector<uint64_t>{ 1, 2, 3 });
+  out.write(d);
+  out.write(m);
+  out.writeRandom(engine);
+  out.commit(FILENAME);
+
+  CheckpointReader in(FILENAME);
+  in.expect(7u, "value");
+  std::vector<uint64_t> v;
+  in.read(v);
+  EXPECT_EQ(std::vector<uint64_t>({ 1, 2, 3 }), v);
+  std::deque<double> d2;
+  in.read(d2);
+  EXPECT_EQ(d, d2);
+  Eigen::MatrixXd m2;
+  in.read(m2);
+  EXPECT_EQ(m, m2);
+  std::mt19937 engine2;
+  in.readRandom(engine2);
+  EXPECT_EQ(engine(), engine2());
+}
+
+TEST_F(CheckpointTest, rejectsMismatchedSettings)
+{
+  CheckpointWriter out;
+  out.write(4u);
+  out.commit(FILENAME);
+
+  CheckpointReader in(FILENAME);
+  EXPECT_THROW(in.expect(5u, "number of stacks"), std::runtime_error);
+}
+
+TEST_F(CheckpointTest, throwsOnTruncatedCheckpoint)
+{
+  CheckpointWriter out;
+  out.write(std::vector<double>(10, 1.0));
+  out.commit(FILENAME);
+
+  // Lose the end of the file
+  std::string contents;
+  {
+    std::ifstream file(FILENAME, std::ifstream::binary);
+    contents.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+  }
+  {
+    std::ofstream file(FILENAME, std::ofstream::binary | std::ofstream::trunc);
+    file.write(contents.data(), contents.size() - 4);
+  }
+
+  CheckpointReader in(FILENAME);
+  std::vector<double> v;
+  EXPECT_THROW(in.read(v), std::runtime_error);
+}
+
+TEST_F(CheckpointTest, chainFilesResumeFromSyncedSize)
+{
+  std::vector<mcmc::State> states = { makeState(1.0), makeState(2.0) };
+  std::vector<uint64_t> sizes;
+  {
+    db::BinaryChainArrayWriter writer(".", 1);
+    writer.append(0, states.begin(), states.begin() + 1);
+    sizes = writer.sync();
+
+    // Written after the checkpoint, so lost on resume
+    writer.append(0, states.begin() + 1, states.end());
+  }
+
+  {
+    db::BinaryChainArrayWriter writer(".", 1, sizes);
+    writer.append(0, states.begin() + 1, states.end());
+  }
+
+  db::BinaryChainReader reader("0.bin");
+  auto read = reader.readAll();
+  ASSERT_EQ(2U, read.size());
+  EXPECT_EQ(1.0, read[0].energy);
+  EXPECT_EQ(2.0, read[1].energy);
+}
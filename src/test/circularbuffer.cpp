@@ -0,0 +1,151 @@
+//!
+//! Contains tests for the circular buffer and statistics window.
+//!
+//! \file test/circularbuffer.cpp
+//! \author agent
+//! \date 2026
+//! \license Lesser General Public License version 3 or later
+//! \copyright (c) 2014, NICTA
+//!
+
+#include "gtest/gtest.h"
+
+#include "common/circularbuffer.hpp"
+
+#include <algorithm>
+#include <vector>
+
+using namespace stateline;
+
+namespace
+{
+  double mean(const std::vector<double>& xs)
+  {
+    double sum = 0;
+    for (double x : xs)
+      sum += x;
+    return sum / xs.size();
+  }
+
+  double variance(const std::vector<double>& xs)
+  {
+    double m = mean(xs), sum = 0;
+    for (double x : xs)
+      sum += (x - m) * (x - m);
+    return sum / xs.size();
+  }
+}
+
+TEST(CircularBufferTest, sizeCountsElementsPushed)
+{
+  CircularBuffer<int> b(3);
+  EXPECT_TRUE(b.empty());
+  EXPECT_EQ(0U, b.size());
+  EXPECT_EQ(3U, b.capacity());
+  EXPECT_EQ(b.begin(), b.end());
+
+  b.push_back(1);
+  b.push_back(2);
+  EXPECT_EQ(2U, b.size());
+  EXPECT_FALSE(b.full());
+  EXPECT_EQ(std::vector<int>({ 1, 2 }), std::vector<int>(b.begin(), b.end()));
+}
+
+TEST(CircularBufferTest, overwritesOldestWhenFull)
+{
+  CircularBuffer<int> b(3);
+  for (int i = 1; i <= 5; i++)
+    b.push_back(i);
+
+  EXPECT_TRUE(b.full());
+  EXPECT_EQ(3U, b.size());
+  EXPECT_EQ(3, b.front());
+  EXPECT_EQ(5, b.back());
+  EXPECT_EQ(4, b[1]);
+  EXPECT_EQ(std::vector<int>({ 3, 4, 5 }), std::vector<int>(b.begin(), b.end()));
+}
+
+TEST(CircularBufferTest, popFrontRemovesOldest)
+{
+  CircularBuffer<int> b(2);
+  b.push_back(1);
+  b.push_back(2);
+  b.push_back(3);
+  b.pop_front();
+  EXPECT_EQ(1U, b.size());
+  EXPECT_EQ(3, b.front());
+
+  b.push_back(4);
+  b.push_back(5);
+  EXPECT_EQ(std::vector<int>({ 4, 5 }), std::vector<int>(b.begin(), b.end()));
+
+  b.clear();
+  EXPECT_TRUE(b.empty());
+}
+
+TEST(CircularBufferTest, iteratorsAreRandomAccess)
+{
+  CircularBuffer<int> b(4);
+  for (int i : { 7, 3, 9, 1, 5 })
+    b.push_back(i);
+
+  EXPECT_EQ(4, b.end() - b.begin());
+  EXPECT_EQ(9, b.begin()[1]);
+  EXPECT_EQ(1, *(b.end() - 2));
+  std::sort(b.begin(), b.end());
+  EXPECT_EQ(std::vector<int>({ 1, 3, 5, 9 }), std::vector<int>(b.begin(), b.end()));
+
+  const CircularBuffer<int>& cb = b;
+  CircularBuffer<int>::const_iterator it = b.begin();
+  EXPECT_EQ(cb.begin(), it);
+}
+
+TEST(StatisticsWindowTest, isEmptyBeforeAnySamples)
+{
+  StatisticsWindow<uint> w(4);
+  EXPECT_TRUE(w.empty());
+  EXPECT_EQ(0U, w.count());
+  EXPECT_EQ(0.0, w.variance());
+  EXPECT_EQ(w.begin(), w.end());
+}
+
+TEST(StatisticsWindowTest, tracksStatisticsWhileFilling)
+{
+  StatisticsWindow<uint> w(4);
+  w.push_back(10);
+  w.push_back(20);
+  w.push_back(60);
+
+  EXPECT_EQ(3U, w.count());
+  EXPECT_DOUBLE_EQ(30.0, w.mean());
+  EXPECT_DOUBLE_EQ(variance({ 10, 20, 60 }), w.variance());
+  EXPECT_EQ(std::vector<uint>({ 10, 20, 60 }), std::vector<uint>(w.begin(), w.end()));
+}
+
+TEST(StatisticsWindowTest, forgetsSamplesThatLeaveTheWindow)
+{
+  StatisticsWindow<double> w(3);
+  std::vector<double> xs = { 5, 1e6, 3, 8, 13, 2, 2, 7.5 };
+  for (uint i = 0; i < xs.size(); i++)
+  {
+    w.push_back(xs[i]);
+    std::vector<double> window(xs.begin() + (i < 2 ? 0 : i - 2), xs.begin() + i + 1);
+    EXPECT_EQ(window.size(), w.count());
+    EXPECT_NEAR(mean(window), w.mean(), 1e-9);
+    EXPECT_NEAR(variance(window), w.variance(), 1e-6);
+    EXPECT_EQ(window, std::vector<double>(w.begin(), w.end()));
+  }
+}
+
+TEST(StatisticsWindowTest, movingAverageWeightsNewestSample)
+{
+  StatisticsWindow<double> w(2, 0.5);
+  w.push_back(8);
+  EXPECT_DOUBLE_EQ(8.0, w.ewma());
+  w.push_back(4);
+  EXPECT_DOUBLE_EQ(6.0, w.ewma());
+  w.push_back(2);
+  w.push_back(2);
+  w.push_back(2);
+  EXPECT_DOUBLE_EQ(2.5, w.ewma());
+}
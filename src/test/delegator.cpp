@@ -13,6 +13,8 @@
 
 #include "comms/socket.hpp"
 #include "comms/thread.hpp"
+#include "app/serial.hpp"
+#include "common/string.hpp"
 
 using namespace stateline::comms;
 
@@ -51,24 +53,24 @@ class DelegatorTest : public testing::Test
 public:
   DelegatorTest()
     : context_{1},
+      settings_(DelegatorSettings::Default(5555)),
       worker_{context_, ZMQ_DEALER, "mockWorker", 0},
       requester_{context_, ZMQ_DEALER, "mockRequester", -1},
       running_{false}
   {
-    DelegatorSettings settings = DelegatorSettings::Default(5555);
-    settings.msPollRate = 100;
-    settings.heartbeat.msPollRate = 100;
-    settings.heartbeat.msTimeout = 500;
-    settings.nJobTypes = 10;
+    settings_.msPollRate = 100;
+    settings_.heartbeat.msPollRate = 100;
+    settings_.heartbeat.msTimeout = 500;
+    settings_.nJobTypes = 10;
 
     running_ = true;
-    delFuture_ = stateline::startInThread<::stateline::comms::Delegator>(running_, std::ref(context_), std::ref(settings));
+    delFuture_ = stateline::startInThread<::stateline::comms::Delegator>(running_, std::ref(context_), std::cref(settings_));
 
     worker_.setIdentifier("worker");
     worker_.connect("tcp://localhost:5555");
 
     requester_.setIdentifier();
-    requester_.connect(DELEGATOR_SOCKET_ADDR.c_str());
+    requester_.connect(delegatorSocketAddress(5555));
   }
 
   ~DelegatorTest()
@@ -79,6 +81,7 @@ public:
   }
 
   zmq::context_t context_;
+  DelegatorSettings settings_;
   Socket worker_;
   Socket requester_;
   bool running_;
@@ -90,6 +93,402 @@ TEST_F(DelegatorTest, canSendHelloToDelegator)
   worker_.send({ HELLO, { "0:1" }});
 }
 
+TEST_F(DelegatorTest, textWorkerReceivesTextJobs)
+{
+  worker_.send({ HELLO, { "0:1" }});
+
+  std::vector<double> sample = { 0.5, -2.0 };
+  requester_.send({{ "42" }, REQUEST, { "0", stateline::serialise(sample) }});
+  auto job = receiveIgnoreHBs(worker_);
+  ASSERT_EQ(3U, job.data.size());
+  EXPECT_EQ("0.5:-2", job.data[2]);
+
+  // Text results are converted back to binary for the requester
+  worker_.send({ RESULT, { job.data[1], "1.25" }});
+  auto result = requester_.receive();
+  ASSERT_EQ(1U, result.data.size());
+  EXPECT_EQ(1.25, stateline::unserialise<double>(result.data[0].str()));
+}
+
+TEST_F(DelegatorTest, binaryWorkerReceivesBinaryJobs)
+{
+  worker_.send({ HELLO, { "0:1", "1" }});
+
+  std::vector<double> sample = { 1.0 / 3.0, -2.0 };
+  requester_.send({{ "42" }, REQUEST, { "0", stateline::serialise(sample) }});
+  auto job = receiveIgnoreHBs(worker_);
+  ASSERT_EQ(3U, job.data.size());
+  EXPECT_EQ(stateline::serialise(sample), job.data[2]);
+
+  worker_.send({ RESULT, { job.data[1], stateline::serialise(1.0 / 7.0) }});
+  auto result = requester_.receive();
+  ASSERT_EQ(1U, result.data.size());
+  EXPECT_EQ(1.0 / 7.0, stateline::unserialise<double>(result.data[0].str()));
+}
+
+TEST_F(DelegatorTest, packedWorkerReceivesPackedJobs)
+{
+  worker_.send({ HELLO, Header{0, 0, 0, 0}, { "3:4", "1" }});
+
+  std::vector<double> sample = { 1.0, 2.0 };
+  requester_.send({{ "42" }, REQUEST, { "3", stateline::serialise(sample) }});
+  auto job = receiveIgnoreHBs(worker_);
+  ASSERT_TRUE(job.packed);
+  EXPECT_EQ(JOB, job.subject);
+  EXPECT_EQ(3U, job.header.jobType);
+  EXPECT_EQ(42U, job.header.chainId);
+  ASSERT_EQ(1U, job.data.size());
+  EXPECT_EQ(stateline::serialise(sample), job.data[0]);
+
+  worker_.send({ RESULT, Header{job.header.jobId, 0, 0, 0},
+      { stateline::serialise(2.5), stateline::serialise(10.0) }});
+  auto result = requester_.receive();
+  ASSERT_EQ(1U, result.data.size());
+  EXPECT_EQ(2.5, stateline::unserialise<double>(result.data[0].str()));
+}
+
+TEST_F(DelegatorTest, requestIsCutShortOnceItsEnergyIsTooHigh)
+{
+  // A worker with two minions that doesn't batch but understands CANCEL
+  worker_.send({ HELLO, { "0:2", "1", "2", "0", "1" }});
+
+  requester_.send({{ "42" }, REQUEST, { "0:1", stateline::serialise(std::vector<double>{ 1.0 }),
+      stateline::serialise(3.0), stateline::serialise(0.0) }});
+  auto job0 = receiveIgnoreHBs(worker_);
+  auto job1 = receiveIgnoreHBs(worker_);
+  ASSERT_EQ("0", job0.data[0]);
+
+  // The first result alone is above the cut-off
+  worker_.send({ RESULT, { job0.data[1], stateline::serialise(4.0) }});
+  auto result = requester_.receive();
+  ASSERT_EQ(2U, result.data.size());
+  EXPECT_EQ(4.0, stateline::unserialise<double>(result.data[0].str()));
+  EXPECT_TRUE(std::isinf(stateline::unserialise<double>(result.data[1].str())));
+
+  auto cancel = receiveIgnoreHBs(worker_);
+  EXPECT_EQ(Message(CANCEL, { job1.data[1] }), cancel);
+}
+
+TEST_F(DelegatorTest, overdueJobIsCopiedToAnIdleWorker)
+{
+  // The worker understands CANCEL, so it is told to drop the slow copy
+  worker_.send({ HELLO, { "0:1", "1", "1", "0", "1" }});
+  std::string sample = stateline::serialise(std::vector<double>{ 1.0 });
+
+  // The first job gives the worker a time to go by
+  requester_.send({{ "1" }, REQUEST, { "0", sample }});
+  auto job = receiveIgnoreHBs(worker_);
+  worker_.send({ RESULT, { job.data[1], stateline::serialise(1.0), "10" }});
+  requester_.receive();
+
+  // The worker holds on to the second job until it is overdue
+  requester_.send({{ "2" }, REQUEST, { "0", sample }});
+  auto slowJob = receiveIgnoreHBs(worker_);
+
+  Socket otherWorker{context_, ZMQ_DEALER, "mockOtherWorker", 0};
+  otherWorker.setIdentifier("otherWorker");
+  otherWorker.connect("tcp://localhost:5555");
+  otherWorker.send({ HELLO, { "0:1", "1" }});
+
+  auto copy = receiveIgnoreHBs(otherWorker);
+  EXPECT_EQ(slowJob.data[2], copy.data[2]);
+  EXPECT_NE(slowJob.data[1], copy.data[1]);
+  otherWorker.send({ RESULT, { copy.data[1], stateline::serialise(2.0) }});
+
+  auto result = requester_.receive();
+  EXPECT_EQ(Message({ "2" }, RESULT, { stateline::serialise(2.0) }), result);
+  EXPECT_EQ(Message(CANCEL, { slowJob.data[1] }), receiveIgnoreHBs(worker_));
+
+  // The slow result comes too late to count
+  worker_.send({ RESULT, { slowJob.data[1], stateline::serialise(3.0) }});
+}
+
+TEST_F(DelegatorTest, jobsStayWithWorkersThatHaveDoneTheirTypeRecently)
+{
+  worker_.send({ HELLO, { "0:1", "1", "1" }});
+  std::string sample = stateline::serialise(std::vector<double>{ 1.0 });
+
+  requester_.send({{ "1" }, REQUEST, { "0", sample }});
+  auto job = receiveIgnoreHBs(worker_);
+  worker_.send({ RESULT, { job.data[1], stateline::serialise(1.0), "100000" }});
+  requester_.receive();
+
+  // A new worker would have to load the job type first, so isn't sent
+  // the next job even though it is idle
+  Socket otherWorker{context_, ZMQ_DEALER, "mockOtherWorker", 0};
+  otherWorker.setIdentifier("otherWorker");
+  otherWorker.connect("tcp://localhost:5555");
+  otherWorker.send({ HELLO, { "0:1", "1", "1" }});
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+  requester_.send({{ "2" }, REQUEST, { "0", sample }});
+  auto stickyJob = receiveIgnoreHBs(worker_);
+
+  // It is once waiting for the busy worker would take too long
+  requester_.send({{ "3" }, REQUEST, { "0", sample }});
+  auto movedJob = receiveIgnoreHBs(otherWorker);
+
+  worker_.send({ RESULT, { stickyJob.data[1], stateline::serialise(2.0), "100000" }});
+  otherWorker.send({ RESULT, { movedJob.data[1], stateline::serialise(3.0), "100000" }});
+  std::set<std::string> results = { requester_.receive().data[0].str(),
+                                    requester_.receive().data[0].str() };
+  EXPECT_EQ(std::set<std::string>({ stateline::serialise(2.0), stateline::serialise(3.0) }),
+      results);
+}
+
+TEST_F(DelegatorTest, workersWithHoursOfQueuedWorkAreOrderedByIt)
+{
+  worker_.send({ HELLO, { "0:1", "1", "1" }});
+  std::string sample = stateline::serialise(std::vector<double>{ 1.0 });
+
+  // Jobs take 50 minutes on the first worker
+  requester_.send({{ "1" }, REQUEST, { "0", sample }});
+  auto job = receiveIgnoreHBs(worker_);
+  worker_.send({ RESULT, { job.data[1], stateline::serialise(1.0), "3000000000" }});
+  requester_.receive();
+
+  // It takes as many jobs as it may have, so the next one waits for the
+  // other worker however long that takes to connect. Jobs take it 33 minutes.
+  requester_.send({{ "2" }, REQUEST, { "0", sample }});
+  requester_.send({{ "3" }, REQUEST, { "0", sample }});
+  auto heldJob = receiveIgnoreHBs(worker_);
+  auto otherHeldJob = receiveIgnoreHBs(worker_);
+  requester_.send({{ "4" }, REQUEST, { "0", sample }});
+
+  Socket otherWorker{context_, ZMQ_DEALER, "mockOtherWorker", 0};
+  otherWorker.setIdentifier("otherWorker");
+  otherWorker.connect("tcp://localhost:5555");
+  otherWorker.send({ HELLO, { "0:1", "1", "1" }});
+  auto otherJob = receiveIgnoreHBs(otherWorker);
+  otherWorker.send({ RESULT, { otherJob.data[1], stateline::serialise(4.0), "2000000000" }});
+  worker_.send({ RESULT, { heldJob.data[1], stateline::serialise(2.0), "3000000000" }});
+  worker_.send({ RESULT, { otherHeldJob.data[1], stateline::serialise(3.0), "3000000000" }});
+  for (uint i = 0; i < 3; i++)
+    requester_.receive();
+
+  // Each gets a job to be busy with, after which the first would finish
+  // another in 100 minutes and the other in 66, past what fits in 32 bits
+  requester_.send({{ "5" }, REQUEST, { "0", sample }});
+  receiveIgnoreHBs(otherWorker);
+  requester_.send({{ "6" }, REQUEST, { "0", sample }});
+  receiveIgnoreHBs(worker_);
+  requester_.send({{ "7" }, REQUEST, { "0", sample }});
+  auto next = receiveIgnoreHBs(otherWorker);
+  EXPECT_EQ(JOB, next.subject);
+}
+
+TEST_F(DelegatorTest, resultsCountAsHeartbeats)
+{
+  // The worker never sends a heartbeat, but keeps answering for longer
+  // than the timeout
+  worker_.send({ HELLO, { "0:1", "1", "1" }});
+  std::string sample = stateline::serialise(std::vector<double>{ 1.0 });
+  for (uint i = 0; i < 8; i++)
+  {
+    requester_.send({{ std::to_string(i) }, REQUEST, { "0", sample }});
+    auto job = receiveIgnoreHBs(worker_);
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    worker_.send({ RESULT, { job.data[1], stateline::serialise(1.0) }});
+    EXPECT_EQ(Message({ std::to_string(i) }, RESULT, { stateline::serialise(1.0) }),
+        requester_.receive());
+  }
+}
+
+TEST_F(DelegatorTest, jobsOfASilentWorkerGoToAnother)
+{
+  worker_.send({ HELLO, { "0:1", "1", "1" }});
+  requester_.send({{ "1" }, REQUEST, { "0", stateline::serialise(std::vector<double>{ 1.0 }) }});
+  auto job = receiveIgnoreHBs(worker_);
+
+  // The other worker keeps sending heartbeats until the first one times
+  // out and its job is sent on
+  Socket otherWorker{context_, ZMQ_DEALER, "mockOtherWorker", 0};
+  otherWorker.setIdentifier("otherWorker");
+  otherWorker.connect("tcp://localhost:5555");
+  otherWorker.send({ HELLO, { "0:1", "1", "1" }});
+  Message resent(HEARTBEAT);
+  while (resent.subject == HEARTBEAT)
+  {
+    otherWorker.send({ HEARTBEAT });
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    if (otherWorker.hasMessage())
+      resent = otherWorker.receive();
+  }
+  EXPECT_EQ(job.data[2], resent.data[2]);
+
+  otherWorker.send({ RESULT, { resent.data[1], stateline::serialise(2.0) }});
+  EXPECT_EQ(Message({ "1" }, RESULT, { stateline::serialise(2.0) }), requester_.receive());
+}
+
+TEST_F(DelegatorTest, workerTakingTheSlotOfOneThatLeftGetsItsJob)
+{
+  worker_.send({ HELLO, { "0:1", "1", "1" }});
+  requester_.send({{ "1" }, REQUEST, { "0", stateline::serialise(std::vector<double>{ 1.0 }) }});
+  auto job = receiveIgnoreHBs(worker_);
+  worker_.send({ GOODBYE });
+
+  Socket otherWorker{context_, ZMQ_DEALER, "mockOtherWorker", 0};
+  otherWorker.setIdentifier("otherWorker");
+  otherWorker.connect("tcp://localhost:5555");
+  otherWorker.send({ HELLO, { "0:1", "1", "1" }});
+  auto resent = receiveIgnoreHBs(otherWorker);
+  EXPECT_EQ(job.data[2], resent.data[2]);
+
+  // The worker that left is no longer known, so its result is ignored
+  worker_.send({ RESULT, { job.data[1], stateline::serialise(1.0) }});
+  otherWorker.send({ RESULT, { resent.data[1], stateline::serialise(2.0) }});
+  EXPECT_EQ(Message({ "1" }, RESULT, { stateline::serialise(2.0) }), requester_.receive());
+}
+
+TEST_F(DelegatorTest, jobsOnlyGoToWorkersSupportingTheirType)
+{
+  Socket otherWorker{context_, ZMQ_DEALER, "mockOtherWorker", 0};
+  otherWorker.setIdentifier("otherWorker");
+  otherWorker.connect("tcp://localhost:5555");
+
+  worker_.send({ HELLO, { "0:1", "1" }});
+  otherWorker.send({ HELLO, { "1:2", "1" }});
+
+  requester_.send({{ "42" }, REQUEST, { "0:1", stateline::serialise(std::vector<double>{ 1.0 }) }});
+  auto job0 = receiveIgnoreHBs(worker_);
+  auto job1 = receiveIgnoreHBs(otherWorker);
+  EXPECT_EQ("0", job0.data[0]);
+  EXPECT_EQ("1", job1.data[0]);
+
+  // The request completes once both types have a result
+  otherWorker.send({ RESULT, { job1.data[1], stateline::serialise(2.0) }});
+  worker_.send({ RESULT, { job0.data[1], stateline::serialise(1.0) }});
+  auto result = requester_.receive();
+  ASSERT_EQ(2U, result.data.size());
+  EXPECT_EQ(1.0, stateline::unserialise<double>(result.data[0].str()));
+  EXPECT_EQ(2.0, stateline::unserialise<double>(result.data[1].str()));
+}
+
+TEST(DelegatorJobTypesTest, workersThatDontSayTheirJobTypesStartAtTheFirst)
+{
+  zmq::context_t context{1};
+  DelegatorSettings settings = DelegatorSettings::Default(5581);
+  settings.msPollRate = 10;
+  settings.nJobTypes = 4;
+  settings.firstJobType = 2;
+  bool running = true;
+  auto delegator = stateline::startInThread<Delegator>(running, std::ref(context), std::cref(settings));
+
+  Socket worker{context, ZMQ_DEALER, "mockWorker", 0};
+  worker.setIdentifier("worker");
+  worker.connect("tcp://localhost:5581");
+  Socket requester{context, ZMQ_DEALER, "mockRequester", -1};
+  requester.setIdentifier();
+  requester.connect(delegatorSocketAddress(5581));
+
+  worker.send({ HELLO, { "", "1" }});
+  requester.send({{ "42" }, REQUEST, { "0:2", stateline::serialise(std::vector<double>{ 1.0 }) }});
+
+  // The worker only gets the job of a type from the first on
+  auto job2 = receiveIgnoreHBs(worker);
+  EXPECT_EQ("2", job2.data[0]);
+  worker.send({ RESULT, { job2.data[1], stateline::serialise(2.0) }});
+
+  // The other type waits for a worker that says it takes it
+  Socket otherWorker{context, ZMQ_DEALER, "mockOtherWorker", 0};
+  otherWorker.setIdentifier("otherWorker");
+  otherWorker.connect("tcp://localhost:5581");
+  otherWorker.send({ HELLO, { "0:1", "1" }});
+  auto job0 = receiveIgnoreHBs(otherWorker);
+  EXPECT_EQ("0", job0.data[0]);
+  otherWorker.send({ RESULT, { job0.data[1], stateline::serialise(0.0) }});
+
+  auto result = requester.receive();
+  ASSERT_EQ(2U, result.data.size());
+  EXPECT_EQ(2.0, stateline::unserialise<double>(result.data[1].str()));
+
+  running = false;
+  delegator.wait();
+}
+
+TEST_F(DelegatorTest, workerWithMoreMinionsIsSentMoreJobs)
+{
+  // A worker with one minion starts with two jobs at once, then a second
+  // minion joins it
+  worker_.send({ HELLO, { "0:1", "1", "1" }});
+  worker_.send({ HELLO, { "0:1", "1", "2" }});
+
+  for (uint i = 0; i < 4; i++)
+    requester_.send({{ std::to_string(i) }, REQUEST, { "0", stateline::serialise(std::vector<double>{ 1.0 }) }});
+
+  std::set<std::string> jobIds;
+  for (uint i = 0; i < 4; i++)
+    jobIds.insert(receiveIgnoreHBs(worker_).data[1].str());
+  EXPECT_EQ(4U, jobIds.size());
+}
+
+TEST_F(DelegatorTest, workerIsSentEnoughJobsToCoverRoundTrip)
+{
+  worker_.send({ HELLO, { "0:1", "1", "1" }});
+
+  std::string data = stateline::serialise(std::vector<double>{ 1.0 });
+  requester_.send({{ "first" }, REQUEST, { "0", data }});
+  auto job = receiveIgnoreHBs(worker_);
+
+  // The job took 10us of a 20ms round trip, so the worker is sent as many
+  // jobs as a minion may have
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  worker_.send({ RESULT, { job.data[1], stateline::serialise(1.0), "10" }});
+  requester_.receive();
+
+  for (uint i = 0; i < 10; i++)
+    requester_.send({{ std::to_string(i) }, REQUEST, { "0", data }});
+
+  std::set<std::string> jobIds;
+  for (uint i = 0; i < 10; i++)
+    jobIds.insert(receiveIgnoreHBs(worker_).data[1].str());
+  EXPECT_EQ(10U, jobIds.size());
+}
+
+TEST_F(DelegatorTest, batchingWorkerGetsAllJobTypesInOneMessage)
+{
+  worker_.send({ HELLO, { "0:3", "1", "2", "1" }});
+
+  std::string data = stateline::serialise(std::vector<double>{ 1.0 });
+  requester_.send({{ "42" }, REQUEST, { "0:1:2", data }});
+  auto batch = receiveIgnoreHBs(worker_);
+  ASSERT_EQ(BATCHJOB, batch.subject);
+  EXPECT_EQ("0:1:2", batch.data[0]);
+  EXPECT_EQ(data, batch.data[2]);
+
+  std::vector<std::string> ids;
+  stateline::splitStr(ids, batch.data[1].str(), ':');
+  ASSERT_EQ(3U, ids.size());
+
+  // Results are given in the order of the job ids
+  worker_.send({ BATCHRESULT, { batch.data[1], stateline::serialise(1.0),
+      stateline::serialise(2.0), stateline::serialise(3.0) }});
+  auto result = requester_.receive();
+  ASSERT_EQ(3U, result.data.size());
+  EXPECT_EQ(1.0, stateline::unserialise<double>(result.data[0].str()));
+  EXPECT_EQ(2.0, stateline::unserialise<double>(result.data[1].str()));
+  EXPECT_EQ(3.0, stateline::unserialise<double>(result.data[2].str()));
+}
+
+TEST_F(DelegatorTest, resultsForJobsOfFinishedRequestsAreIgnored)
+{
+  worker_.send({ HELLO, { "0:1", "1", "1" }});
+  auto sample = stateline::serialise(std::vector<double>{ 1.0 });
+  requester_.send({{ "1" }, REQUEST, { "0", sample }});
+  auto first = receiveIgnoreHBs(worker_);
+  worker_.send({ RESULT, { first.data[1], stateline::serialise(1.0) }});
+  EXPECT_EQ(Message({ "1" }, RESULT, { stateline::serialise(1.0) }), requester_.receive());
+
+  // The next job reuses the first one's record, but not its id
+  requester_.send({{ "2" }, REQUEST, { "0", sample }});
+  auto second = receiveIgnoreHBs(worker_);
+  EXPECT_NE(first.data[1], second.data[1]);
+
+  worker_.send({ RESULT, { first.data[1], stateline::serialise(3.0) }});
+  worker_.send({ RESULT, { second.data[1], stateline::serialise(2.0) }});
+  EXPECT_EQ(Message({ "2" }, RESULT, { stateline::serialise(2.0) }), requester_.receive());
+}
+
 /*
 TEST_F(DelegatorTest, canSendAndReceiveSingleJobTypeMultipleTimes)
 {
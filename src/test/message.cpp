@@ -78,3 +78,44 @@ TEST(Message, addressContainingEmptyEntriesConvertsToStringCorrectly)
   std::vector<std::string> address = { "", "A", "", "B1", "" };
   EXPECT_EQ(":B1::A:", addressAsString(address));
 }
+
+TEST(Message, copyingFrameSharesBytes)
+{
+  Frame a{std::string(1000, 'x')};
+  Frame b = a;
+
+  EXPECT_TRUE(a.shared());
+  EXPECT_EQ(a.data(), b.data());
+  EXPECT_EQ(1000U, b.size());
+  EXPECT_EQ(a, b);
+}
+
+TEST(Message, framesCompareByContent)
+{
+  EXPECT_EQ(Frame("abc"), Frame(std::string("abc")));
+  EXPECT_NE(Frame("abc"), Frame("abd"));
+  EXPECT_TRUE(Frame().empty());
+  EXPECT_EQ("abc", Frame("abc").str());
+}
+
+TEST(Message, packedHeaderRoundTrips)
+{
+  Message m{RESULT, Header{(1ULL << 40) + 7, 3, 42, 0}, { "Data" }};
+  Frame frame = packHeader(m);
+  ASSERT_EQ(PACKED_HEADER_SIZE, frame.size());
+
+  Message unpacked{HELLO};
+  ASSERT_TRUE(unpackHeader(frame, unpacked));
+  EXPECT_TRUE(unpacked.packed);
+  EXPECT_EQ(RESULT, unpacked.subject);
+  EXPECT_EQ((1ULL << 40) + 7, unpacked.header.jobId);
+  EXPECT_EQ(3U, unpacked.header.jobType);
+  EXPECT_EQ(42U, unpacked.header.chainId);
+}
+
+TEST(Message, subjectFrameIsNotAPackedHeader)
+{
+  Message m{HELLO};
+  EXPECT_FALSE(unpackHeader(Frame("4"), m));
+  EXPECT_FALSE(m.packed);
+}
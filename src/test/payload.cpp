@@ -0,0 +1,55 @@
+//!
+//! \file comms/tests/payload.cpp
+//! \author agent
+//! \date 2026
+//! \license Lesser General Public License version 3 or later
+//! \copyright (c) 2014, NICTA
+//!
+
+#include <gtest/gtest.h>
+
+#include "app/serial.hpp"
+#include "comms/payload.hpp"
+
+using namespace stateline;
+using namespace stateline::comms;
+
+TEST(Payload, binaryRoundTripIsExact)
+{
+  Eigen::VectorXd sample(3);
+  sample << 0.1, -1.0 / 3.0, 1e-300;
+
+  std::vector<double> result = unserialise<std::vector<double>>(serialise(sample));
+  ASSERT_EQ(3U, result.size());
+  for (uint i = 0; i < result.size(); i++)
+    EXPECT_EQ(sample(i), result[i]);
+}
+
+TEST(Payload, singleDoubleRoundTripIsExact)
+{
+  double x = 2.0 / 3.0;
+  EXPECT_EQ(sizeof(double), serialise(x).size());
+  EXPECT_EQ(x, unserialise<double>(serialise(x)));
+}
+
+TEST(Payload, textConversionKeepsFullPrecision)
+{
+  std::vector<double> values = { 1.0 / 3.0, -12345.678901234567, 0.0 };
+  std::string binary = serialise(values);
+
+  std::string text = binaryToText(binary);
+  EXPECT_EQ(2, std::count(text.begin(), text.end(), ':'));
+  EXPECT_EQ(binary, textToBinary(text));
+}
+
+TEST(Payload, missingWireFormatMeansText)
+{
+  EXPECT_EQ(WireFormat::Text, parseWireFormat(""));
+  EXPECT_EQ(WireFormat::Text, parseWireFormat("0"));
+  EXPECT_EQ(WireFormat::Binary, parseWireFormat("1"));
+}
+
+TEST(Payload, newerWireFormatsAreClampedToLatest)
+{
+  EXPECT_EQ(LATEST_WIRE_FORMAT, parseWireFormat("42"));
+}
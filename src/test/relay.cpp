@@ -0,0 +1,111 @@
+//!
+//! Contains tests for the relay between a delegator and workers of its own.
+//!
+//! \file test/relay.cpp
+//! \author agent
+//! \date 2026
+//! \license Lesser General Public License version 3 or later
+//! \copyright (c) 2014, NICTA
+//!
+
+#include "gtest/gtest.h"
+
+#include "comms/relay.hpp"
+#include "comms/socket.hpp"
+#include "comms/thread.hpp"
+#include "app/serial.hpp"
+
+using namespace stateline;
+using namespace stateline::comms;
+
+namespace
+{
+  Message receiveIgnoringHeartbeats(Socket& socket)
+  {
+    while (true)
+    {
+      Message m = socket.receive();
+      if (m.subject != HEARTBEAT)
+        return m;
+    }
+  }
+}
+
+class RelayTest : public testing::Test
+{
+public:
+  RelayTest()
+    : context_{1},
+      settings_(RelaySettings::Default("localhost:5560", 5561)),
+      server_{context_, ZMQ_ROUTER, "mockServer", 0},
+      worker_{context_, ZMQ_DEALER, "mockWorker", 0},
+      running_{true}
+  {
+    settings_.msPollRate = 10;
+    settings_.jobTypesRange = std::make_pair(0, 2);
+    settings_.delegator.msPollRate = 10;
+    settings_.delegator.heartbeat.msPollRate = 100;
+    server_.bind("tcp://*:5560");
+
+    relay_ = startInThread<Relay>(running_, std::ref(context_), std::cref(settings_));
+
+    worker_.setIdentifier("worker");
+    worker_.connect("tcp://localhost:5561");
+  }
+
+  ~RelayTest()
+  {
+    running_ = false;
+    relay_.wait();
+  }
+
+  zmq::context_t context_;
+  RelaySettings settings_;
+  Socket server_;
+  Socket worker_;
+  bool running_;
+  std::future<bool> relay_;
+};
+
+TEST_F(RelayTest, tellsTheServerHowManyMinionsItsWorkersHave)
+{
+  worker_.send({ HELLO, { "0:2", "1", "2" }});
+  Message hello = receiveIgnoringHeartbeats(server_);
+  ASSERT_EQ(HELLO, hello.subject);
+  EXPECT_EQ("0:2", hello.data[0]);
+  EXPECT_EQ("2", hello.data[2]);
+
+  Socket otherWorker{context_, ZMQ_DEALER, "mockOtherWorker", 0};
+  otherWorker.setIdentifier("otherWorker");
+  otherWorker.connect("tcp://localhost:5561");
+  otherWorker.send({ HELLO, { "0:2", "1", "3" }});
+  hello = receiveIgnoringHeartbeats(server_);
+  ASSERT_EQ(HELLO, hello.subject);
+  EXPECT_EQ("5", hello.data[2]);
+}
+
+TEST_F(RelayTest, sendsBackTheResultsOfABatchInItsOrder)
+{
+  worker_.send({ HELLO, { "0:2", "1", "2" }});
+  Message hello = receiveIgnoringHeartbeats(server_);
+  ASSERT_EQ(HELLO, hello.subject);
+
+  auto sample = serialise(std::vector<double>{ 1.0 });
+  server_.send({ hello.address, BATCHJOB, Header{0, 0, 7, 0}, { "1:0", "11:10", sample }});
+
+  // Answer each job with its type plus a half
+  for (uint i = 0; i < 2; i++)
+  {
+    Message job = receiveIgnoringHeartbeats(worker_);
+    ASSERT_EQ(JOB, job.subject);
+    EXPECT_EQ(sample, job.data[2]);
+    worker_.send({ RESULT, { job.data[1], serialise(std::stoi(job.data[0].str()) + 0.5) }});
+  }
+
+  Message result = receiveIgnoringHeartbeats(server_);
+  ASSERT_EQ(BATCHRESULT, result.subject);
+  ASSERT_EQ(4U, result.data.size());
+  EXPECT_EQ("11:10", result.data[0]);
+  EXPECT_EQ(1.5, unserialise<double>(result.data[1].str()));
+  EXPECT_EQ(0.5, unserialise<double>(result.data[2].str()));
+}
@@ -11,6 +11,8 @@
 
 #include "comms/router.hpp"
 
+#include <thread>
+
 using namespace stateline;
 using namespace stateline::comms;
 
@@ -108,3 +110,33 @@ TEST(Router, socketSendCallsBoundCallback)
 
   routerFuture.wait();
 }
+
+TEST(Router, handlesAllWaitingMessagesBeforeOnPoll)
+{
+  zmq::context_t context{1};
+  bool running = true;
+
+  Socket alpha{context, ZMQ_PAIR, "alpha"};
+  alpha.bind("inproc://alpha");
+
+  Socket beta{context, ZMQ_PAIR, "beta"};
+  beta.connect("inproc://alpha");
+
+  // Queue the messages before the router starts
+  for (uint i = 0; i < 5; i++)
+    beta.send({REQUEST, { std::to_string(i) }});
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+  uint nReceived = 0;
+  uint nReceivedAtFirstPoll = 0;
+  SocketRouter router("testRouter", { &alpha });
+  router.bind(0, REQUEST, [&](const Message&) { nReceived++; });
+  router.bindOnPoll([&]()
+  {
+    nReceivedAtFirstPoll = nReceived;
+    running = false;
+  });
+  router.poll(100, running);
+
+  EXPECT_EQ(5U, nReceivedAtFirstPoll);
+}
@@ -0,0 +1,70 @@
+//!
+//! Contains tests for the pool of reusable records.
+//!
+//! \file test/slotpool.cpp
+//! \author agent
+//! \date 2026
+//! \license Lesser General Public License version 3 or later
+//! \copyright (c) 2014, NICTA
+//!
+
+#include "gtest/gtest.h"
+
+#include "common/slotpool.hpp"
+
+#include <set>
+#include <vector>
+
+using namespace stateline;
+
+TEST(SlotPoolTest, findsRecordsUntilTheyAreReleased)
+{
+  SlotPool<int> pool;
+  uint64_t a = pool.acquire();
+  uint64_t b = pool.acquire();
+  EXPECT_NE(0U, a);
+  EXPECT_NE(a, b);
+  pool[a] = 1;
+  pool[b] = 2;
+  EXPECT_EQ(2U, pool.size());
+
+  pool.release(a);
+  EXPECT_EQ(nullptr, pool.find(a));
+  ASSERT_NE(nullptr, pool.find(b));
+  EXPECT_EQ(2, *pool.find(b));
+  EXPECT_EQ(1U, pool.size());
+  EXPECT_EQ(nullptr, pool.find(0));
+}
+
+TEST(SlotPoolTest, reusedSlotsGetNewIds)
+{
+  SlotPool<std::vector<int>> pool;
+  uint64_t a = pool.acquire();
+  pool[a].assign(100, 0);
+  const std::vector<int>* record = &pool[a];
+  pool.release(a);
+
+  // The slot is reused, keeping the record and its storage, but the old id
+  // doesn't find it
+  uint64_t b = pool.acquire();
+  EXPECT_NE(a, b);
+  EXPECT_EQ(record, &pool[b]);
+  EXPECT_GE(pool[b].capacity(), 100U);
+  EXPECT_EQ(nullptr, pool.find(a));
+}
+
+TEST(SlotPoolTest, idsAreNeverZeroOnceGenerationsWrap)
+{
+  // The first slot is reused every time, so its generation wraps after 255
+  SlotPool<int, uint8_t> pool;
+  std::set<uint64_t> ids;
+  for (uint i = 0; i < 600; i++)
+  {
+    uint64_t id = pool.acquire();
+    EXPECT_NE(0U, id);
+    ASSERT_NE(nullptr, pool.find(id));
+    ids.insert(id);
+    pool.release(id);
+  }
+  EXPECT_EQ(255U, ids.size());
+}
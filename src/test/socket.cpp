@@ -56,6 +56,50 @@ TEST(Socket, canSendMessagesOverPairSockets)
   }
 }
 
+TEST(Socket, canSendPackedHeadersOverPairSockets)
+{
+  zmq::context_t context{1};
+
+  Socket alpha{context, ZMQ_PAIR, "alpha"};
+  alpha.bind("inproc://alpha");
+
+  Socket beta{context, ZMQ_PAIR, "beta"};
+  beta.connect("inproc://alpha");
+
+  Message m{JOB, Header{12345678901ULL, 7, 3, 0}, { "data" }};
+  alpha.send(m);
+
+  auto result = beta.receive();
+  EXPECT_EQ(m, result);
+  EXPECT_TRUE(result.packed);
+  EXPECT_EQ(12345678901ULL, result.header.jobId);
+}
+
+TEST(Socket, canSendLargeSharedFramesOverPairSockets)
+{
+  zmq::context_t context{1};
+
+  Socket alpha{context, ZMQ_PAIR, "alpha"};
+  alpha.bind("inproc://alpha");
+
+  Socket beta{context, ZMQ_PAIR, "beta"};
+  beta.connect("inproc://alpha");
+
+  // Send the same payload several times; it should only ever be shared
+  std::string bytes(100000, 'a');
+  bytes[12345] = 'b';
+  Frame payload{bytes};
+  for (int i = 0; i < 3; i++)
+    alpha.send({JOB, { "0", payload }});
+
+  for (int i = 0; i < 3; i++)
+  {
+    auto result = beta.receive();
+    ASSERT_EQ(2U, result.data.size());
+    EXPECT_EQ(bytes, result.data[1].str());
+  }
+}
+
 TEST(Socket, sendFailureThrowsExceptionByDefault)
 {
   zmq::context_t context{1};
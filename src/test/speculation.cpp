@@ -0,0 +1,141 @@
+//!
+//! Contains tests for speculative proposal evaluation.
+//!
+//! \file test/speculation.cpp
+//! \author agent
+//! \date 2026
+//! \license Lesser General Public License version 3 or later
+//! \copyright (c) 2014, NICTA
+//!
+
+#include "gtest/gtest.h"
+
+#include "infer/speculation.hpp"
+
+#include <limits>
+
+using namespace stateline::mcmc;
+
+namespace
+{
+  const uint NO_LIMIT = std::numeric_limits<uint>::max();
+
+  // Proposals that step by one from their starting state
+  Eigen::VectorXd stepByOne(const Eigen::VectorXd& from)
+  {
+    return from.array() + 1.0;
+  }
+
+  Eigen::VectorXd scalar(double x)
+  {
+    return Eigen::VectorXd::Constant(1, x);
+  }
+}
+
+TEST(SpeculationTest, singleProposalWithoutSpeculation)
+{
+  ProposalSpeculator s(2, 1);
+  auto jobs = s.fill(1, scalar(0.0), 0.5, NO_LIMIT, stepByOne);
+  ASSERT_EQ(1U, jobs.size());
+  EXPECT_EQ(1.0, jobs[0].second(0));
+  EXPECT_EQ(nullptr, s.current(0));
+
+  // Filling again doesn't submit anything new
+  EXPECT_EQ(0U, s.fill(1, scalar(0.0), 0.5, NO_LIMIT, stepByOne).size());
+
+  uint chain;
+  EXPECT_TRUE(s.evaluated(jobs[0].first, 2.5, chain));
+  EXPECT_EQ(1U, chain);
+  EXPECT_EQ(2.5, s.current(1)->energy);
+  EXPECT_EQ(0U, s.numOutstanding());
+}
+
+TEST(SpeculationTest, speculatesOnMostLikelyOutcomeFirst)
+{
+  ProposalSpeculator s(1, 3);
+
+  // With a low acceptance rate, the chain is most likely to reject twice
+  auto jobs = s.fill(0, scalar(0.0), 0.1, NO_LIMIT, stepByOne);
+  ASSERT_EQ(3U, jobs.size());
+  const SpeculativeProposal* p = s.current(0);
+  ASSERT_NE(nullptr, p->ifRejected);
+  ASSERT_NE(nullptr, p->ifRejected->ifRejected);
+  EXPECT_EQ(nullptr, p->ifAccepted);
+
+  // Each proposal after a rejection is made from the original state
+  EXPECT_EQ(1.0, p->ifRejected->sample(0));
+  EXPECT_EQ(1.0, p->ifRejected->ifRejected->sample(0));
+}
+
+TEST(SpeculationTest, resolvingKeepsOnlyTheOutcomeThatHappened)
+{
+  ProposalSpeculator s(1, 3);
+  auto jobs = s.fill(0, scalar(0.0), 0.5, NO_LIMIT, stepByOne);
+  ASSERT_EQ(3U, jobs.size());
+  const SpeculativeProposal* p = s.current(0);
+  ASSERT_NE(nullptr, p->ifAccepted);
+  ASSERT_NE(nullptr, p->ifRejected);
+  EXPECT_EQ(2.0, p->ifAccepted->sample(0));
+  EXPECT_EQ(1.0, p->ifRejected->sample(0));
+
+  // The speculative results arrive before the current one
+  uint chain;
+  EXPECT_FALSE(s.evaluated(jobs[1].first, 1.0, chain));
+  EXPECT_FALSE(s.evaluated(jobs[2].first, 2.0, chain));
+  EXPECT_TRUE(s.evaluated(jobs[0].first, 0.0, chain));
+
+  auto accepted = s.current(0)->ifAccepted;
+  auto rejected = s.current(0)->ifRejected;
+  s.resolve(0, true);
+  EXPECT_EQ(accepted.get(), s.current(0));
+  EXPECT_TRUE(s.current(0)->evaluated);
+  EXPECT_TRUE(rejected->discarded);
+  EXPECT_EQ(1U, s.current(0)->depth);
+
+  // Refilling speculates from the new current proposal
+  jobs = s.fill(0, scalar(1.0), 0.5, NO_LIMIT, stepByOne);
+  EXPECT_EQ(2U, jobs.size());
+}
+
+TEST(SpeculationTest, discardedResultsAreIgnored)
+{
+  ProposalSpeculator s(1, 2);
+  auto jobs = s.fill(0, scalar(0.0), 0.5, NO_LIMIT, stepByOne);
+  ASSERT_EQ(2U, jobs.size());
+  s.discard(0);
+  EXPECT_EQ(nullptr, s.current(0));
+  EXPECT_EQ(2U, s.numOutstanding());
+
+  uint chain;
+  EXPECT_FALSE(s.evaluated(jobs[0].first, 0.0, chain));
+  EXPECT_FALSE(s.evaluated(jobs[1].first, 0.0, chain));
+  EXPECT_EQ(0U, s.numOutstanding());
+}
+
+TEST(SpeculationTest, doesNotSpeculatePastMaxDepth)
+{
+  ProposalSpeculator s(1, 10);
+  auto jobs = s.fill(0, scalar(0.0), 0.5, 2, stepByOne);
+  EXPECT_EQ(3U, jobs.size());
+}
+
+TEST(SpeculationTest, knowsWhichProposalsAreMadeFromTheChainState)
+{
+  ProposalSpeculator s(1, 3);
+  auto jobs = s.fill(0, scalar(0.0), 0.5, 2, stepByOne);
+  ASSERT_EQ(3U, jobs.size());
+
+  // Only rejections keep the chain where it is
+  const SpeculativeProposal* root = s.current(0);
+  EXPECT_EQ(root, s.proposal(jobs[0].first));
+  EXPECT_TRUE(root->fromChainState);
+  EXPECT_FALSE(root->ifAccepted->fromChainState);
+  EXPECT_TRUE(root->ifRejected->fromChainState);
+
+  // Once accepted, the chain is at the state its proposal was made from
+  uint chain;
+  EXPECT_TRUE(s.evaluated(jobs[0].first, 0.0, chain));
+  EXPECT_EQ(nullptr, s.proposal(jobs[0].first));
+  s.resolve(0, true);
+  EXPECT_TRUE(s.current(0)->fromChainState);
+}
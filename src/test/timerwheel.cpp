@@ -0,0 +1,84 @@
+//!
+//! Contains tests for the hashed timer wheel.
+//!
+//! \file test/timerwheel.cpp
+//! \author agent
+//! \date 2026
+//! \license Lesser General Public License version 3 or later
+//! \copyright (c) 2014, NICTA
+//!
+
+#include "gtest/gtest.h"
+
+#include "common/timerwheel.hpp"
+
+#include <algorithm>
+#include <vector>
+
+using namespace stateline;
+using ms = std::chrono::milliseconds;
+
+namespace
+{
+  using Wheel = TimerWheel<int>;
+  const Wheel::clock::time_point START{};
+
+  std::vector<int> expire(Wheel& wheel, uint msNow)
+  {
+    std::vector<int> fired;
+    wheel.expire(START + ms(msNow), [&](int value) { fired.push_back(value); });
+    return fired;
+  }
+}
+
+TEST(TimerWheelTest, firesTimersOnceTheirTickHasEnded)
+{
+  Wheel wheel(ms(10), 8, START);
+  wheel.add(1, START + ms(15));
+  wheel.add(2, START + ms(32));
+  EXPECT_EQ(2U, wheel.size());
+
+  EXPECT_TRUE(expire(wheel, 19).empty());
+  EXPECT_EQ(std::vector<int>({ 1 }), expire(wheel, 20));
+  EXPECT_TRUE(expire(wheel, 35).empty());
+  EXPECT_EQ(std::vector<int>({ 2 }), expire(wheel, 40));
+  EXPECT_TRUE(wheel.empty());
+}
+
+TEST(TimerWheelTest, keepsTimersMoreThanARevolutionAway)
+{
+  // The timer shares a slot with the first tick, but is two revolutions on
+  Wheel wheel(ms(10), 4, START);
+  wheel.add(1, START + ms(85));
+
+  EXPECT_TRUE(expire(wheel, 80).empty());
+  EXPECT_EQ(1U, wheel.size());
+  EXPECT_EQ(std::vector<int>({ 1 }), expire(wheel, 90));
+}
+
+TEST(TimerWheelTest, firesEverythingDueAfterALongStall)
+{
+  Wheel wheel(ms(10), 4, START);
+  for (int i = 0; i < 10; i++)
+    wheel.add(i, START + ms(10 * i));
+
+  auto fired = expire(wheel, 1000);
+  std::sort(fired.begin(), fired.end());
+  EXPECT_EQ(std::vector<int>({ 0, 1, 2, 3, 4, 5, 6, 7, 8, 9 }), fired);
+}
+
+TEST(TimerWheelTest, timersAddedWhileFiringGoInLaterTicks)
+{
+  Wheel wheel(ms(10), 4, START);
+  wheel.add(1, START);
+
+  // Re-arming for a time that has passed still waits for the next tick
+  std::vector<int> fired;
+  wheel.expire(START + ms(10), [&](int value)
+  {
+    fired.push_back(value);
+    wheel.add(value + 1, START);
+  });
+  EXPECT_EQ(std::vector<int>({ 1 }), fired);
+  EXPECT_EQ(std::vector<int>({ 2 }), expire(wheel, 20));
+}